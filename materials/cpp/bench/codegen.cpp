@@ -0,0 +1,37 @@
+// Codegen only: parse one file once, then time selectProgram in each
+// allocation mode, best of <reps> runs.
+//
+//   codegen <file.ir> [reps]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+#include "instruction_selector.hpp"
+#include "ir.hpp"
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::fprintf(stderr, "Usage: %s <file.ir> [reps]\n", argv[0]);
+        return 1;
+    }
+    const int reps = argc > 2 ? std::max(1, std::atoi(argv[2])) : 3;
+    const ircpp::IRProgram program = ircpp::IRReader().parseIRFileMapped(argv[1]);
+    using Mode = ircpp::IRToMIPSSelector::AllocMode;
+    for (Mode mode : {Mode::Naive, Mode::Greedy}) {
+        double best = 1e30;
+        size_t instructions = 0;
+        for (int r = 0; r < reps; ++r) {
+            ircpp::IRToMIPSSelector selector(mode);
+            const auto start = std::chrono::steady_clock::now();
+            const std::vector<ircpp::MIPSInstruction> code = selector.selectProgram(program);
+            const auto stop = std::chrono::steady_clock::now();
+            instructions = code.size();
+            best = std::min(best, std::chrono::duration<double>(stop - start).count());
+        }
+        std::printf("codegen %-6s: %zu instructions in %.3f s\n", mode == Mode::Naive ? "naive" : "greedy",
+                    instructions, best);
+    }
+    return 0;
+}
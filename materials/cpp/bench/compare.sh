@@ -0,0 +1,32 @@
+#!/usr/bin/env bash
+set -euo pipefail
+
+# Usage: bench/compare.sh <rev> <bench-target>...
+# Runs the given Makefile bench targets (e.g. bench-parse) twice: linked
+# against the library built at <rev> (in a temporary git worktree), then
+# against this tree. The benchmark sources and inputs come from this tree.
+
+SCRIPT_DIR="$(cd -- "$(dirname -- "${BASH_SOURCE[0]}")" &>/dev/null && pwd)"
+CPP_DIR="$(dirname -- "$SCRIPT_DIR")"
+
+if [[ $# -lt 2 ]]; then
+  echo "Usage: $0 <rev> <bench-target>..." >&2
+  exit 1
+fi
+
+REV="$1"
+shift
+PREFIX="$(git -C "$CPP_DIR" rev-parse --show-prefix)"
+TMP="$(mktemp -d)"
+WT="$TMP/tree"
+git -C "$CPP_DIR" worktree add --detach "$WT" "$REV" >/dev/null
+trap 'git -C "$CPP_DIR" worktree remove --force "$WT"; rm -rf "$TMP"' EXIT
+
+OLD="$WT/$PREFIX"
+make -s -C "$OLD" >"$TMP/build.log" 2>&1 || { cat "$TMP/build.log" >&2; exit 1; }
+for target in "$@"; do
+  echo "== $target at $REV"
+  make -s -C "$CPP_DIR" "$target" BENCH_INC="$OLD/include" BENCH_LIB="$OLD/bin/libircpp.a" BENCH_OUT="$TMP/bench"
+  echo "== $target in this tree"
+  make -s -C "$CPP_DIR" "$target"
+done
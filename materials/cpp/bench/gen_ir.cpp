@@ -0,0 +1,87 @@
+// Generates benchmark inputs on stdout. Needs nothing from the library, so
+// one input serves every revision bench/compare.sh builds against.
+//
+//   gen_ir repeat <megabytes> <file.ir>...
+//       The given IR files, one after another and over again, until the
+//       output reaches <megabytes> MB. Function names repeat, which the
+//       reader allows.
+//   gen_ir straight <instructions> <variables>
+//       One function whose body is a single block: each variable is
+//       assigned once, then <instructions> add/sub/and/or of randomly
+//       picked variables (fixed seed, so the output never changes).
+
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+namespace {
+
+int usage() {
+    std::cerr << "Usage: gen_ir repeat <megabytes> <file.ir>..." << std::endl;
+    std::cerr << "       gen_ir straight <instructions> <variables>" << std::endl;
+    return 1;
+}
+
+int repeat(int argc, char* argv[]) {
+    if (argc < 4) return usage();
+    const double target = std::atof(argv[2]) * 1e6;
+    std::vector<std::string> pieces;
+    for (int i = 3; i < argc; ++i) {
+        std::ifstream in(argv[i], std::ios::binary);
+        if (!in) {
+            std::cerr << "gen_ir: cannot read " << argv[i] << std::endl;
+            return 1;
+        }
+        pieces.emplace_back(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        if (!pieces.back().empty() && pieces.back().back() != '\n') pieces.back() += '\n';
+        pieces.back() += '\n';
+    }
+    double written = 0;
+    while (written < target)
+        for (const std::string& p : pieces) {
+            std::cout << p;
+            written += p.size();
+        }
+    return 0;
+}
+
+int straight(int argc, char* argv[]) {
+    if (argc != 4) return usage();
+    const long instructions = std::atol(argv[2]);
+    const long variables = std::atol(argv[3]);
+    if (instructions < 0 || variables < 1) return usage();
+    uint64_t state = 1;
+    auto pick = [&](uint64_t n) {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return state % n;
+    };
+    static const char* const ops[] = {"add", "sub", "and", "or"};
+    std::cout << "#start_function\nvoid main():\nint-list: ";
+    for (long v = 0; v < variables; ++v) std::cout << (v ? ", v" : "v") << v;
+    std::cout << "\nfloat-list:\n";
+    for (long v = 0; v < variables; ++v) std::cout << "    assign, v" << v << ", 1\n";
+    for (long i = 0; i < instructions; ++i) {
+        const char* op = ops[pick(4)];
+        const uint64_t d = pick(variables), a = pick(variables), b = pick(variables);
+        std::cout << "    " << op << ", v" << d << ", v" << a << ", v" << b << '\n';
+    }
+    std::cout << "    return, 0\n#end_function\n";
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    std::ios::sync_with_stdio(false);
+    if (argc < 2) return usage();
+    const std::string mode(argv[1]);
+    if (mode == "repeat") return repeat(argc, argv);
+    if (mode == "straight") return straight(argc, argv);
+    return usage();
+}
@@ -0,0 +1,33 @@
+// Greedy allocator scaling: parse one file, then time the greedy
+// selectProgram over it and report the process's peak RSS. Meant for the
+// single-block inputs of `gen_ir straight`, one process per input so the peak
+// belongs to that input alone.
+//
+//   greedy_scaling <file.ir>
+
+#include <chrono>
+#include <cstdio>
+
+#include <sys/resource.h>
+
+#include "instruction_selector.hpp"
+#include "ir.hpp"
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::fprintf(stderr, "Usage: %s <file.ir>\n", argv[0]);
+        return 1;
+    }
+    const auto start = std::chrono::steady_clock::now();
+    const ircpp::IRProgram program = ircpp::IRReader().parseIRFileMapped(argv[1]);
+    const auto parsed = std::chrono::steady_clock::now();
+    ircpp::IRToMIPSSelector selector(ircpp::IRToMIPSSelector::AllocMode::Greedy);
+    const size_t instructions = selector.selectProgram(program).size();
+    const auto selected = std::chrono::steady_clock::now();
+    struct rusage usage {};
+    getrusage(RUSAGE_SELF, &usage);
+    std::printf("%s: parse %.2f s, greedy %.2f s, %zu instructions, peak RSS %ld MB\n", argv[1],
+                std::chrono::duration<double>(parsed - start).count(),
+                std::chrono::duration<double>(selected - parsed).count(), instructions, usage.ru_maxrss / 1024);
+    return 0;
+}
@@ -0,0 +1,53 @@
+// Parse memory: heap allocations made while parsing one file on one thread,
+// the parse time and the process's peak RSS afterwards. Counts every global
+// operator new, so it measures the old shared_ptr IR built at f6df2e6^ and
+// the arena IR alike.
+//
+//   parse_alloc <file.ir>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+#include <sys/resource.h>
+
+#include "ir.hpp"
+
+namespace {
+std::atomic<size_t> g_allocations{0};
+
+void* countedAlloc(size_t n) {
+    ++g_allocations;
+    if (void* p = std::malloc(n ? n : 1)) return p;
+    throw std::bad_alloc();
+}
+} // namespace
+
+void* operator new(size_t n) { return countedAlloc(n); }
+void* operator new[](size_t n) { return countedAlloc(n); }
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+void operator delete[](void* p, size_t) noexcept { std::free(p); }
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::fprintf(stderr, "Usage: %s <file.ir>\n", argv[0]);
+        return 1;
+    }
+    ircpp::IRReader reader;
+    reader.parseThreads = 1;
+    const size_t before = g_allocations;
+    const auto start = std::chrono::steady_clock::now();
+    ircpp::IRProgram program = reader.parseIRFileMapped(argv[1]);
+    const auto stop = std::chrono::steady_clock::now();
+    const size_t allocations = g_allocations - before;
+    struct rusage usage {};
+    getrusage(RUSAGE_SELF, &usage);
+    std::printf("parse: %zu functions, %zu heap allocations, %.3f s, peak RSS %ld MB\n",
+                program.functions.size(), allocations, std::chrono::duration<double>(stop - start).count(),
+                usage.ru_maxrss / 1024);
+    return 0;
+}
@@ -0,0 +1,35 @@
+// Text parse throughput: IRReader::parseIRFile on one file, best of <reps>
+// runs. Only uses API the baseline reader already had, so bench/compare.sh
+// can time the regex/stringstream reader too.
+//
+//   parse_throughput <file.ir> [reps]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+
+#include "ir.hpp"
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::fprintf(stderr, "Usage: %s <file.ir> [reps]\n", argv[0]);
+        return 1;
+    }
+    const int reps = argc > 2 ? std::max(1, std::atoi(argv[2])) : 3;
+    std::ifstream in(argv[1], std::ios::binary | std::ios::ate);
+    const double bytes = static_cast<double>(in.tellg());
+    double best = 1e30;
+    size_t functions = 0;
+    for (int r = 0; r < reps; ++r) {
+        const auto start = std::chrono::steady_clock::now();
+        ircpp::IRProgram program = ircpp::IRReader().parseIRFile(argv[1]);
+        const auto stop = std::chrono::steady_clock::now();
+        functions = program.functions.size();
+        best = std::min(best, std::chrono::duration<double>(stop - start).count());
+    }
+    std::printf("parse: %zu functions, %.1f MB in %.3f s, %.1f MB/s\n", functions, bytes / 1e6, best,
+                bytes / 1e6 / best);
+    return 0;
+}
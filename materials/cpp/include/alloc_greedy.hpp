@@ -1,6 +1,7 @@
 #pragma once
 
 #include <vector>
+#include "call_graph.hpp"
 #include "ir.hpp"
 #include "mips_instructions.hpp"
 
@@ -8,7 +9,11 @@ namespace ircpp {
 
 // Emit a full function (prologue, body, epilogue) using intra-block greedy
 // allocation with per-block loads/stores and spills on control transfers.
-std::vector<MIPSInstruction> emitFunctionGreedy(const IRFunction& F);
+// Allocation regions are the blocks of `cfg`; unreachable blocks are not
+// emitted. A call only spills and forgets the registers `callees` says its
+// target may clobber (all of them without a summary).
+std::vector<MIPSInstruction> emitFunctionGreedy(const IRFunction& F, const ControlFlowGraph& cfg,
+                                                const ClobberSummaries* callees = nullptr);
 
 }
 
@@ -7,8 +7,8 @@
 namespace ircpp {
 
 // Emit a full function (prologue, body, epilogue) using naive per-instruction
-// load/compute/store allocation.
-std::vector<MIPSInstruction> emitFunctionNaive(const IRFunction& F);
+// load/compute/store allocation. Blocks `cfg` finds unreachable are not emitted.
+std::vector<MIPSInstruction> emitFunctionNaive(const IRFunction& F, const ControlFlowGraph& cfg);
 
 }
 
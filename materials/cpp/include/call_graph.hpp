@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "ir.hpp"
+#include "mips_instructions.hpp"
+
+namespace ircpp {
+
+// Who calls whom among the functions of one program. A call to a name the
+// program does not define (the syscall intrinsics, or a missing function) is
+// not an edge.
+struct CallGraph {
+    std::vector<std::string> names;              // function i's name
+    std::vector<std::vector<uint32_t>> callees;  // sorted, without duplicates
+    // Strongly connected components, callees first: every call that leaves a
+    // component goes to an earlier one, so walking them in order visits the
+    // program bottom-up. Mutually recursive functions share a component.
+    std::vector<std::vector<uint32_t>> components;
+    std::vector<uint32_t> componentOf;
+
+    static CallGraph build(const IRProgram& program);
+    // The same from each function's name and the names it calls, for callers
+    // that have not parsed the program.
+    static CallGraph build(const std::vector<std::string_view>& names,
+                           const std::vector<std::vector<std::string_view>>& calls);
+};
+
+// Registers a call to each function may leave changed, as bit masks over
+// gprNumber ($t0 is bit 8). A callee with no summary clobbers everything.
+class ClobberSummaries {
+public:
+    static constexpr uint32_t kAll = ~0u;
+
+    uint32_t of(std::string_view callee) const;
+    bool has(std::string_view callee) const;
+    void set(const std::string& callee, uint32_t mask) { masks_[callee] = mask; }
+
+private:
+    std::unordered_map<std::string, uint32_t> masks_;
+};
+
+// Registers `code` (one emitted function) writes, with each jal adding what
+// `callees` records for its target, and so does a j to a function `callees`
+// knows (a tail call). $sp, $fp and $ra are left out: every emitted function
+// restores them before it returns.
+uint32_t clobberedRegisters(const std::vector<MIPSInstruction>& code, const ClobberSummaries& callees);
+
+// Whether the call at instruction i of `function` is a tail call: a call or
+// callr whose result, if any, is what the function returns right after it
+// (only labels in between). A call without a result qualifies in a void
+// function, also when nothing but labels follows it.
+bool isTailCall(const IRFunction& function, size_t i);
+
+} // namespace ircpp
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+
+#include "inliner.hpp"
+#include "instruction_selector.hpp"
+#include "peephole.hpp"
+
+namespace ircpp {
+
+// On-disk cache of emitted assembly, one entry per IR function. An entry is
+// keyed by a 128-bit hash of the function's #start_function ... #end_function
+// text together with a configuration string (allocation mode, cache format,
+// identity of the compiler binary) and a caller-supplied context, so any
+// change to one of them is a miss.
+// Entries are written to a temporary file and renamed into place, so readers
+// never see a partial entry and concurrent builds may share a directory.
+class CompileCache {
+public:
+    struct Key { uint64_t hi, lo; };
+
+    // `dir` is created on first store if it does not exist.
+    CompileCache(std::string dir, std::string config);
+
+    Key keyFor(std::string_view functionText, std::string_view context = {}) const;
+    // On a hit, replaces `text` with the cached assembly and `clobbers` with
+    // the mask stored alongside it. An entry that cannot be read or is
+    // malformed counts as a miss.
+    bool lookup(const Key& key, std::string& text, uint32_t& clobbers);
+    // Failing to write an entry is not an error; the next build just misses.
+    void store(const Key& key, uint32_t clobbers, std::string_view text);
+
+    size_t hits() const { return hits_; }
+    size_t misses() const { return misses_; }
+
+private:
+    std::string pathFor(const Key& key) const;
+
+    std::string dir_;
+    std::string config_;
+    bool dirReady_ = false;
+    size_t hits_ = 0;
+    size_t misses_ = 0;
+};
+
+// Compile IR text to assembly, reusing cached code for unchanged functions and
+// parsing and selecting only the functions that miss. A function's code
+// depends on its callees' clobber summaries, so those are part of its key
+// and stored with its entry. The result is byte-identical to
+// generateAssembly(selectProgram(...)) on the whole text, with the call
+// graph taken from the text before `prepare`.
+// Binary IR, and text that splitFunctions rejects, is compiled normally
+// without the cache. `prepare`, if set, runs on each parsed function before
+// selection; whatever it depends on belongs in the cache's configuration.
+// With `inlining`, leaf calls are inlined first (inliner.hpp), and the text
+// of each leaf a function calls joins its key.
+// With `peephole`, each selected function is run through it after its
+// clobber summary is taken, as selectProgram's output would be; only misses
+// add to its hit counts.
+std::string compileWithCache(std::string_view irText, const IRReader& reader,
+                             IRToMIPSSelector& selector, CompileCache& cache,
+                             const std::function<void(IRFunction&)>& prepare = nullptr,
+                             const InlineLimits* inlining = nullptr,
+                             PeepholeOptimizer* peephole = nullptr);
+
+// Configuration string for CompileCache covering the allocation mode and the
+// running compiler binary, so a rebuilt backend does not reuse stale code.
+std::string cacheConfigFor(const IRToMIPSSelector& selector);
+
+} // namespace ircpp
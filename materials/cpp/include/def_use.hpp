@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "ir.hpp"
+
+namespace ircpp {
+
+// Every read and write of each scalar variable in a function, in instruction
+// order. Occurrences of variable v are entries [begin[v], begin[v + 1]) of the
+// flat pos/flags arrays; an instruction that both reads and writes v (add x,
+// x, 1) is one entry with both flags. Built in two linear passes, so its size
+// is the number of variable operands rather than instructions x variables.
+struct DefUseIndex {
+    static constexpr uint32_t kNone = UINT32_MAX;
+    enum : uint8_t { Use = 1, Def = 2 };
+
+    std::vector<uint32_t> begin; // size variables + 1
+    std::vector<uint32_t> pos;   // instruction index
+    std::vector<uint8_t> flags;  // Use | Def
+    std::vector<uint32_t> defBefore; // per entry: position of the variable's previous write, or kNone
+
+    static DefUseIndex build(const IRFunction& function);
+
+    size_t occurrences(uint32_t var) const { return begin[var + 1] - begin[var]; }
+
+    // First instruction in (after, limit] that reads `var` before any write
+    // to it; kNone if the value held after `after` is dead within the range.
+    // O(log occurrences of var).
+    uint32_t nextUse(uint32_t var, uint32_t after, uint32_t limit) const;
+    // Last instruction before `at` that writes `var`, kNone if none. Within a
+    // block this is the definition reaching `at`. O(log occurrences of var).
+    uint32_t prevDef(uint32_t var, uint32_t at) const;
+
+private:
+    // Index of the first occurrence of var after instruction `after`.
+    uint32_t firstAfter(uint32_t var, uint32_t after) const;
+};
+
+} // namespace ircpp
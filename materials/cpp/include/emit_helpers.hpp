@@ -15,19 +15,19 @@ namespace ircpp {
 // - Scalar variables -> lw dst, off($fp)
 // - Array variables -> lw dst, off($fp) (loads base pointer for params)
 void emitLoadOperand(const FrameInfo& fi,
-                     const std::shared_ptr<IROperand>& op,
+                     const IROperand* op,
                      const std::shared_ptr<Register>& dst,
                      std::vector<MIPSInstruction>& code);
 
 // Store general-purpose register to a scalar variable slot
 void emitStoreVar(const FrameInfo& fi,
-                  const std::string& name,
+                  const IRVariableOperand* var,
                   const std::shared_ptr<Register>& src,
                   std::vector<MIPSInstruction>& code);
 
 // Compute element address for arrayName[indexReg] into addrReg using baseReg as temp
 void emitComputeArrayAddr(const FrameInfo& fi,
-                          const std::string& arrayName,
+                          const IRVariableOperand* array,
                           const std::shared_ptr<Register>& indexReg,
                           const std::shared_ptr<Register>& addrReg,
                           const std::shared_ptr<Register>& baseReg,
@@ -35,15 +35,24 @@ void emitComputeArrayAddr(const FrameInfo& fi,
 
 // Float helpers
 void emitStoreF32(const FrameInfo& fi,
-                  const std::string& name,
+                  const IRVariableOperand* var,
                   const std::shared_ptr<Register>& fSrc,
                   std::vector<MIPSInstruction>& code);
 
 void emitLoadF32(const FrameInfo& fi,
-                 const std::shared_ptr<IROperand>& op,
+                 const IROperand* op,
                  const std::shared_ptr<Register>& fDst,
                  std::vector<MIPSInstruction>& code);
 
+// Whether the call at instruction i of `func` is a tail call (isTailCall)
+// that may leave through emitTailJump: every argument travels in $a0-$a3,
+// and none is an array living in this frame.
+bool canJumpToTailCallee(const FrameInfo& fi, const IRFunction& func, size_t i);
+
+// Leave as the epilogue does, then jump to `callee` instead of returning;
+// the callee returns straight to this function's caller.
+void emitTailJump(const FrameInfo& fi, const std::string& callee, std::vector<MIPSInstruction>& code);
+
 } // namespace ircpp
 
 
@@ -1,27 +1,34 @@
 #pragma once
 
-#include <unordered_map>
-#include <unordered_set>
 #include <string>
+#include <vector>
 #include <memory>
 
 #include "ir.hpp"
 
 namespace ircpp {
 
+// Frame layout, indexed by IRVariableOperand::id.
 struct FrameInfo {
-    std::unordered_map<std::string,int> varOffset; // offset from $fp (>=8)
-    std::unordered_set<std::string> paramArrayNames; // array params passed by pointer
-    std::unordered_set<std::string> localArrayNames; // arrays allocated in frame
+    std::vector<int> varOffset;     // offset from $fp (>=8)
+    std::vector<bool> isParamArray; // array params passed by pointer
+    std::vector<bool> isLocalArray; // arrays allocated in frame
+    int savedOffset{0};             // slots keeping registers across calls
     int frameBytes{0};
+
+    int offsetOf(const IRVariableOperand* v) const { return varOffset[v->id]; }
+    int savedSlot(uint32_t k) const { return savedOffset + 4 * int(k); }
+    bool passedByPointer(const IRVariableOperand* v) const { return isParamArray[v->id]; }
 };
 
-// Build stack frame layout for a function
-FrameInfo buildFrame(const IRFunction& func);
+// Build stack frame layout for a function, with slots after the variables to
+// keep `savedRegs` registers across calls
+FrameInfo buildFrame(const IRFunction& func, uint32_t savedRegs = 0);
 
 // Qualify an IR label with function name to ensure uniqueness
 std::string qualLabel(const std::string& fn, const std::string& lbl);
 
-} // namespace ircpp
-
+// Qualified names of every label in `func`, indexed by IRLabelOperand::id
+std::vector<std::string> qualLabels(const IRFunction& func);
 
+} // namespace ircpp
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+
+#include "ir.hpp"
+
+namespace ircpp {
+
+// How much the leaf inliner may copy. Sizes count instructions other than
+// labels.
+struct InlineLimits {
+    uint32_t calleeSize = 32;    // largest function body worth inlining
+    uint32_t callerGrowth = 256; // most instructions inlining may add to one caller
+
+    // "inline(<calleeSize>,<callerGrowth>)", for PassManager::describe.
+    std::string describe() const;
+};
+
+// Replaces calls in `caller` to small leaf functions, ones that call nothing
+// the program defines, with a copy of the callee's body. `leaf` maps a call's
+// target to that function, or nullptr if it is not a leaf of this program.
+// Callees with local arrays are left alone, as are calls whose argument or
+// result types differ from the callee's. Sites nested in more loops, then
+// sites of smaller callees, go first while limits.callerGrowth allows.
+//
+// The copy's variables and labels are named qualLabel(callee, name), with a
+// numeric suffix if the caller already has that name. A scalar parameter
+// becomes a copy of its argument; an array parameter is the argument array
+// itself, as arrays are passed by reference. `return x` assigns x to the
+// callr's result and jumps past the copy.
+// Returns the number of calls replaced.
+uint32_t inlineLeafCalls(IRFunction& caller, const std::function<const IRFunction*(std::string_view)>& leaf,
+                         const InlineLimits& limits);
+
+// Same for every function of `program`. Leaves are decided and copied before
+// any caller changes, so a function that only becomes a leaf through
+// inlining is not inlined itself.
+uint32_t inlineLeafCalls(IRProgram& program, const InlineLimits& limits);
+
+} // namespace ircpp
@@ -4,6 +4,7 @@
 #include <vector>
 #include <memory>
 #include <unordered_map>
+#include "call_graph.hpp"
 #include "ir.hpp"
 #include "mips_instructions.hpp"
 #include "register_manager.hpp"
@@ -49,12 +50,12 @@ public:
     
     // TODO: Implement operand handling
     // Convert IR operand to MIPS operand (register/immediate)
-    std::shared_ptr<MIPSOperand> convertOperand(std::shared_ptr<IROperand> irOp, 
+    std::shared_ptr<MIPSOperand> convertOperand(const IROperand* irOp, 
                                                SelectionContext& ctx);
     
     // TODO: Implement register allocation for operands
     // Get or allocate register for IR operand
-    std::shared_ptr<Register> getRegisterForOperand(std::shared_ptr<IROperand> irOp, 
+    std::shared_ptr<Register> getRegisterForOperand(const IROperand* irOp, 
                                                    SelectionContext& ctx);
 };
 
@@ -95,11 +96,23 @@ public:
     
     // TODO: Implement program selection
     // Convert entire IR program to MIPS assembly
-    std::vector<MIPSInstruction> selectProgram(const IRProgram& program);
+    // `calls` orders selection (see selectFunction); by default it is built
+    // from `program`. Pass the graph of the program as read when passes have
+    // changed it since, as the compile cache builds its graph from the text.
+    std::vector<MIPSInstruction> selectProgram(const IRProgram& program, const CallGraph* calls = nullptr);
     
-    // TODO: Implement function selection
-    // Convert IR function to MIPS assembly
-    std::vector<MIPSInstruction> selectFunction(const IRFunction& function);
+    // Program entry stub (call main, then exit); selectProgram emits it first.
+    std::vector<MIPSInstruction> selectEntry();
+
+    // Convert one IR function to MIPS using the current allocation mode.
+    // Greedy code keeps values in registers across calls to functions whose
+    // summary in `callees` spares them; every other call clobbers them all.
+    // selectProgram is selectEntry followed by selectFunction for each
+    // function in order, selected bottom-up over the call graph so each
+    // call sees its callee's summary when the callee is not recursive with
+    // the caller.
+    std::vector<MIPSInstruction> selectFunction(const IRFunction& function,
+                                                const ClobberSummaries* callees = nullptr);
     
     // TODO: Implement instruction-by-instruction selection
     // Select MIPS instructions for a single IR instruction
@@ -109,6 +122,9 @@ public:
     // TODO: Implement assembly generation
     // Generate MIPS assembly text from instructions
     std::string generateAssembly(const std::vector<MIPSInstruction>& instructions);
+    // Same text without the leading .text directive, for assembling output
+    // from separately selected pieces.
+    std::string generateText(const std::vector<MIPSInstruction>& instructions);
     
     // TODO: Implement file output
     // Write MIPS assembly to file
@@ -4,27 +4,48 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <vector>
 #include <memory>
 #include <unordered_map>
+#include <unordered_set>
+#include <initializer_list>
 #include <stdexcept>
 #include <iostream>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <utility>
 
 namespace ircpp {
 
 // Forward decls
 struct IRInstruction;
 
-// Datatypes
+// Datatypes. Each type carries a kind tag so callers can classify it with a
+// compare instead of dynamic_cast.
+struct IRArrayType;
+
 struct IRType {
+    enum class Kind : uint8_t { Int, Float, Array };
+    const Kind kind;
+    explicit IRType(Kind k) : kind(k) {}
     virtual ~IRType() = default;
+
+    bool isInt() const { return kind == Kind::Int; }
+    bool isFloat() const { return kind == Kind::Float; }
+    bool isArray() const { return kind == Kind::Array; }
+    // nullptr unless this is an array type
+    inline const IRArrayType* asArray() const;
 };
 
 struct IRIntType : public IRType {
+    IRIntType() : IRType(Kind::Int) {}
     static std::shared_ptr<IRIntType> get();
 };
 
 struct IRFloatType : public IRType {
+    IRFloatType() : IRType(Kind::Float) {}
     static std::shared_ptr<IRFloatType> get();
 };
 
@@ -36,37 +57,154 @@ private:
     IRArrayType(std::shared_ptr<IRType> elementType, int size);
 };
 
-// Operands
+inline const IRArrayType* IRType::asArray() const {
+    return isArray() ? static_cast<const IRArrayType*>(this) : nullptr;
+}
+
+// Bump allocator that owns one function's instructions, operands and operand
+// text. Objects are carved out of blocks that double in size (most functions
+// fit in the first one) and are never destroyed one by one; reset() (or
+// destroying the arena) releases everything at once, which is why only
+// trivially destructible types may be allocated here.
+class IRArena {
+public:
+    static constexpr size_t kMaxBlockSize = 256 * 1024;
+
+    explicit IRArena(size_t firstBlockSize = 2048) : firstBlockSize_(firstBlockSize), nextBlockSize_(firstBlockSize) {}
+    IRArena(const IRArena&) = delete;
+    IRArena& operator=(const IRArena&) = delete;
+
+    void* allocate(size_t bytes, size_t align);
+
+    template <typename T, typename... Args>
+    T* make(Args&&... args) {
+        static_assert(std::is_trivially_destructible<T>::value, "IRArena never runs destructors");
+        return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+    }
+
+    // Copy `s` into the arena and return a view of the copy.
+    std::string_view copyString(std::string_view s);
+
+    // Release every allocation. The first block is kept for reuse.
+    void reset();
+
+    size_t bytesUsed() const { return bytesUsed_; }
+    size_t blockCount() const { return blocks_.size(); }
+
+private:
+    struct Block { std::unique_ptr<char[]> data; size_t size; };
+    std::vector<Block> blocks_;
+    char* cur_ = nullptr;
+    char* end_ = nullptr;
+    size_t firstBlockSize_;
+    size_t nextBlockSize_;
+    size_t bytesUsed_ = 0;
+};
+
+// Operands. All operands are allocated in their function's IRArena; a variable
+// operand is shared by every instruction that names that variable. Operands
+// are not polymorphic: the kind tag says which subclass an operand is, and the
+// as*() accessors return a typed, non-owning view (nullptr on a mismatch).
+struct IRConstantOperand;
+struct IRVariableOperand;
+struct IRLabelOperand;
+struct IRFunctionOperand;
+
 struct IROperand {
-    std::string value;
-    IRInstruction* parent;
-    explicit IROperand(std::string v, IRInstruction* p) : value(std::move(v)), parent(p) {}
-    virtual ~IROperand() = default;
-    virtual std::string toString() const { return value; }
+    enum class Kind : uint8_t { Constant, Variable, Label, Function };
+    Kind kind;
+    std::string_view value; // arena-owned text
+    IROperand(Kind k, std::string_view v) : kind(k), value(v) {}
+    std::string toString() const { return std::string(value); }
+
+    bool isConstant() const { return kind == Kind::Constant; }
+    bool isVariable() const { return kind == Kind::Variable; }
+    bool isLabel() const { return kind == Kind::Label; }
+    bool isFunction() const { return kind == Kind::Function; }
+    inline const IRConstantOperand* asConstant() const;
+    inline const IRVariableOperand* asVariable() const;
+    inline const IRLabelOperand* asLabel() const;
+    inline const IRFunctionOperand* asFunction() const;
 };
 
+// Constants are decoded once by the reader; `value` keeps the source spelling
+// for printing. intValue is meaningful for int constants, floatValue for
+// float constants.
 struct IRConstantOperand : public IROperand {
-    std::shared_ptr<IRType> type;
-    IRConstantOperand(std::shared_ptr<IRType> t, const std::string& v, IRInstruction* p)
-        : IROperand(v, p), type(std::move(t)) {}
-    std::string getValueString() const { return value; }
+    const IRType* type;
+    int32_t intValue{0};
+    float floatValue{0.0f};
+    IRConstantOperand(const IRType* t, std::string_view v, int32_t i) : IROperand(Kind::Constant, v), type(t), intValue(i) {}
+    IRConstantOperand(const IRType* t, std::string_view v, float f) : IROperand(Kind::Constant, v), type(t), floatValue(f) {}
+    std::string getValueString() const { return std::string(value); }
+    // Value as a 32-bit immediate. Float constants are truncated toward zero,
+    // as the emitters do not materialize float constants yet.
+    int32_t immediate() const { return type->isFloat() ? static_cast<int32_t>(floatValue) : intValue; }
 };
 
 struct IRFunctionOperand : public IROperand {
-    IRFunctionOperand(const std::string& name, IRInstruction* p) : IROperand(name, p) {}
-    std::string getName() const { return value; }
+    explicit IRFunctionOperand(std::string_view name) : IROperand(Kind::Function, name) {}
+    std::string getName() const { return std::string(value); }
 };
 
+// Label and variable operands carry a dense per-function symbol id assigned at
+// parse time, so backend tables can be flat vectors indexed by id instead of
+// maps keyed by name.
 struct IRLabelOperand : public IROperand {
-    IRLabelOperand(const std::string& name, IRInstruction* p) : IROperand(name, p) {}
-    std::string getName() const { return value; }
+    uint32_t id; // index into IRFunction::labels
+    IRLabelOperand(std::string_view name, uint32_t labelId) : IROperand(Kind::Label, name), id(labelId) {}
+    std::string getName() const { return std::string(value); }
 };
 
 struct IRVariableOperand : public IROperand {
-    std::shared_ptr<IRType> type;
-    IRVariableOperand(std::shared_ptr<IRType> t, const std::string& name, IRInstruction* p)
-        : IROperand(name, p), type(std::move(t)) {}
-    std::string getName() const { return value; }
+    const IRType* type;
+    uint32_t id; // index into IRFunction::variables
+    // The source variable this is an SSA version of; its own id otherwise.
+    uint32_t origin;
+    IRVariableOperand(const IRType* t, std::string_view name, uint32_t varId)
+        : IROperand(Kind::Variable, name), type(t), id(varId), origin(varId) {}
+    std::string getName() const { return std::string(value); }
+    bool isArray() const { return type->isArray(); }
+};
+
+inline const IRConstantOperand* IROperand::asConstant() const {
+    return isConstant() ? static_cast<const IRConstantOperand*>(this) : nullptr;
+}
+inline const IRVariableOperand* IROperand::asVariable() const {
+    return isVariable() ? static_cast<const IRVariableOperand*>(this) : nullptr;
+}
+inline const IRLabelOperand* IROperand::asLabel() const {
+    return isLabel() ? static_cast<const IRLabelOperand*>(this) : nullptr;
+}
+inline const IRFunctionOperand* IROperand::asFunction() const {
+    return isFunction() ? static_cast<const IRFunctionOperand*>(this) : nullptr;
+}
+
+// Operand list of one instruction. Up to kInline operands are stored inside the
+// instruction; longer lists (calls with many arguments) move to the arena.
+class IROperandList {
+public:
+    static constexpr size_t kInline = 4;
+
+    size_t size() const { return count_; }
+    bool empty() const { return count_ == 0; }
+    IROperand* operator[](size_t i) const { return data()[i]; }
+    IROperand*& operator[](size_t i) { return data()[i]; }
+    IROperand* const* begin() const { return data(); }
+    IROperand* const* end() const { return data() + count_; }
+
+    void push_back(IRArena& arena, IROperand* op);
+    // Drop the operands from index `n` onward.
+    void truncate(size_t n) { if (n < count_) count_ = static_cast<uint32_t>(n); }
+
+private:
+    IROperand** data() { return heap_ ? heap_ : inline_; }
+    IROperand* const* data() const { return heap_ ? heap_ : inline_; }
+
+    IROperand* inline_[kInline] = {};
+    IROperand** heap_ = nullptr;
+    uint32_t count_ = 0;
+    uint32_t capacity_ = kInline;
 };
 
 // Core IR
@@ -79,18 +217,88 @@ struct IRInstruction {
         RETURN,
         CALL, CALLR,
         ARRAY_STORE, ARRAY_LOAD,
-        LABEL
+        LABEL,
+        // Only exists between SSA construction and destruction (ssa.hpp);
+        // the reader, binary format and emitters never see it. Operands are
+        // the result, then one (value, predecessor label) pair per
+        // predecessor.
+        PHI
     };
 
     OpCode opCode{};
-    std::vector<std::shared_ptr<IROperand>> operands;
     int irLineNumber{};
+    IROperandList operands;
 
     IRInstruction() = default;
-    IRInstruction(OpCode code, std::vector<std::shared_ptr<IROperand>> ops, int line)
-        : opCode(code), operands(std::move(ops)), irLineNumber(line) {}
+    IRInstruction(OpCode code, int line) : opCode(code), irLineNumber(line) {}
+
+    // The scalar variable this instruction writes, or nullptr. Array stores
+    // and bulk array assigns write memory, not a variable.
+    inline const IRVariableOperand* scalarDef() const;
+    // BREQ, BRNEQ, BRLT, BRGT or BRGEQ: jumps to operand 0 or falls through.
+    bool isConditionalBranch() const {
+        return opCode == OpCode::BREQ || opCode == OpCode::BRNEQ || opCode == OpCode::BRLT ||
+               opCode == OpCode::BRGT || opCode == OpCode::BRGEQ;
+    }
+    // GOTO or a conditional branch: any instruction whose operand 0 is the
+    // label it may jump to.
+    bool isJump() const { return opCode == OpCode::GOTO || isConditionalBranch(); }
+    // Calls f(const IRVariableOperand*) for every scalar variable operand the
+    // instruction reads, in operand order (repeats included).
+    template <class F> void forEachScalarUse(F&& f) const;
+    // Same walk, but calls f(size_t k) with the operand index, for passes
+    // that rewrite the operand in place.
+    template <class F> void forEachScalarUseIndex(F&& f) const;
 };
 
+inline const IRVariableOperand* IRInstruction::scalarDef() const {
+    switch (opCode) {
+        case OpCode::ASSIGN:
+        case OpCode::ADD: case OpCode::SUB: case OpCode::MULT:
+        case OpCode::DIV: case OpCode::AND: case OpCode::OR:
+        case OpCode::ARRAY_LOAD:
+        case OpCode::CALLR:
+        case OpCode::PHI: {
+            auto v = operands.size() ? operands[0]->asVariable() : nullptr;
+            return v && !v->isArray() ? v : nullptr;
+        }
+        default:
+            return nullptr;
+    }
+}
+
+template <class F> void IRInstruction::forEachScalarUseIndex(F&& f) const {
+    auto use = [&](size_t k) {
+        if (k >= operands.size()) return;
+        auto v = operands[k]->asVariable();
+        if (v && !v->isArray()) f(k);
+    };
+    switch (opCode) {
+        case OpCode::ASSIGN: use(1); use(2); break; // 3 operands: array, count, value
+        case OpCode::ADD: case OpCode::SUB: case OpCode::MULT:
+        case OpCode::DIV: case OpCode::AND: case OpCode::OR:
+        case OpCode::BREQ: case OpCode::BRNEQ: case OpCode::BRLT:
+        case OpCode::BRGT: case OpCode::BRGEQ:
+            use(1); use(2); break;
+        case OpCode::RETURN: use(0); break;
+        case OpCode::ARRAY_STORE: use(0); use(2); break;
+        case OpCode::ARRAY_LOAD: use(2); break;
+        case OpCode::CALL: case OpCode::CALLR:
+            for (size_t k = opCode == OpCode::CALLR ? 2 : 1; k < operands.size(); ++k) use(k);
+            break;
+        // Every incoming value, as if read at the top of the block; passes
+        // that need per-edge precision look at the pairs themselves.
+        case OpCode::PHI:
+            for (size_t k = 1; k < operands.size(); k += 2) use(k);
+            break;
+        default: break;
+    }
+}
+
+template <class F> void IRInstruction::forEachScalarUse(F&& f) const {
+    forEachScalarUseIndex([&](size_t k) { f(operands[k]->asVariable()); });
+}
+
 struct IRFunction;
 
 struct IRProgram {
@@ -98,19 +306,44 @@ struct IRProgram {
 };
 
 struct IRFunction {
+    // Owns every instruction and operand referenced below. Declared first so it
+    // is destroyed after the pointer vectors.
+    IRArena arena;
     std::string name;
     std::shared_ptr<IRType> returnType; // nullptr for void
-    std::vector<std::shared_ptr<IRVariableOperand>> parameters;
-    std::vector<std::shared_ptr<IRVariableOperand>> variables;
-    std::vector<std::shared_ptr<IRInstruction>> instructions;
+    std::vector<IRVariableOperand*> parameters;
+    // Symbol tables, indexed by operand id. Variables are numbered parameters
+    // first, then in declaration order; labels in order of first mention.
+    std::vector<IRVariableOperand*> variables;
+    std::vector<std::string_view> labels;
+    std::vector<IRInstruction*> instructions;
 
-    IRFunction(std::string n,
-               std::shared_ptr<IRType> ret,
-               std::vector<std::shared_ptr<IRVariableOperand>> params,
-               std::vector<std::shared_ptr<IRVariableOperand>> vars,
-               std::vector<std::shared_ptr<IRInstruction>> insts)
-        : name(std::move(n)), returnType(std::move(ret)), parameters(std::move(params)),
-          variables(std::move(vars)), instructions(std::move(insts)) {}
+    IRFunction(std::string n, std::shared_ptr<IRType> ret)
+        : name(std::move(n)), returnType(std::move(ret)) {}
+
+    // A new label, appended to `labels`: named `base`, or base_N with the
+    // smallest N >= 1 if that is taken. For passes that add control flow.
+    IRLabelOperand* addLabel(std::string_view base);
+    // A new instruction on the arena, not yet placed in `instructions`.
+    IRInstruction* makeInstruction(IRInstruction::OpCode op, int line, std::initializer_list<IROperand*> ops);
+
+    // Drop the function body. All instruction and operand memory is returned
+    // with a single arena reset.
+    void releaseIR() {
+        parameters.clear();
+        variables.clear();
+        labels.clear();
+        instructions.clear();
+        labelNames_.clear();
+        labelNamesSeen_ = 0;
+        arena.reset();
+    }
+
+private:
+    // Names of labels[0, labelNamesSeen_), caught up by addLabel; labels are
+    // only ever appended.
+    std::unordered_set<std::string_view> labelNames_;
+    size_t labelNamesSeen_ = 0;
 };
 
 // Exceptions
@@ -127,9 +360,49 @@ struct IRPrinter {
     void printInstruction(const IRInstruction& instruction) const;
 };
 
+// Binary IR writer. The format is versioned and keeps interned symbols, ids,
+// typed constants and array types, so reading it back needs no lexing; see
+// ir_binary.cpp for the layout.
+struct IRBinaryWriter {
+    std::ostream& os;
+    explicit IRBinaryWriter(std::ostream& out) : os(out) {}
+    void writeProgram(const IRProgram& program) const;
+};
+
 // Reader (parser)
 struct IRReader {
+    // Worker threads used to parse function bodies; 0 means one per hardware thread.
+    unsigned parseThreads = 0;
+
     IRProgram parseIRFile(const std::string& filename) const; // May throw IRException
+    // Same result as parseIRFile, but maps the file read-only and lexes lines and
+    // tokens as views into the mapping; text is only copied when names are interned.
+    IRProgram parseIRFileMapped(const std::string& filename) const;
+    // Parse IR text that is already in memory. `text` only needs to outlive the call.
+    IRProgram parseIRString(std::string_view text) const;
+    // Decode IR written by IRBinaryWriter. `data` only needs to outlive the call.
+    IRProgram parseIRBinary(std::string_view data) const;
+    // Split IR text into its #start_function ... #end_function blocks, each a
+    // view into `text` from the start of its first line to the end of its
+    // last. Returns false (leaving `blocks` unspecified) if anything but blank
+    // lines sits outside a block or the markers do not pair up; callers then
+    // fall back to parseIRString, which reports the error.
+    static bool splitFunctions(std::string_view text, std::vector<std::string_view>& blocks);
+    // Name of the function in one splitFunctions block and the names its
+    // call/callr instructions target, in order, as parseIRString would read
+    // them but without building anything. Returns false if the block is too
+    // malformed to tell; parsing it throws.
+    static bool scanCalls(std::string_view block, std::string_view& name, std::vector<std::string_view>& callees);
+    // True if `data` starts with the binary IR magic. parseIRFile and
+    // parseIRFileMapped use this to accept either format.
+    static bool isBinaryIR(std::string_view data);
+    // Operand types `inst` must have for its opcode, checked by both the text
+    // and the binary reader: matching scalar types for arithmetic, copies and
+    // compares, an int index and matching element type for array accesses,
+    // and a scalar variable wherever a result is written. Operand kinds and
+    // counts are the caller's to check first. Throws IRException("Invalid
+    // operand").
+    static void checkOperandTypes(const IRInstruction& inst);
 };
 
 // Interpreter
@@ -148,40 +421,80 @@ private:
     IRInterpreterStats stats;
 };
 
-// Control Flow Graph structures
+// Control flow graph of one function. Blocks are numbered densely in
+// instruction order, so block 0 is the entry. A block is the inclusive range
+// [first, last] of IRFunction::instructions; a LABEL or the instruction after
+// a GOTO, branch or RETURN starts a new one. Calls do not end a block. Edges
+// live in two flat arrays (successors, predecessors) that each block indexes
+// by [begin, end).
 struct BasicBlock {
-    std::string id;
-    std::vector<std::shared_ptr<IRInstruction>> instructions;
-    std::vector<std::string> predecessors;
-    std::vector<std::string> successors;
-    
-    BasicBlock(const std::string& blockId) : id(blockId) {}
+    uint32_t first = 0, last = 0;
+    uint32_t succBegin = 0, succEnd = 0;
+    uint32_t predBegin = 0, predEnd = 0;
 };
 
 struct ControlFlowGraph {
-    std::unordered_map<std::string, std::shared_ptr<BasicBlock>> blocks;
-    std::string entryBlock;
-    std::vector<std::string> exitBlocks;
-    
-    void addBlock(std::shared_ptr<BasicBlock> block) {
-        blocks[block->id] = block;
-    }
-    
-    void addEdge(const std::string& from, const std::string& to) {
-        if (blocks.count(from) && blocks.count(to)) {
-            blocks[from]->successors.push_back(to);
-            blocks[to]->predecessors.push_back(from);
-        }
+    static constexpr uint32_t kNone = UINT32_MAX;
+
+    // A view of one block's slice of an edge or child array.
+    struct BlockList {
+        const uint32_t* b;
+        const uint32_t* e;
+        const uint32_t* begin() const { return b; }
+        const uint32_t* end() const { return e; }
+        size_t size() const { return static_cast<size_t>(e - b); }
+        bool empty() const { return b == e; }
+    };
+
+    const IRFunction* function = nullptr;
+    std::vector<BasicBlock> blocks;
+    std::vector<uint32_t> succs;        // for a branch: target first, then fallthrough
+    std::vector<uint32_t> preds;
+    std::vector<uint32_t> labelBlock;   // label id -> block it starts, kNone if undefined
+
+    // Reachable blocks in reverse postorder from the entry; rpoIndex maps a
+    // block back to its position, kNone if it is unreachable.
+    std::vector<uint32_t> rpo;
+    std::vector<uint32_t> rpoIndex;
+
+    // Dominator tree over reachable blocks. idom of the entry is the entry
+    // itself; kNone for unreachable blocks. Children are a flat array like the
+    // edges, and domPre/domPost are tree preorder/postorder numbers, so a
+    // dominance query is two compares.
+    std::vector<uint32_t> idom;
+    std::vector<uint32_t> domChildBegin; // size blocks.size() + 1
+    std::vector<uint32_t> domChildren;
+    std::vector<uint32_t> domPre, domPost;
+
+    size_t size() const { return blocks.size(); }
+    BlockList successors(uint32_t b) const { return {succs.data() + blocks[b].succBegin, succs.data() + blocks[b].succEnd}; }
+    BlockList predecessors(uint32_t b) const { return {preds.data() + blocks[b].predBegin, preds.data() + blocks[b].predEnd}; }
+    BlockList domTreeChildren(uint32_t b) const { return {domChildren.data() + domChildBegin[b], domChildren.data() + domChildBegin[b + 1]}; }
+    bool reachable(uint32_t b) const { return rpoIndex[b] != kNone; }
+    // True if every path from the entry to `b` passes through `a` (a block
+    // dominates itself). False if either block is unreachable.
+    bool dominates(uint32_t a, uint32_t b) const {
+        return reachable(a) && reachable(b) && domPre[a] <= domPre[b] && domPost[b] <= domPost[a];
     }
+    // Block holding instruction index `i`.
+    uint32_t blockOf(uint32_t i) const;
 };
 
+struct LoopInfo; // loops.hpp
+
 struct CFGBuilder {
     static ControlFlowGraph buildCFG(const IRFunction& function);
     static void printCFG(const ControlFlowGraph& cfg, std::ostream& os);
-    static void printCFGDot(const ControlFlowGraph& cfg, std::ostream& os);
+    // Graphviz digraph named after the function; one node per block listing
+    // its IR, unreachable blocks drawn dashed. With `loops`, each block is
+    // tagged with its loop depth and each header with its induction variables
+    // and trip count, and back edges are drawn bold.
+    static void printCFGDot(const ControlFlowGraph& cfg, std::ostream& os, const LoopInfo* loops = nullptr);
 private:
-    static std::vector<std::shared_ptr<BasicBlock>> identifyBasicBlocks(const IRFunction& function);
-    static void buildEdges(ControlFlowGraph& cfg, const std::vector<std::shared_ptr<BasicBlock>>& blocks);
+    static void identifyBasicBlocks(ControlFlowGraph& cfg);
+    static void buildEdges(ControlFlowGraph& cfg);
+    static void computeOrder(ControlFlowGraph& cfg);
+    static void computeDominators(ControlFlowGraph& cfg);
 };
 
 } // namespace ircpp
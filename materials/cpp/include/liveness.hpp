@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "ir.hpp"
+
+namespace ircpp {
+
+// Dense bitset over IRVariableOperand ids, sized for one function.
+struct VarSet {
+    std::vector<uint64_t> words;
+
+    VarSet() = default;
+    explicit VarSet(size_t nvars) : words((nvars + 63) / 64, 0) {}
+
+    bool test(uint32_t id) const { return (words[id >> 6] >> (id & 63)) & 1; }
+    void set(uint32_t id) { words[id >> 6] |= uint64_t(1) << (id & 63); }
+    void reset(uint32_t id) { words[id >> 6] &= ~(uint64_t(1) << (id & 63)); }
+    bool operator==(const VarSet& o) const { return words == o.words; }
+    bool operator!=(const VarSet& o) const { return words != o.words; }
+};
+
+// Global liveness of scalar variables over a function's CFG. Arrays live in
+// memory and are never tracked. Unreachable blocks get empty sets. A phi's
+// incoming value is live out of the predecessor it comes from, not into the
+// phi's block.
+struct Liveness {
+    std::vector<VarSet> liveIn;  // indexed by block
+    std::vector<VarSet> liveOut;
+
+    static Liveness compute(const IRFunction& function, const ControlFlowGraph& cfg);
+
+    // Step `live` backwards over one instruction: live = (live - def) + uses.
+    // A phi only kills its result; its reads happen on the incoming edges.
+    static void transfer(const IRInstruction& ir, VarSet& live);
+};
+
+} // namespace ircpp
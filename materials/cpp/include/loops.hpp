@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "ir.hpp"
+
+namespace ircpp {
+
+// A variable whose only write inside a loop is `add v, v, c` or `sub v, v, c`
+// (c an int constant), executed exactly once per iteration.
+struct InductionVariable {
+    const IRVariableOperand* var = nullptr;
+    uint32_t update = 0;                 // index of the add/sub in IRFunction::instructions
+    int32_t step = 0;                    // signed change per iteration
+    const IRConstantOperand* init = nullptr; // value on entry to the loop, nullptr if unknown
+};
+
+// One natural loop: a header plus every block that reaches one of its back
+// edges without passing through the header. Back edges sharing a header form
+// a single loop.
+struct Loop {
+    static constexpr uint32_t kNone = UINT32_MAX;
+
+    uint32_t header = 0;
+    uint32_t parent = kNone;           // enclosing loop in LoopInfo::loops
+    uint32_t depth = 1;                // 1 for an outermost loop
+    std::vector<uint32_t> blocks;      // sorted; includes nested loops' blocks
+    std::vector<uint32_t> latches;     // sources of the back edges
+    std::vector<uint32_t> exits;       // sorted blocks outside the loop entered from inside
+    std::vector<InductionVariable> inductionVariables;
+    // Number of times a back edge is taken before the loop exits, when the
+    // only exit is a compare of an induction variable with known start
+    // against an int constant. kNone otherwise, including loops that run
+    // until the variable overflows.
+    uint32_t tripCount = kNone;
+
+    bool contains(uint32_t block) const;
+};
+
+// Loop nest of one function over its CFG. Only natural loops are found, so
+// a cycle entered at more than one block (irreducible flow, which the IR
+// reader cannot rule out) is not a loop here.
+struct LoopInfo {
+    static constexpr uint32_t kNone = Loop::kNone;
+
+    std::vector<Loop> loops;             // every loop after the loop enclosing it
+    std::vector<uint32_t> blockLoop;     // innermost loop containing each block, kNone if none
+
+    static LoopInfo compute(const IRFunction& function, const ControlFlowGraph& cfg);
+
+    // Nesting depth of `block`; 0 outside every loop.
+    uint32_t depth(uint32_t block) const { return blockLoop[block] == kNone ? 0 : loops[blockLoop[block]].depth; }
+    bool isHeader(uint32_t block) const {
+        return blockLoop[block] != kNone && loops[blockLoop[block]].header == block;
+    }
+};
+
+} // namespace ircpp
@@ -142,4 +142,8 @@ namespace Registers {
 // Helper function to convert MIPSOp enum to string
 std::string opToString(MIPSOp op);
 
+// Hardware number of a general-purpose register by name ("t0" is 8), or -1
+// for anything else, floating-point registers included.
+int gprNumber(const std::string& name);
+
 } // namespace ircpp
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "def_use.hpp"
+#include "inliner.hpp"
+#include "ir.hpp"
+#include "liveness.hpp"
+#include "loops.hpp"
+
+namespace ircpp {
+
+// Analyses FunctionAnalyses can cache, as bits of a set. Dominators are part
+// of the ControlFlowGraph, so they come and go with Analysis::CFG.
+namespace Analysis {
+enum : uint32_t {
+    CFG = 1u << 0,
+    Liveness = 1u << 1,
+    Loops = 1u << 2,
+    DefUse = 1u << 3,
+};
+constexpr uint32_t kNone = 0;
+constexpr uint32_t kAll = CFG | Liveness | Loops | DefUse;
+} // namespace Analysis
+
+// Lazily computed analyses of one function. Each is built on first request
+// and kept until a pass reports that it no longer holds; anything built on
+// top of a dropped analysis (liveness and loops on the CFG) is dropped too.
+class FunctionAnalyses {
+public:
+    explicit FunctionAnalyses(const IRFunction& function) : function_(function) {}
+
+    const ControlFlowGraph& cfg();
+    const Liveness& liveness();
+    const LoopInfo& loops();
+    const DefUseIndex& defUse();
+
+    // Drop every analysis not in `preserved`.
+    void invalidate(uint32_t preserved);
+
+    // Number of analyses built so far, to see what caching saves.
+    size_t computed() const { return computed_; }
+
+private:
+    const IRFunction& function_;
+    std::optional<ControlFlowGraph> cfg_;
+    std::optional<Liveness> liveness_;
+    std::optional<LoopInfo> loops_;
+    std::optional<DefUseIndex> defUse_;
+    size_t computed_ = 0;
+};
+
+// An IR-to-IR transform over one function. run() returns the analyses that
+// are still valid afterwards: Analysis::kAll if nothing changed, otherwise
+// whatever the pass kept up to date. A pass that edits instructions but not
+// control flow can keep the CFG only if it leaves every instruction index
+// where it was.
+class FunctionPass {
+public:
+    virtual ~FunctionPass() = default;
+    virtual const char* name() const = 0;
+    virtual uint32_t run(IRFunction& function, FunctionAnalyses& analyses) = 0;
+};
+
+// An ordered list of function passes. Each function gets its own analysis
+// cache, shared by the passes in turn. With inlining on, a whole program
+// first has its leaf calls inlined (inliner.hpp); a single function cannot,
+// so callers compiling functions one by one do that step themselves.
+class PassManager {
+public:
+    void add(std::unique_ptr<FunctionPass> pass) { passes_.push_back(std::move(pass)); }
+    bool empty() const { return passes_.empty() && !inlining_; }
+
+    void setInlining(const InlineLimits& limits) { inlining_ = limits; }
+    // nullptr unless inlining is on.
+    const InlineLimits* inlining() const { return inlining_ ? &*inlining_ : nullptr; }
+
+    void run(IRFunction& function) const;
+    void run(IRProgram& program) const;
+
+    // Pass names in order, comma separated, after the inline limits if
+    // inlining is on. Part of the compile cache key, since it decides what
+    // code comes out.
+    std::string describe() const;
+
+    // The pipeline behind -O<level>: 0 runs nothing; 1 and 2 are listed in
+    // pass_manager.cpp, and 2 also inlines within `limits`. Throws
+    // IRException for other levels.
+    static PassManager forLevel(int level, const InlineLimits& limits = {});
+
+private:
+    std::vector<std::unique_ptr<FunctionPass>> passes_;
+    std::optional<InlineLimits> inlining_;
+};
+
+// Transforms the pipelines are built from.
+
+// Removes unreachable blocks, threads jumps to jumps, drops jumps to the
+// next block and labels nothing jumps to, and turns a branch over a goto into
+// one inverted branch.
+std::unique_ptr<FunctionPass> createSimplifyCFGPass();
+// Sparse conditional constant propagation over SSA form: folds int
+// arithmetic on constants, replaces reads of constant variables with the
+// constant, turns branches that always go one way into a goto or nothing,
+// and drops the blocks that leaves unreachable.
+std::unique_ptr<FunctionPass> createSCCPPass();
+// Global copy propagation over SSA form: reads of a variable copied from
+// another (or merged from one value by a phi) read the original instead, and
+// the copies go.
+std::unique_ptr<FunctionPass> createCopyPropagationPass();
+// Removes definitions no one reads, including values that only feed each
+// other, and turns a callr whose result is unused into a call. Calls, array
+// stores and divides that may fault always stay.
+std::unique_ptr<FunctionPass> createDeadCodeEliminationPass();
+// Dominator-based global value numbering over SSA form: an arithmetic
+// instruction or array load whose value a dominating one already computed is
+// deleted. Loads are only reused while no store, bulk assign or call may
+// have written the array in between; a store's value is reused by later
+// loads of the same element.
+std::unique_ptr<FunctionPass> createGVNPass();
+// Loop-invariant code motion: moves arithmetic, copies and array loads whose
+// value cannot change inside a loop to a preheader, adding one where the
+// loop has none.
+std::unique_ptr<FunctionPass> createLICMPass();
+// Turns self tail recursion into a loop: a call of the function itself whose
+// result it returns right away assigns the arguments to the parameters and
+// jumps back to the top of the body.
+std::unique_ptr<FunctionPass> createTailRecursionPass();
+// Takes the function into SSA form and straight back out (ssa.hpp). Alone it
+// only tidies the CFG; it is there to exercise the SSA passes.
+std::unique_ptr<FunctionPass> createSSARoundTripPass();
+
+} // namespace ircpp
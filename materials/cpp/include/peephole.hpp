@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+#include "mips_instructions.hpp"
+
+namespace ircpp {
+
+// One rewrite of the peephole optimizer. `window` is how many instructions
+// it looks at: the last `window` of the output so far. `apply` may rewrite
+// them (replace, erase, or leave fewer) and reports whether it did;
+// [next, end) are the instructions still to come, unchanged, for rules that
+// need to look ahead.
+struct PeepholeRule {
+    std::string name;
+    size_t window = 1;
+    std::function<bool(std::vector<MIPSInstruction>& out, const MIPSInstruction* next, const MIPSInstruction* end)> apply;
+};
+
+// Pattern-driven cleanup of selected code, run over the instructions of
+// selectProgram (or selectFunction) before generateAssembly. Instructions
+// move one at a time to the output; after each, the rules are tried in table
+// order on the end of the output, and after a rewrite all of them again, so
+// a result can match once more. The code's meaning is kept for every way
+// into the window: an instruction with a label is only ever removed or
+// changed as the first of its window, and then keeps its label.
+//
+// A rule that only drops or narrows writes keeps the code within the
+// clobber summary taken before it ran, so summaries stay valid.
+class PeepholeOptimizer {
+public:
+    // The default rules:
+    //   sw-lw      sw r, X; lw r2, X      -> sw r, X (and move r2, r if r2 != r)
+    //   move-self  move r, r              -> nothing
+    //   jump-next  j L where L labels the next instruction, or one after
+    //              label-only nops        -> nothing
+    //   li-add     li t, k; add d, a, t   -> addi d, a, k
+    //              (also add d, t, a, and sub with -k) when k fits 16 bits
+    //              and t is overwritten before it is read again
+    PeepholeOptimizer();
+
+    // Appends a rule; later rules are tried after earlier ones.
+    void addRule(PeepholeRule rule);
+
+    void run(std::vector<MIPSInstruction>& code);
+
+    const std::vector<PeepholeRule>& rules() const { return rules_; }
+    // Rewrites per rule, in table order, summed over every run.
+    const std::vector<uint64_t>& hits() const { return hits_; }
+    // "peephole: <name>=<hits> ..." on one line.
+    void printStats(std::ostream& os) const;
+
+private:
+    std::vector<PeepholeRule> rules_;
+    std::vector<uint64_t> hits_;
+};
+
+} // namespace ircpp
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "ir.hpp"
+
+namespace ircpp {
+
+// Rewrite `function` into pruned SSA form (Cytron et al.). Unreachable blocks
+// are dropped and every block gets a label, so phi operands can name their
+// predecessors; the entry block gets a fresh one of its own if anything
+// jumps back to it. Phis go at the iterated dominance frontier of each
+// variable's definitions, but only where the variable is live. Every scalar
+// definition then writes a fresh version variable whose `origin` is the
+// source variable. Reads that no definition reaches keep the source variable,
+// which stands for its value on entry: a parameter, or whatever an
+// uninitialized local holds.
+void constructSSA(IRFunction& function);
+
+// Take `function` back out of SSA form into code the emitters accept.
+// Versions of one source variable that never interfere share a variable again
+// (the source variable itself where possible). Each phi that is left becomes
+// copies on its incoming edges: one parallel copy per edge, sequentialized
+// with a temporary where it forms a cycle. Critical edges are split to hold
+// the copies. Versions left unused are dropped from the symbol table, and
+// labels that no jump refers to are removed.
+void destructSSA(IRFunction& function);
+
+} // namespace ircpp
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "ir.hpp"
+#include "mips_instructions.hpp"
+
+namespace ircpp {
+
+// A running element address: &array[index] for an induction variable
+// `index` of loop `loop`, kept in one of $s0..$s7.
+struct PointerIV {
+    const IRVariableOperand* array = nullptr;
+    const IRVariableOperand* index = nullptr;
+    uint32_t loop = 0;                 // in LoopInfo::loops
+    int32_t stride = 0;                // bytes added after each update of index
+    std::shared_ptr<Register> reg;     // $s<k> for pointers[k]
+};
+
+// Induction-variable strength reduction of array addressing, for the
+// emitters. Inside loop L, array[i] with i an induction variable of L is
+// addressed as 0(p), where p is set to base + 4 * i on every edge entering L
+// (at the end of the block it leaves, or after that block's branch when only
+// the fall-through edge enters L) and advanced right after i's update, the
+// only write of i in L.
+// Everywhere in L, p then equals the address the access would compute.
+// Emitted functions use these registers without preserving them, so a call
+// in L that may write p (per its clobber summary) is bracketed by a store and
+// reload of p in the frame slot FrameInfo::savedSlot(k).
+struct StrengthReduction {
+    static constexpr uint32_t kNone = UINT32_MAX;
+    static constexpr uint32_t kMaxPointers = 8; // $s0..$s7
+
+    std::vector<PointerIV> pointers;
+    std::vector<uint32_t> access;                // per instruction: pointer addressing its array load/store, kNone if none
+    std::vector<std::vector<uint32_t>> advance;  // per instruction: pointers to advance right after it
+    std::vector<std::vector<uint32_t>> init;     // per block: pointers to set before leaving it
+    std::vector<std::vector<uint32_t>> fallInit; // per block: pointers to set after its branch, entering by falling through
+    std::vector<std::vector<uint32_t>> active;   // per block: pointers in use throughout it
+
+    // Inner loops and pointers with more accesses get registers first.
+    static StrengthReduction plan(const IRFunction& function, const ControlFlowGraph& cfg);
+};
+
+} // namespace ircpp
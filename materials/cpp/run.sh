@@ -1,21 +1,23 @@
 #!/usr/bin/env bash
 set -euo pipefail
 
-# Usage: run.sh <input.ir> <output.s> [--naive|--greedy]
+# Usage: run.sh <input.ir> <output.s> [--naive|--greedy] [other ir_to_mips flags...]
 
 SCRIPT_DIR="$(cd -- "$(dirname -- "${BASH_SOURCE[0]}")" &>/dev/null && pwd)"
 
-if [[ $# -lt 2 || $# -gt 3 ]]; then
-  echo "Usage: $0 <input.ir> <output.s> [--naive|--greedy]" >&2
+if [[ $# -lt 2 ]]; then
+  echo "Usage: $0 <input.ir> <output.s> [--naive|--greedy] [flags...]" >&2
   exit 1
 fi
 
 IN_IR="$1"
 OUT_S="$2"
-MODE_FLAG="${3:---naive}"
+shift 2
+FLAGS=("$@")
+[[ ${#FLAGS[@]} -eq 0 ]] && FLAGS=(--naive)
 
 echo "Building (make) ..."
 make -C "$SCRIPT_DIR"
 
-"$SCRIPT_DIR/bin/ir_to_mips" "$IN_IR" "$OUT_S" "$MODE_FLAG"
+"$SCRIPT_DIR/bin/ir_to_mips" "$IN_IR" "$OUT_S" "${FLAGS[@]}"
 echo "Wrote: $OUT_S"
@@ -2,16 +2,23 @@
 #include "frame_builder.hpp"
 #include "emit_helpers.hpp"
 #include "instruction_selector.hpp"
+#include "liveness.hpp"
+#include "def_use.hpp"
+#include "strength_reduction.hpp"
 #include <bits/stdc++.h>
 
 namespace ircpp {
 
 // Forward-declare helper lifted from instruction_selector.cpp greedy body
-static void emitGreedyBody(const IRFunction& F, const FrameInfo& fi, std::vector<MIPSInstruction>& out);
+static void emitGreedyBody(const IRFunction& F, const ControlFlowGraph& cfg, const FrameInfo& fi,
+                           const StrengthReduction& sr, const ClobberSummaries* callees,
+                           std::vector<MIPSInstruction>& out);
 
-std::vector<MIPSInstruction> emitFunctionGreedy(const IRFunction& F) {
+std::vector<MIPSInstruction> emitFunctionGreedy(const IRFunction& F, const ControlFlowGraph& cfg,
+                                                const ClobberSummaries* callees) {
     std::vector<MIPSInstruction> out;
-    FrameInfo fi = buildFrame(F);
+    const StrengthReduction sr = StrengthReduction::plan(F, cfg);
+    FrameInfo fi = buildFrame(F, static_cast<uint32_t>(sr.pointers.size()));
 
     // Prologue
     out.emplace_back(MIPSOp::ADDI, F.name, std::vector<std::shared_ptr<MIPSOperand>>{
@@ -30,19 +37,16 @@ std::vector<MIPSInstruction> emitFunctionGreedy(const IRFunction& F) {
     // Store first 4 parameters
     for (size_t i = 0; i < std::min<size_t>(4, F.parameters.size()); ++i) {
         auto p = F.parameters[i]; if (!p) continue;
-        auto it = fi.varOffset.find(p->getName());
-        if (it != fi.varOffset.end()) {
-            static std::shared_ptr<Register> aRegs[4] = { Registers::a0(), Registers::a1(), Registers::a2(), Registers::a3() };
-            out.emplace_back(MIPSOp::SW, "", std::vector<std::shared_ptr<MIPSOperand>>{
-                aRegs[i], std::make_shared<Address>(it->second, Registers::fp())
-            });
-        }
+        static std::shared_ptr<Register> aRegs[4] = { Registers::a0(), Registers::a1(), Registers::a2(), Registers::a3() };
+        out.emplace_back(MIPSOp::SW, "", std::vector<std::shared_ptr<MIPSOperand>>{
+            aRegs[i], std::make_shared<Address>(fi.offsetOf(p), Registers::fp())
+        });
     }
     // Load stack-passed parameters
     if (F.parameters.size() > 4) {
         for (size_t i = 4; i < F.parameters.size(); ++i) {
             auto p = F.parameters[i]; if (!p) continue;
-            int varOff = fi.varOffset[p->getName()];
+            int varOff = fi.offsetOf(p);
             int extraOff = fi.frameBytes + int((i - 4) * 4);
             auto t = Registers::t0();
             out.emplace_back(MIPSOp::LW, "", std::vector<std::shared_ptr<MIPSOperand>>{
@@ -55,7 +59,7 @@ std::vector<MIPSInstruction> emitFunctionGreedy(const IRFunction& F) {
     }
 
     // Body
-    emitGreedyBody(F, fi, out);
+    emitGreedyBody(F, cfg, fi, sr, callees, out);
 
     // Epilogue
     out.emplace_back(MIPSOp::SLL, F.name + std::string("_epilogue"), std::vector<std::shared_ptr<MIPSOperand>>{
@@ -79,289 +83,270 @@ std::vector<MIPSInstruction> emitFunctionGreedy(const IRFunction& F) {
 // implementation via a forward-declared helper lifted from instruction_selector.cpp.
 // In a production refactor, we would fully move that logic here.
 
-static void emitGreedyBody(const IRFunction& F, const FrameInfo& fi, std::vector<MIPSInstruction>& out) {
-    auto isBlockEnd = [](IRInstruction::OpCode op){
-        switch (op) {
-            case IRInstruction::OpCode::GOTO:
-            case IRInstruction::OpCode::BREQ:
-            case IRInstruction::OpCode::BRNEQ:
-            case IRInstruction::OpCode::BRLT:
-            case IRInstruction::OpCode::BRGT:
-            case IRInstruction::OpCode::BRGEQ:
-            case IRInstruction::OpCode::RETURN:
-            case IRInstruction::OpCode::CALL:
-            case IRInstruction::OpCode::CALLR:
-                return true;
-            default: return false;
-        }
-    };
+static void emitGreedyBody(const IRFunction& F, const ControlFlowGraph& cfg, const FrameInfo& fi,
+                           const StrengthReduction& sr, const ClobberSummaries* callees,
+                           std::vector<MIPSInstruction>& out) {
+    const auto labelNames = qualLabels(F);
+    // Per function, so a function's code never depends on what was emitted before it.
+    int arrSetCounter = 0;
 
     // Helper loads/stores
-    auto loadOp = [&](std::shared_ptr<IROperand> op, std::shared_ptr<Register> dst,
+    auto loadOp = [&](const IROperand* op, std::shared_ptr<Register> dst,
                       std::vector<MIPSInstruction>& code){
-        if (auto c = std::dynamic_pointer_cast<IRConstantOperand>(op)) {
-            int val = std::stoi(c->getValueString());
+        if (auto c = op->asConstant()) {
+            int val = c->immediate();
             code.emplace_back(MIPSOp::LI, "", std::vector<std::shared_ptr<MIPSOperand>>{
                 dst, std::make_shared<Immediate>(val)
             });
-        } else if (auto v = std::dynamic_pointer_cast<IRVariableOperand>(op)) {
-            int off = fi.varOffset.at(v->getName());
+        } else if (auto v = op->asVariable()) {
+            int off = fi.offsetOf(v);
             code.emplace_back(MIPSOp::LW, "", std::vector<std::shared_ptr<MIPSOperand>>{
                 dst, std::make_shared<Address>(off, Registers::fp())
             });
         }
     };
-    auto storeVar = [&](const std::string& name, std::shared_ptr<Register> src,
+    auto storeVar = [&](const IRVariableOperand* var, std::shared_ptr<Register> src,
                         std::vector<MIPSInstruction>& code){
-        int off = fi.varOffset.at(name);
+        int off = fi.offsetOf(var);
         code.emplace_back(MIPSOp::SW, "", std::vector<std::shared_ptr<MIPSOperand>>{
             src, std::make_shared<Address>(off, Registers::fp())
         });
     };
-    auto storeVarF32 = [&](const std::string& name, const std::shared_ptr<Register>& fSrc,
+    auto storeVarF32 = [&](const IRVariableOperand* var, const std::shared_ptr<Register>& fSrc,
                            std::vector<MIPSInstruction>& code){
-        int off = fi.varOffset.at(name);
+        int off = fi.offsetOf(var);
         code.emplace_back(MIPSOp::S_S, "", std::vector<std::shared_ptr<MIPSOperand>>{
             fSrc, std::make_shared<Address>(off, Registers::fp())
         });
     };
-    auto loadVarF32 = [&](const std::shared_ptr<IROperand>& op, const std::shared_ptr<Register>& fDst,
+    auto loadVarF32 = [&](const IROperand* op, const std::shared_ptr<Register>& fDst,
                           std::vector<MIPSInstruction>& code){
-        if (auto v = std::dynamic_pointer_cast<IRVariableOperand>(op)) {
-            int off = fi.varOffset.at(v->getName());
+        if (auto v = op->asVariable()) {
+            int off = fi.offsetOf(v);
             code.emplace_back(MIPSOp::L_S, "", std::vector<std::shared_ptr<MIPSOperand>>{
                 fDst, std::make_shared<Address>(off, Registers::fp())
             });
         }
     };
 
-    // Build blocks
+    // Registers the call at instruction i may overwrite. Syscall intrinsics
+    // are emitted inline and leave the allocatable registers alone.
+    auto callClobbers = [&](int i)->uint32_t{
+        const IRInstruction* ir = F.instructions[i];
+        auto fnOp = ir->operands[ir->opCode == IRInstruction::OpCode::CALLR ? 1 : 0]->asFunction();
+        if (!fnOp) return ClobberSummaries::kAll;
+        const std::string_view callee = fnOp->value;
+        if (callee == "geti" || callee == "getc" || callee == "getf" ||
+            callee == "puti" || callee == "putc" || callee == "putf") return 0;
+        return callees ? callees->of(callee) : ClobberSummaries::kAll;
+    };
+
+    // Allocation regions: the reachable CFG blocks. liveAtEnd[r] holds the
+    // variables live just after region r, and liveAfterCall the ones live
+    // just after each call; a dirty value outside those sets is dead once the
+    // region has no further use of it, so its store is dropped. nextCall[i]
+    // is the first call after i in its block that is not an intrinsic.
+    const Liveness live = Liveness::compute(F, cfg);
     std::vector<std::pair<int,int>> blocks;
-    int n = (int)F.instructions.size();
-    int l = 0;
-    for (int i = 0; i < n; ++i) {
-        auto inst = F.instructions[i];
-        if (!inst) continue;
-        if (inst->opCode == IRInstruction::OpCode::LABEL) {
-            if (i > l) blocks.push_back({l, i-1});
-            l = i;
-        }
-        if (isBlockEnd(inst->opCode)) {
-            blocks.push_back({l, i});
-            l = i + 1;
+    std::vector<VarSet> liveAtEnd;
+    std::unordered_map<int, VarSet> liveAfterCall;
+    std::vector<int> nextCall(F.instructions.size(), -1);
+    for (uint32_t b = 0; b < cfg.size(); ++b) {
+        if (!cfg.reachable(b)) continue;
+        const int first = (int)cfg.blocks[b].first, last = (int)cfg.blocks[b].last;
+        blocks.push_back({first, last});
+        liveAtEnd.push_back(live.liveOut[b]);
+        VarSet cur = live.liveOut[b];
+        int next = -1;
+        for (int i = last; i >= first; --i) {
+            auto inst = F.instructions[i];
+            nextCall[i] = next;
+            if (!inst) continue;
+            if (inst->opCode == IRInstruction::OpCode::CALL || inst->opCode == IRInstruction::OpCode::CALLR) {
+                liveAfterCall[i] = cur;
+                if (callClobbers(i)) next = i;
+            }
+            Liveness::transfer(*inst, cur);
         }
     }
-    if (l < n) blocks.push_back({l, n-1});
 
     // Allocatable pool (keep t0..t4 as temps)
     std::vector<std::shared_ptr<Register>> allocRegs = {
         Registers::t5(), Registers::t6(), Registers::t7(), Registers::t8(), Registers::t9()
     };
 
-    auto isScalarVar = [&](const std::shared_ptr<IROperand>& op)->bool{
-        auto v = std::dynamic_pointer_cast<IRVariableOperand>(op);
+    auto isScalarVar = [&](const IROperand* op)->bool{
+        auto v = op->asVariable();
         if (!v) return false;
-        if (std::dynamic_pointer_cast<IRArrayType>(v->type)) return false;
-        return fi.varOffset.count(v->getName()) > 0;
+        if (v->isArray()) return false;
+        return true;
     };
 
-    for (const auto& br : blocks) {
-        int bi = br.first, bj = br.second;
+    // Per-function tables indexed by variable id. Each block starts with an
+    // empty mapping; varToSlot is reset through the slots, so it is never
+    // cleared in full. Next-use queries go to the def-use index.
+    const size_t nvars = F.variables.size();
+    const int NOSLOT = -1;
+    std::vector<int> varToSlot(nvars, NOSLOT);
+    const DefUseIndex du = DefUseIndex::build(F);
+    const int INF = 1000000000;
+
+    for (size_t region = 0; region < blocks.size(); ++region) {
+        int bi = blocks[region].first, bj = blocks[region].second;
         if (bi > bj) continue;
+        const VarSet& liveOut = liveAtEnd[region];
 
         if (F.instructions[bi]->opCode == IRInstruction::OpCode::LABEL) {
-            auto lbl = std::dynamic_pointer_cast<IRLabelOperand>(F.instructions[bi]->operands[0]);
-            std::string Lb = qualLabel(F.name, lbl->getName());
+            auto lbl = F.instructions[bi]->operands[0]->asLabel();
+            std::string Lb = labelNames[lbl->id];
             out.emplace_back(MIPSOp::SLL, Lb, std::vector<std::shared_ptr<MIPSOperand>>{ Registers::zero(), Registers::zero(), std::make_shared<Immediate>(0) });
         }
 
-        // Build per-position next-use information (after position i)
-        const int INF = 1000000000;
-        std::vector<std::unordered_map<std::string,int>> nextUseAt(bj - bi + 1);
-        std::unordered_map<std::string,int> currNext;
-        auto addUse = [&](const std::shared_ptr<IROperand>& op, int pos){
-            if (!isScalarVar(op)) return;
-                    auto v = std::dynamic_pointer_cast<IRVariableOperand>(op);
-            currNext[v->getName()] = pos;
-        };
-        auto getDefName = [&](const std::shared_ptr<IRInstruction>& ir)->std::string{
-            switch (ir->opCode) {
-                case IRInstruction::OpCode::ASSIGN: {
-                    auto dst = std::dynamic_pointer_cast<IRVariableOperand>(ir->operands[0]);
-                    if (dst && !std::dynamic_pointer_cast<IRArrayType>(dst->type)) return dst->getName();
-                    return std::string();
-                }
-                case IRInstruction::OpCode::ADD:
-                case IRInstruction::OpCode::SUB:
-                case IRInstruction::OpCode::MULT:
-                case IRInstruction::OpCode::DIV:
-                case IRInstruction::OpCode::AND:
-                case IRInstruction::OpCode::OR: {
-                    auto dst = std::dynamic_pointer_cast<IRVariableOperand>(ir->operands[0]);
-                    if (dst && !std::dynamic_pointer_cast<IRArrayType>(dst->type)) return dst->getName();
-                    return std::string();
-                }
-                case IRInstruction::OpCode::ARRAY_LOAD: {
-                    auto dst = std::dynamic_pointer_cast<IRVariableOperand>(ir->operands[0]);
-                    if (dst && !std::dynamic_pointer_cast<IRArrayType>(dst->type)) return dst->getName();
-                    return std::string();
-                }
-                case IRInstruction::OpCode::CALLR: {
-                    auto dst = std::dynamic_pointer_cast<IRVariableOperand>(ir->operands[0]);
-                    if (dst && !std::dynamic_pointer_cast<IRArrayType>(dst->type)) return dst->getName();
-                    return std::string();
-                }
-                default: return std::string();
-            }
+        // Next read of `id` after position i within this region, INF if the
+        // value is overwritten first or never read again here.
+        auto nextUse = [&](uint32_t id, int i)->int{
+            uint32_t p = du.nextUse(id, (uint32_t)i, (uint32_t)bj);
+            return p == DefUseIndex::kNone ? INF : (int)p;
         };
 
-        for (int i = bj; i >= bi; --i) {
-            auto ir = F.instructions[i]; if (!ir) { if (i - bi >= 0) nextUseAt[i - bi] = currNext; continue; }
-            // snapshot of next use AFTER position i
-            nextUseAt[i - bi] = currNext;
-            // defs kill previous next-use
-            auto def = getDefName(ir);
-            if (!def.empty()) currNext[def] = INF;
-            // uses at i
-            switch (ir->opCode) {
-                case IRInstruction::OpCode::ASSIGN: {
-                    if (ir->operands.size() >= 2) addUse(ir->operands[1], i);
-                    if (ir->operands.size() == 3) addUse(ir->operands[2], i); // array bulk init count/value
-                    break;
-                }
-                case IRInstruction::OpCode::ADD:
-                case IRInstruction::OpCode::SUB:
-                case IRInstruction::OpCode::MULT:
-                case IRInstruction::OpCode::DIV:
-                case IRInstruction::OpCode::AND:
-                case IRInstruction::OpCode::OR: {
-                    addUse(ir->operands[1], i);
-                    addUse(ir->operands[2], i);
-                    break;
-                }
-                case IRInstruction::OpCode::ARRAY_STORE: {
-                    addUse(ir->operands[0], i);
-                    addUse(ir->operands[2], i);
-                    break;
-                }
-                case IRInstruction::OpCode::ARRAY_LOAD: {
-                    addUse(ir->operands[2], i);
-                    break;
-                }
-                case IRInstruction::OpCode::BREQ:
-                case IRInstruction::OpCode::BRNEQ:
-                case IRInstruction::OpCode::BRLT:
-                case IRInstruction::OpCode::BRGT:
-                case IRInstruction::OpCode::BRGEQ: {
-                    addUse(ir->operands[1], i);
-                    addUse(ir->operands[2], i);
-                    break;
-                }
-                case IRInstruction::OpCode::RETURN: {
-                    addUse(ir->operands[0], i);
-                    break;
-                }
-                case IRInstruction::OpCode::CALL:
-                case IRInstruction::OpCode::CALLR: {
-                    size_t idx = (ir->opCode == IRInstruction::OpCode::CALLR) ? 2 : 1;
-                    for (size_t a = idx; a < ir->operands.size(); ++a) addUse(ir->operands[a], i);
-                    break;
-                }
-                default: break;
-            }
-        }
-
         // Dynamic register mapping for this block
-        struct Slot { std::shared_ptr<Register> reg; std::string var; bool occupied = false; bool dirty = false; };
+        struct Slot { std::shared_ptr<Register> reg; uint32_t var = 0; bool occupied = false; bool dirty = false; };
         std::vector<Slot> slots(allocRegs.size());
         for (size_t s = 0; s < allocRegs.size(); ++s) slots[s].reg = allocRegs[s];
-        std::unordered_map<std::string,int> varToSlot;
 
-        auto spillSlot = [&](int si, std::vector<MIPSInstruction>& code){
+        // Operands of one instruction are read one at a time (call arguments,
+        // branch and array operands), so a value read by instruction i may
+        // still have a reader at i even when nextUse says it is dead.
+        auto usedAt = [&](uint32_t id, int i)->bool{
+            bool used = false;
+            F.instructions[i]->forEachScalarUse([&](const IRVariableOperand* u){ used |= u->id == id; });
+            return used;
+        };
+        auto neededAfterSpill = [&](uint32_t id, int i)->bool{
+            return nextUse(id, i) != INF || liveOut.test(id) || usedAt(id, i);
+        };
+
+        auto spillSlot = [&](int si, int i, std::vector<MIPSInstruction>& code){
             if (!slots[si].occupied) return;
-            if (slots[si].dirty) {
-                int off = fi.varOffset.at(slots[si].var);
+            if (slots[si].dirty && neededAfterSpill(slots[si].var, i)) {
+                int off = fi.varOffset[slots[si].var];
                 code.emplace_back(MIPSOp::SW, "", std::vector<std::shared_ptr<MIPSOperand>>{ slots[si].reg, std::make_shared<Address>(off, Registers::fp()) });
             }
-            varToSlot.erase(slots[si].var);
+            varToSlot[slots[si].var] = NOSLOT;
             slots[si].occupied = false;
             slots[si].dirty = false;
-            slots[si].var.clear();
         };
 
         auto flushAllDirty = [&](std::vector<MIPSInstruction>& code){
             for (size_t si = 0; si < slots.size(); ++si) {
-                if (slots[si].occupied && slots[si].dirty) {
-                    int off = fi.varOffset.at(slots[si].var);
+                if (slots[si].occupied && slots[si].dirty && liveOut.test(slots[si].var)) {
+                    int off = fi.varOffset[slots[si].var];
                     code.emplace_back(MIPSOp::SW, "", std::vector<std::shared_ptr<MIPSOperand>>{ slots[si].reg, std::make_shared<Address>(off, Registers::fp()) });
                     slots[si].dirty = false;
                 }
             }
         };
 
+        // Before a call: save what the callee may overwrite and is still
+        // needed, and forget those registers.
+        auto spillClobbered = [&](uint32_t clobbered, int i, std::vector<MIPSInstruction>& code){
+            const VarSet& after = liveAfterCall.at(i);
+            for (size_t si = 0; si < slots.size(); ++si) {
+                if (!slots[si].occupied || !(clobbered >> gprNumber(slots[si].reg->name) & 1)) continue;
+                if (slots[si].dirty && after.test(slots[si].var)) {
+                    int off = fi.varOffset[slots[si].var];
+                    code.emplace_back(MIPSOp::SW, "", std::vector<std::shared_ptr<MIPSOperand>>{ slots[si].reg, std::make_shared<Address>(off, Registers::fp()) });
+                }
+                varToSlot[slots[si].var] = NOSLOT;
+                slots[si].occupied = false; slots[si].dirty = false;
+            }
+        };
+
         auto clearAllMappings = [&](){
-            varToSlot.clear();
-            for (auto& sl : slots) { sl.occupied = false; sl.dirty = false; sl.var.clear(); }
+            for (auto& sl : slots) {
+                if (sl.occupied) varToSlot[sl.var] = NOSLOT;
+                sl.occupied = false; sl.dirty = false;
+            }
         };
 
-        auto chooseVictim = [&](int i)->int{
-            for (int s = 0; s < (int)slots.size(); ++s) if (!slots[s].occupied) return s;
+        // A free register is taken first, preferring one the next call
+        // spares when `id` lives across that call.
+        auto chooseVictim = [&](int i, uint32_t id)->int{
+            const int c = nextCall[i];
+            const uint32_t avoid = c >= 0 && liveAfterCall.at(c).test(id) ? callClobbers(c) : 0;
+            int freeSlot = -1;
+            for (int s = 0; s < (int)slots.size(); ++s) {
+                if (slots[s].occupied) continue;
+                if (!(avoid >> gprNumber(slots[s].reg->name) & 1)) return s;
+                if (freeSlot < 0) freeSlot = s;
+            }
+            if (freeSlot >= 0) return freeSlot;
+            // Registers holding an operand of instruction i are taken last:
+            // evicting one would clobber a value the instruction still reads.
             int best = 0; int bestNu = -1;
-            auto& map = nextUseAt[i - bi];
             for (int s = 0; s < (int)slots.size(); ++s) {
-                int nu = INF;
-                auto it = map.find(slots[s].var);
-                if (it != map.end()) nu = it->second;
+                int nu = usedAt(slots[s].var, i) ? i : nextUse(slots[s].var, i);
                 if (nu > bestNu) { bestNu = nu; best = s; }
             }
             return best;
         };
 
-        auto ensureVarRegForRead = [&](const std::string& name, int i, std::vector<MIPSInstruction>& code)->std::shared_ptr<Register>{
-            auto it = varToSlot.find(name);
-            if (it != varToSlot.end()) return slots[it->second].reg;
-            int si = chooseVictim(i);
-            if (slots[si].occupied) spillSlot(si, code);
-            int off = fi.varOffset.at(name);
+        auto ensureVarRegForRead = [&](const IRVariableOperand* v, int i, std::vector<MIPSInstruction>& code)->std::shared_ptr<Register>{
+            if (varToSlot[v->id] != NOSLOT) return slots[varToSlot[v->id]].reg;
+            int si = chooseVictim(i, v->id);
+            if (slots[si].occupied) spillSlot(si, i, code);
+            int off = fi.offsetOf(v);
             code.emplace_back(MIPSOp::LW, "", std::vector<std::shared_ptr<MIPSOperand>>{ slots[si].reg, std::make_shared<Address>(off, Registers::fp()) });
-            slots[si].occupied = true; slots[si].dirty = false; slots[si].var = name;
-            varToSlot[name] = si;
+            slots[si].occupied = true; slots[si].dirty = false; slots[si].var = v->id;
+            varToSlot[v->id] = si;
             return slots[si].reg;
         };
 
-        auto ensureVarRegForWrite = [&](const std::string& name, int i, std::vector<MIPSInstruction>& code)->std::shared_ptr<Register>{
-            auto it = varToSlot.find(name);
-            if (it != varToSlot.end()) return slots[it->second].reg;
-            int si = chooseVictim(i);
-            if (slots[si].occupied) spillSlot(si, code);
-            slots[si].occupied = true; slots[si].dirty = false; slots[si].var = name;
-            varToSlot[name] = si;
+        auto ensureVarRegForWrite = [&](const IRVariableOperand* v, int i, std::vector<MIPSInstruction>& code)->std::shared_ptr<Register>{
+            if (varToSlot[v->id] != NOSLOT) return slots[varToSlot[v->id]].reg;
+            int si = chooseVictim(i, v->id);
+            if (slots[si].occupied) spillSlot(si, i, code);
+            slots[si].occupied = true; slots[si].dirty = false; slots[si].var = v->id;
+            varToSlot[v->id] = si;
             return slots[si].reg;
         };
 
-        auto freeIfLastUse = [&](const std::string& name, int i, std::vector<MIPSInstruction>& code){
-            auto itMap = nextUseAt[i - bi].find(name);
-            int nu = (itMap == nextUseAt[i - bi].end()) ? INF : itMap->second;
-            if (nu == INF) {
-                auto it = varToSlot.find(name);
-                if (it != varToSlot.end()) {
-                    int si = it->second;
-                    if (slots[si].dirty) {
-                        int off = fi.varOffset.at(name);
-                        code.emplace_back(MIPSOp::SW, "", std::vector<std::shared_ptr<MIPSOperand>>{ slots[si].reg, std::make_shared<Address>(off, Registers::fp()) });
-                    }
-                    varToSlot.erase(name);
-                    slots[si].occupied = false; slots[si].dirty = false; slots[si].var.clear();
+        // Drop v's register without writing it back, for when v is about to be
+        // overwritten in memory; a stale dirty copy would otherwise be flushed
+        // over the new value at region end.
+        auto forgetVar = [&](const IRVariableOperand* v){
+            int si = varToSlot[v->id];
+            if (si == NOSLOT) return;
+            varToSlot[v->id] = NOSLOT;
+            slots[si].occupied = false; slots[si].dirty = false;
+        };
+
+        auto markDirty = [&](const IRVariableOperand* v){
+            if (varToSlot[v->id] != NOSLOT) slots[varToSlot[v->id]].dirty = true;
+        };
+
+        auto freeIfLastUse = [&](const IRVariableOperand* v, int i, std::vector<MIPSInstruction>& code){
+            if (nextUse(v->id, i) != INF) return;
+            int si = varToSlot[v->id];
+            if (si == NOSLOT) return;
+            if (slots[si].dirty) {
+                if (liveOut.test(v->id)) {
+                    int off = fi.offsetOf(v);
+                    code.emplace_back(MIPSOp::SW, "", std::vector<std::shared_ptr<MIPSOperand>>{ slots[si].reg, std::make_shared<Address>(off, Registers::fp()) });
+                } else if (usedAt(v->id, i)) {
+                    return; // dead afterwards, but a later operand of i may read it; keep the register
                 }
             }
+            varToSlot[v->id] = NOSLOT;
+            slots[si].occupied = false; slots[si].dirty = false;
         };
 
-        auto getOpIntoTemp = [&](const std::shared_ptr<IROperand>& op, const std::shared_ptr<Register>& tmp, int i, std::vector<MIPSInstruction>& code){
-            if (auto v = std::dynamic_pointer_cast<IRVariableOperand>(op)) {
-                if (!std::dynamic_pointer_cast<IRArrayType>(v->type)) {
-                    auto r = ensureVarRegForRead(v->getName(), i, code);
+        auto getOpIntoTemp = [&](const IROperand* op, const std::shared_ptr<Register>& tmp, int i, std::vector<MIPSInstruction>& code){
+            if (auto v = op->asVariable()) {
+                if (!v->isArray()) {
+                    auto r = ensureVarRegForRead(v, i, code);
                     if (r->toString() != tmp->toString()) code.emplace_back(MIPSOp::MOVE, "", std::vector<std::shared_ptr<MIPSOperand>>{ tmp, r });
-                    freeIfLastUse(v->getName(), i, code);
+                    freeIfLastUse(v, i, code);
                     return; // value now in tmp
                 }
             }
@@ -369,14 +354,27 @@ static void emitGreedyBody(const IRFunction& F, const FrameInfo& fi, std::vector
             loadOp(op, tmp, code);
         };
 
+        // Pointers into a loop this block enters, set once the block's
+        // values are flushed. $t0 and $t1 may hold a closing branch's operands.
+        const uint32_t block = cfg.blockOf((uint32_t)bi);
+        auto setPointers = [&](const std::vector<uint32_t>& ks, std::vector<MIPSInstruction>& code){
+            for (uint32_t k : ks) {
+                const IRVariableOperand* index = sr.pointers[k].index;
+                std::shared_ptr<Register> rIdx = Registers::t2();
+                if (varToSlot[index->id] != NOSLOT) rIdx = slots[varToSlot[index->id]].reg;
+                else loadOp(index, rIdx, code);
+                emitComputeArrayAddr(fi, sr.pointers[k].array, rIdx, sr.pointers[k].reg, Registers::t3(), code);
+            }
+        };
+
         for (int i = bi; i <= bj; ++i) {
             auto ir = F.instructions[i]; if (!ir) continue;
             if (ir->opCode == IRInstruction::OpCode::LABEL && i == bi) continue;
             std::vector<MIPSInstruction> code;
             switch (ir->opCode) {
                 case IRInstruction::OpCode::ASSIGN: {
-                    auto dst = std::dynamic_pointer_cast<IRVariableOperand>(ir->operands[0]);
-                    if (ir->operands.size() == 3 && dst && std::dynamic_pointer_cast<IRArrayType>(dst->type)) {
+                    auto dst = ir->operands[0]->asVariable();
+                    if (ir->operands.size() == 3 && dst && dst->isArray()) {
                         auto tCnt  = Registers::t0();
                         auto tVal  = Registers::t1();
                         auto tIdx  = Registers::t2();
@@ -385,13 +383,12 @@ static void emitGreedyBody(const IRFunction& F, const FrameInfo& fi, std::vector
                         getOpIntoTemp(ir->operands[1], tCnt, i, code);
                         getOpIntoTemp(ir->operands[2], tVal, i, code);
                         code.emplace_back(MIPSOp::LI, "", std::vector<std::shared_ptr<MIPSOperand>>{ tIdx, std::make_shared<Immediate>(0) });
-                        int baseOff = fi.varOffset.at(dst->getName());
-                        if (fi.paramArrayNames.count(dst->getName())) {
+                        int baseOff = fi.offsetOf(dst);
+                        if (fi.passedByPointer(dst)) {
                             code.emplace_back(MIPSOp::LW, "", std::vector<std::shared_ptr<MIPSOperand>>{ baseR, std::make_shared<Address>(baseOff, Registers::fp()) });
                         } else {
                             code.emplace_back(MIPSOp::ADDI, "", std::vector<std::shared_ptr<MIPSOperand>>{ baseR, Registers::fp(), std::make_shared<Immediate>(baseOff) });
                         }
-                        static int arrSetCounter = 0;
                         std::string Lloop = F.name + std::string("_arrset_") + std::to_string(arrSetCounter++);
                         std::string Lend  = F.name + std::string("_arrset_end_") + std::to_string(arrSetCounter++);
                         code.emplace_back(MIPSOp::SLL, Lloop, std::vector<std::shared_ptr<MIPSOperand>>{ Registers::zero(), Registers::zero(), std::make_shared<Immediate>(0) });
@@ -404,25 +401,24 @@ static void emitGreedyBody(const IRFunction& F, const FrameInfo& fi, std::vector
                         code.emplace_back(MIPSOp::SLL, Lend, std::vector<std::shared_ptr<MIPSOperand>>{ Registers::zero(), Registers::zero(), std::make_shared<Immediate>(0) });
                     } else {
                         if (!dst) break;
-                        auto dstR = ensureVarRegForWrite(dst->getName(), i, code);
-                            if (auto c = std::dynamic_pointer_cast<IRConstantOperand>(ir->operands[1])) {
-                                int val = std::stoi(c->getValueString());
-                                code.emplace_back(MIPSOp::LI, "", std::vector<std::shared_ptr<MIPSOperand>>{ dstR, std::make_shared<Immediate>(val) });
-                            } else if (auto v = std::dynamic_pointer_cast<IRVariableOperand>(ir->operands[1])) {
-                            if (!std::dynamic_pointer_cast<IRArrayType>(v->type)) {
-                                auto srcR = ensureVarRegForRead(v->getName(), i, code);
-                                if (srcR->toString() != dstR->toString()) code.emplace_back(MIPSOp::MOVE, "", std::vector<std::shared_ptr<MIPSOperand>>{ dstR, srcR });
-                                freeIfLastUse(v->getName(), i, code);
-                            } else {
-                                    auto t0 = Registers::t0(); loadOp(ir->operands[1], t0, code);
-                                    code.emplace_back(MIPSOp::MOVE, "", std::vector<std::shared_ptr<MIPSOperand>>{ dstR, t0 });
-                                }
-                            }
-                        // mark dst dirty
-                        {
-                            auto itSlot = varToSlot.find(dst->getName());
-                            if (itSlot != varToSlot.end()) slots[itSlot->second].dirty = true;
+                        // Read the source before allocating dst, so the load
+                        // can never evict dst's freshly allocated register.
+                        const IRVariableOperand* srcVar = ir->operands[1]->asVariable();
+                        std::shared_ptr<Register> srcR;
+                        if (srcVar && !srcVar->isArray()) srcR = ensureVarRegForRead(srcVar, i, code);
+                        auto dstR = ensureVarRegForWrite(dst, i, code);
+                        if (auto c = ir->operands[1]->asConstant()) {
+                            int val = c->immediate();
+                            code.emplace_back(MIPSOp::LI, "", std::vector<std::shared_ptr<MIPSOperand>>{ dstR, std::make_shared<Immediate>(val) });
+                        } else if (srcR) {
+                            if (srcR->toString() != dstR->toString()) code.emplace_back(MIPSOp::MOVE, "", std::vector<std::shared_ptr<MIPSOperand>>{ dstR, srcR });
+                            freeIfLastUse(srcVar, i, code);
+                        } else if (srcVar) {
+                            auto t0 = Registers::t0(); loadOp(ir->operands[1], t0, code);
+                            code.emplace_back(MIPSOp::MOVE, "", std::vector<std::shared_ptr<MIPSOperand>>{ dstR, t0 });
                         }
+                        // mark dst dirty
+                        markDirty(dst);
                     }
                     break;
                 }
@@ -432,20 +428,20 @@ static void emitGreedyBody(const IRFunction& F, const FrameInfo& fi, std::vector
                 case IRInstruction::OpCode::DIV:
                 case IRInstruction::OpCode::AND:
                 case IRInstruction::OpCode::OR: {
-                    auto dst = std::dynamic_pointer_cast<IRVariableOperand>(ir->operands[0]);
+                    auto dst = ir->operands[0]->asVariable();
                     auto rYt = Registers::t0();
                     auto rZt = Registers::t1();
                     std::shared_ptr<Register> rY;
                     std::shared_ptr<Register> rZ;
                     if (isScalarVar(ir->operands[1])) {
-                        auto vy = std::dynamic_pointer_cast<IRVariableOperand>(ir->operands[1]);
-                        rY = ensureVarRegForRead(vy->getName(), i, code);
+                        auto vy = ir->operands[1]->asVariable();
+                        rY = ensureVarRegForRead(vy, i, code);
                     } else { rY = rYt; getOpIntoTemp(ir->operands[1], rYt, i, code); }
                     if (isScalarVar(ir->operands[2])) {
-                        auto vz = std::dynamic_pointer_cast<IRVariableOperand>(ir->operands[2]);
-                        rZ = ensureVarRegForRead(vz->getName(), i, code);
+                        auto vz = ir->operands[2]->asVariable();
+                        rZ = ensureVarRegForRead(vz, i, code);
                     } else { rZ = rZt; getOpIntoTemp(ir->operands[2], rZt, i, code); }
-                    auto rX = ensureVarRegForWrite(dst->getName(), i, code);
+                    auto rX = ensureVarRegForWrite(dst, i, code);
                     MIPSOp op = MIPSOp::ADD;
                     if (ir->opCode == IRInstruction::OpCode::SUB) op = MIPSOp::SUB;
                     else if (ir->opCode == IRInstruction::OpCode::MULT) op = MIPSOp::MUL;
@@ -453,18 +449,21 @@ static void emitGreedyBody(const IRFunction& F, const FrameInfo& fi, std::vector
                     else if (ir->opCode == IRInstruction::OpCode::AND) op = MIPSOp::AND;
                     else if (ir->opCode == IRInstruction::OpCode::OR)  op = MIPSOp::OR;
                     code.emplace_back(op, "", std::vector<std::shared_ptr<MIPSOperand>>{ rX, rY, rZ });
-                    {
-                        auto itSlot = varToSlot.find(dst->getName());
-                        if (itSlot != varToSlot.end()) slots[itSlot->second].dirty = true;
+                    markDirty(dst);
+                    for (uint32_t k : sr.advance[i]) {
+                        code.emplace_back(MIPSOp::ADDI, "", std::vector<std::shared_ptr<MIPSOperand>>{
+                            sr.pointers[k].reg, sr.pointers[k].reg, std::make_shared<Immediate>(sr.pointers[k].stride)
+                        });
                     }
-                    if (isScalarVar(ir->operands[1])) freeIfLastUse(std::dynamic_pointer_cast<IRVariableOperand>(ir->operands[1])->getName(), i, code);
-                    if (isScalarVar(ir->operands[2])) freeIfLastUse(std::dynamic_pointer_cast<IRVariableOperand>(ir->operands[2])->getName(), i, code);
+                    if (isScalarVar(ir->operands[1])) freeIfLastUse(static_cast<const IRVariableOperand*>(ir->operands[1]), i, code);
+                    if (isScalarVar(ir->operands[2])) freeIfLastUse(static_cast<const IRVariableOperand*>(ir->operands[2]), i, code);
                     break;
                 }
                 case IRInstruction::OpCode::GOTO: {
-                    auto lbl = std::dynamic_pointer_cast<IRLabelOperand>(ir->operands[0]);
+                    auto lbl = ir->operands[0]->asLabel();
                     flushAllDirty(code);
-                    code.emplace_back(MIPSOp::J, "", std::vector<std::shared_ptr<MIPSOperand>>{ std::make_shared<Label>(qualLabel(F.name, lbl->getName())) });
+                    setPointers(sr.init[block], code);
+                    code.emplace_back(MIPSOp::J, "", std::vector<std::shared_ptr<MIPSOperand>>{ std::make_shared<Label>(labelNames[lbl->id]) });
                     clearAllMappings();
                     break;
                 }
@@ -473,7 +472,7 @@ static void emitGreedyBody(const IRFunction& F, const FrameInfo& fi, std::vector
                 case IRInstruction::OpCode::BRLT:
                 case IRInstruction::OpCode::BRGT:
                 case IRInstruction::OpCode::BRGEQ: {
-                    auto lbl = std::dynamic_pointer_cast<IRLabelOperand>(ir->operands[0]);
+                    auto lbl = ir->operands[0]->asLabel();
                     auto rA = Registers::t0(); auto rB = Registers::t1();
                     getOpIntoTemp(ir->operands[1], rA, i, code);
                     getOpIntoTemp(ir->operands[2], rB, i, code);
@@ -483,20 +482,23 @@ static void emitGreedyBody(const IRFunction& F, const FrameInfo& fi, std::vector
                     else if (ir->opCode == IRInstruction::OpCode::BRGT) bop = MIPSOp::BGT;
                     else if (ir->opCode == IRInstruction::OpCode::BRGEQ) bop = MIPSOp::BGE;
                     flushAllDirty(code);
-                    code.emplace_back(bop, "", std::vector<std::shared_ptr<MIPSOperand>>{ rA, rB, std::make_shared<Label>(qualLabel(F.name, lbl->getName())) });
+                    setPointers(sr.init[block], code);
+                    code.emplace_back(bop, "", std::vector<std::shared_ptr<MIPSOperand>>{ rA, rB, std::make_shared<Label>(labelNames[lbl->id]) });
+                    setPointers(sr.fallInit[block], code);
                     break;
                 }
                 case IRInstruction::OpCode::CALL:
                 case IRInstruction::OpCode::CALLR: {
                     size_t idxArg = (ir->opCode == IRInstruction::OpCode::CALLR) ? 2 : 1;
-                    auto fnOp = std::dynamic_pointer_cast<IRFunctionOperand>(ir->operands[idxArg-1]);
+                    auto fnOp = ir->operands[idxArg-1]->asFunction();
                     std::string callee = fnOp ? fnOp->getName() : ir->operands[idxArg-1]->toString();
                     if (callee == "geti") {
                         code.emplace_back(MIPSOp::LI, "", std::vector<std::shared_ptr<MIPSOperand>>{ Registers::v0(), std::make_shared<Immediate>(5) });
                         code.emplace_back(MIPSOp::SYSCALL, "", std::vector<std::shared_ptr<MIPSOperand>>{});
                         if (ir->opCode == IRInstruction::OpCode::CALLR) {
-                            auto dst = std::dynamic_pointer_cast<IRVariableOperand>(ir->operands[0]);
-                            storeVar(dst->getName(), Registers::v0(), code);
+                            auto dst = ir->operands[0]->asVariable();
+                            forgetVar(dst);
+                            storeVar(dst, Registers::v0(), code);
                         }
                         break;
                     }
@@ -504,8 +506,9 @@ static void emitGreedyBody(const IRFunction& F, const FrameInfo& fi, std::vector
                         code.emplace_back(MIPSOp::LI, "", std::vector<std::shared_ptr<MIPSOperand>>{ Registers::v0(), std::make_shared<Immediate>(12) });
                         code.emplace_back(MIPSOp::SYSCALL, "", std::vector<std::shared_ptr<MIPSOperand>>{});
                         if (ir->opCode == IRInstruction::OpCode::CALLR) {
-                            auto dst = std::dynamic_pointer_cast<IRVariableOperand>(ir->operands[0]);
-                            storeVar(dst->getName(), Registers::v0(), code);
+                            auto dst = ir->operands[0]->asVariable();
+                            forgetVar(dst);
+                            storeVar(dst, Registers::v0(), code);
                         }
                         break;
                     }
@@ -529,20 +532,20 @@ static void emitGreedyBody(const IRFunction& F, const FrameInfo& fi, std::vector
                         code.emplace_back(MIPSOp::LI, "", std::vector<std::shared_ptr<MIPSOperand>>{ Registers::v0(), std::make_shared<Immediate>(6) });
                         code.emplace_back(MIPSOp::SYSCALL, "", std::vector<std::shared_ptr<MIPSOperand>>{});
                         if (ir->opCode == IRInstruction::OpCode::CALLR) {
-                            auto dst = std::dynamic_pointer_cast<IRVariableOperand>(ir->operands[0]);
+                            auto dst = ir->operands[0]->asVariable();
                             auto f0 = std::make_shared<Register>(Register{"f0", true});
-                            storeVarF32(dst->getName(), f0, code);
+                            forgetVar(dst);
+                            storeVarF32(dst, f0, code);
                         }
                         break;
                     }
                     static std::shared_ptr<Register> aRegs[4] = { Registers::a0(), Registers::a1(), Registers::a2(), Registers::a3() };
-                    flushAllDirty(code);
                     for (size_t a = 0; a < 4 && idxArg + a < ir->operands.size(); ++a) {
                         auto arg = ir->operands[idxArg + a];
-                        if (auto v = std::dynamic_pointer_cast<IRVariableOperand>(arg)) {
-                            if (std::dynamic_pointer_cast<IRArrayType>(v->type)) {
-                                int base = fi.varOffset.at(v->getName());
-                                if (fi.paramArrayNames.count(v->getName())) {
+                        if (auto v = arg->asVariable()) {
+                            if (v->isArray()) {
+                                int base = fi.offsetOf(v);
+                                if (fi.passedByPointer(v)) {
                                     code.emplace_back(MIPSOp::LW, "", std::vector<std::shared_ptr<MIPSOperand>>{ aRegs[a], std::make_shared<Address>(base, Registers::fp()) });
                                 } else {
                                     code.emplace_back(MIPSOp::ADDI, "", std::vector<std::shared_ptr<MIPSOperand>>{ aRegs[a], Registers::fp(), std::make_shared<Immediate>(base) });
@@ -556,7 +559,7 @@ static void emitGreedyBody(const IRFunction& F, const FrameInfo& fi, std::vector
                     }
                     if (idxArg + 4 < ir->operands.size()) {
                         size_t extraStart = idxArg + 4;
-                        std::vector<std::shared_ptr<IROperand>> extras;
+                        std::vector<const IROperand*> extras;
                         for (size_t a = extraStart; a < ir->operands.size(); ++a) extras.push_back(ir->operands[a]);
                         for (size_t r = extras.size(); r-- > 0; ) {
                             auto t = Registers::t0();
@@ -565,15 +568,32 @@ static void emitGreedyBody(const IRFunction& F, const FrameInfo& fi, std::vector
                             code.emplace_back(MIPSOp::SW, "", std::vector<std::shared_ptr<MIPSOperand>>{ t, std::make_shared<Address>(0, Registers::sp()) });
                         }
                     }
+                    // Nothing in this frame outlives a tail call.
+                    if (canJumpToTailCallee(fi, F, i)) {
+                        emitTailJump(fi, callee, code);
+                        break;
+                    }
+                    // Arguments are read by now, so only what survives the
+                    // call is saved.
+                    const uint32_t clobbered = callClobbers(i);
+                    spillClobbered(clobbered, i, code);
+                    std::vector<uint32_t> keep;
+                    for (uint32_t k : sr.active[block])
+                        if (clobbered >> gprNumber(sr.pointers[k].reg->name) & 1) keep.push_back(k);
+                    for (uint32_t k : keep)
+                        code.emplace_back(MIPSOp::SW, "", std::vector<std::shared_ptr<MIPSOperand>>{ sr.pointers[k].reg, std::make_shared<Address>(fi.savedSlot(k), Registers::fp()) });
                     code.emplace_back(MIPSOp::JAL, "", std::vector<std::shared_ptr<MIPSOperand>>{ std::make_shared<Label>(callee) });
+                    for (uint32_t k : keep)
+                        code.emplace_back(MIPSOp::LW, "", std::vector<std::shared_ptr<MIPSOperand>>{ sr.pointers[k].reg, std::make_shared<Address>(fi.savedSlot(k), Registers::fp()) });
                     if (idxArg + 4 < ir->operands.size()) {
                         int extra = int(ir->operands.size() - (idxArg + 4));
                         code.emplace_back(MIPSOp::ADDI, "", std::vector<std::shared_ptr<MIPSOperand>>{ Registers::sp(), Registers::sp(), std::make_shared<Immediate>(extra * 4) });
                     }
-                    clearAllMappings();
                     if (ir->opCode == IRInstruction::OpCode::CALLR) {
-                        auto dst = std::dynamic_pointer_cast<IRVariableOperand>(ir->operands[0]);
-                        storeVar(dst->getName(), Registers::v0(), code);
+                        auto dst = ir->operands[0]->asVariable();
+                        auto rDst = ensureVarRegForWrite(dst, i, code);
+                        code.emplace_back(MIPSOp::MOVE, "", std::vector<std::shared_ptr<MIPSOperand>>{ rDst, Registers::v0() });
+                        markDirty(dst);
                     }
                     break;
                 }
@@ -582,8 +602,8 @@ static void emitGreedyBody(const IRFunction& F, const FrameInfo& fi, std::vector
                     // Fallbacks for array ops and return using mapped regs when possible
                     switch (ir->opCode) {
                         case IRInstruction::OpCode::LABEL: {
-                            auto lbl = std::dynamic_pointer_cast<IRLabelOperand>(ir->operands[0]);
-                            std::string Lb2 = qualLabel(F.name, lbl->getName());
+                            auto lbl = ir->operands[0]->asLabel();
+                            std::string Lb2 = labelNames[lbl->id];
                             code.emplace_back(MIPSOp::SLL, Lb2, std::vector<std::shared_ptr<MIPSOperand>>{ Registers::zero(), Registers::zero(), std::make_shared<Immediate>(0) });
                             break;
                         }
@@ -592,11 +612,15 @@ static void emitGreedyBody(const IRFunction& F, const FrameInfo& fi, std::vector
                             auto tIdx = Registers::t1();
                             auto tAddr = Registers::t2();
                             getOpIntoTemp(ir->operands[0], tVal, i, code);
-                            auto arrVar = std::dynamic_pointer_cast<IRVariableOperand>(ir->operands[1]);
+                            if (sr.access[i] != StrengthReduction::kNone) {
+                                code.emplace_back(MIPSOp::SW, "", std::vector<std::shared_ptr<MIPSOperand>>{ tVal, std::make_shared<Address>(0, sr.pointers[sr.access[i]].reg) });
+                                break;
+                            }
+                            auto arrVar = ir->operands[1]->asVariable();
                             getOpIntoTemp(ir->operands[2], tIdx, i, code);
                             std::shared_ptr<Register> baseReg = Registers::t3();
-                            int baseOff = fi.varOffset.at(arrVar->getName());
-                            if (fi.paramArrayNames.count(arrVar->getName())) {
+                            int baseOff = fi.offsetOf(arrVar);
+                            if (fi.passedByPointer(arrVar)) {
                                 code.emplace_back(MIPSOp::LW, "", std::vector<std::shared_ptr<MIPSOperand>>{ baseReg, std::make_shared<Address>(baseOff, Registers::fp()) });
                             } else {
                                 code.emplace_back(MIPSOp::ADDI, "", std::vector<std::shared_ptr<MIPSOperand>>{ baseReg, Registers::fp(), std::make_shared<Immediate>(baseOff) });
@@ -605,20 +629,26 @@ static void emitGreedyBody(const IRFunction& F, const FrameInfo& fi, std::vector
                             code.emplace_back(MIPSOp::ADD, "", std::vector<std::shared_ptr<MIPSOperand>>{ tAddr, baseReg, tAddr });
                             code.emplace_back(MIPSOp::SW,  "", std::vector<std::shared_ptr<MIPSOperand>>{ tVal, std::make_shared<Address>(0, tAddr) });
                             // free last-use of operands
-                            if (isScalarVar(ir->operands[0])) freeIfLastUse(std::dynamic_pointer_cast<IRVariableOperand>(ir->operands[0])->getName(), i, code);
-                            if (isScalarVar(ir->operands[2])) freeIfLastUse(std::dynamic_pointer_cast<IRVariableOperand>(ir->operands[2])->getName(), i, code);
+                            if (isScalarVar(ir->operands[0])) freeIfLastUse(static_cast<const IRVariableOperand*>(ir->operands[0]), i, code);
+                            if (isScalarVar(ir->operands[2])) freeIfLastUse(static_cast<const IRVariableOperand*>(ir->operands[2]), i, code);
                             break;
                         }
                         case IRInstruction::OpCode::ARRAY_LOAD: {
-                            auto dst = std::dynamic_pointer_cast<IRVariableOperand>(ir->operands[0]);
+                            auto dst = ir->operands[0]->asVariable();
                             auto tIdx = Registers::t0();
                             auto tAddr = Registers::t1();
                             auto tVal = Registers::t2();
-                            auto arrVar = std::dynamic_pointer_cast<IRVariableOperand>(ir->operands[1]);
+                            if (sr.access[i] != StrengthReduction::kNone) {
+                                auto rDst = ensureVarRegForWrite(dst, i, code);
+                                code.emplace_back(MIPSOp::LW, "", std::vector<std::shared_ptr<MIPSOperand>>{ rDst, std::make_shared<Address>(0, sr.pointers[sr.access[i]].reg) });
+                                markDirty(dst);
+                                break;
+                            }
+                            auto arrVar = ir->operands[1]->asVariable();
                             getOpIntoTemp(ir->operands[2], tIdx, i, code);
                             std::shared_ptr<Register> baseReg = Registers::t3();
-                            int baseOff = fi.varOffset.at(arrVar->getName());
-                            if (fi.paramArrayNames.count(arrVar->getName())) {
+                            int baseOff = fi.offsetOf(arrVar);
+                            if (fi.passedByPointer(arrVar)) {
                                 code.emplace_back(MIPSOp::LW, "", std::vector<std::shared_ptr<MIPSOperand>>{ baseReg, std::make_shared<Address>(baseOff, Registers::fp()) });
                             } else {
                                 code.emplace_back(MIPSOp::ADDI, "", std::vector<std::shared_ptr<MIPSOperand>>{ baseReg, Registers::fp(), std::make_shared<Immediate>(baseOff) });
@@ -626,13 +656,10 @@ static void emitGreedyBody(const IRFunction& F, const FrameInfo& fi, std::vector
                             code.emplace_back(MIPSOp::SLL, "", std::vector<std::shared_ptr<MIPSOperand>>{ tAddr, tIdx, std::make_shared<Immediate>(2) });
                             code.emplace_back(MIPSOp::ADD, "", std::vector<std::shared_ptr<MIPSOperand>>{ tAddr, baseReg, tAddr });
                             code.emplace_back(MIPSOp::LW,  "", std::vector<std::shared_ptr<MIPSOperand>>{ tVal, std::make_shared<Address>(0, tAddr) });
-                            auto rDst = ensureVarRegForWrite(dst->getName(), i, code);
+                            auto rDst = ensureVarRegForWrite(dst, i, code);
                             code.emplace_back(MIPSOp::MOVE, "", std::vector<std::shared_ptr<MIPSOperand>>{ rDst, tVal });
-                            {
-                                auto itSlot = varToSlot.find(dst->getName());
-                                if (itSlot != varToSlot.end()) slots[itSlot->second].dirty = true;
-                            }
-                            if (isScalarVar(ir->operands[2])) freeIfLastUse(std::dynamic_pointer_cast<IRVariableOperand>(ir->operands[2])->getName(), i, code);
+                            markDirty(dst);
+                            if (isScalarVar(ir->operands[2])) freeIfLastUse(static_cast<const IRVariableOperand*>(ir->operands[2]), i, code);
                             break;
                         }
                         case IRInstruction::OpCode::RETURN: {
@@ -652,7 +679,11 @@ static void emitGreedyBody(const IRFunction& F, const FrameInfo& fi, std::vector
         // Flush at block end
         std::vector<MIPSInstruction> flush;
         flushAllDirty(flush);
+        const IRInstruction* last = F.instructions[bj];
+        const bool jumped = last && last->isJump();
+        if (!jumped) setPointers(sr.init[block], flush);
         out.insert(out.end(), flush.begin(), flush.end());
+        clearAllMappings();
     }
 }
 
@@ -1,13 +1,18 @@
 #include "alloc_naive.hpp"
 #include "frame_builder.hpp"
 #include "emit_helpers.hpp"
+#include "strength_reduction.hpp"
 #include <bits/stdc++.h>
 
 namespace ircpp {
 
-std::vector<MIPSInstruction> emitFunctionNaive(const IRFunction& F) {
+std::vector<MIPSInstruction> emitFunctionNaive(const IRFunction& F, const ControlFlowGraph& cfg) {
     std::vector<MIPSInstruction> out;
-    FrameInfo fi = buildFrame(F);
+    const StrengthReduction sr = StrengthReduction::plan(F, cfg);
+    FrameInfo fi = buildFrame(F, static_cast<uint32_t>(sr.pointers.size()));
+    const auto labelNames = qualLabels(F);
+    // Per function, so a function's code never depends on what was emitted before it.
+    int arrSetCounter = 0;
 
     // Prologue
     out.emplace_back(MIPSOp::ADDI, F.name, std::vector<std::shared_ptr<MIPSOperand>>{
@@ -26,19 +31,16 @@ std::vector<MIPSInstruction> emitFunctionNaive(const IRFunction& F) {
     // Store first 4 parameters to their slots
     for (size_t i = 0; i < std::min<size_t>(4, F.parameters.size()); ++i) {
         auto p = F.parameters[i]; if (!p) continue;
-        auto it = fi.varOffset.find(p->getName());
-        if (it != fi.varOffset.end()) {
-            static std::shared_ptr<Register> aRegs[4] = { Registers::a0(), Registers::a1(), Registers::a2(), Registers::a3() };
-            out.emplace_back(MIPSOp::SW, "", std::vector<std::shared_ptr<MIPSOperand>>{
-                aRegs[i], std::make_shared<Address>(it->second, Registers::fp())
-            });
-        }
+        static std::shared_ptr<Register> aRegs[4] = { Registers::a0(), Registers::a1(), Registers::a2(), Registers::a3() };
+        out.emplace_back(MIPSOp::SW, "", std::vector<std::shared_ptr<MIPSOperand>>{
+            aRegs[i], std::make_shared<Address>(fi.offsetOf(p), Registers::fp())
+        });
     }
     // Load stack-passed parameters
     if (F.parameters.size() > 4) {
         for (size_t i = 4; i < F.parameters.size(); ++i) {
             auto p = F.parameters[i]; if (!p) continue;
-            int varOff = fi.varOffset[p->getName()];
+            int varOff = fi.offsetOf(p);
             int extraOff = fi.frameBytes + int((i - 4) * 4);
             auto t = Registers::t0();
             out.emplace_back(MIPSOp::LW, "", std::vector<std::shared_ptr<MIPSOperand>>{
@@ -50,45 +52,50 @@ std::vector<MIPSInstruction> emitFunctionNaive(const IRFunction& F) {
         }
     }
 
-    auto loadOp = [&](std::shared_ptr<IROperand> op, std::shared_ptr<Register> dst,
+    auto loadOp = [&](const IROperand* op, std::shared_ptr<Register> dst,
                       std::vector<MIPSInstruction>& code){
-        if (auto c = std::dynamic_pointer_cast<IRConstantOperand>(op)) {
-            int val = std::stoi(c->getValueString());
+        if (auto c = op->asConstant()) {
+            int val = c->immediate();
             code.emplace_back(MIPSOp::LI, "", std::vector<std::shared_ptr<MIPSOperand>>{
                 dst, std::make_shared<Immediate>(val)
             });
-        } else if (auto v = std::dynamic_pointer_cast<IRVariableOperand>(op)) {
-            int off = fi.varOffset[v->getName()];
+        } else if (auto v = op->asVariable()) {
+            int off = fi.offsetOf(v);
             code.emplace_back(MIPSOp::LW, "", std::vector<std::shared_ptr<MIPSOperand>>{
                 dst, std::make_shared<Address>(off, Registers::fp())
             });
         }
     };
 
-    auto storeVar = [&](const std::string& name, std::shared_ptr<Register> src,
+    auto storeVar = [&](const IRVariableOperand* var, std::shared_ptr<Register> src,
                         std::vector<MIPSInstruction>& code){
-        int off = fi.varOffset[name];
+        int off = fi.offsetOf(var);
         code.emplace_back(MIPSOp::SW, "", std::vector<std::shared_ptr<MIPSOperand>>{
             src, std::make_shared<Address>(off, Registers::fp())
         });
     };
 
-    for (const auto& ir : F.instructions) {
-        if (!ir) continue;
+    // The CFG's blocks partition the instruction list; walk both together and
+    // drop instructions in unreachable blocks.
+    uint32_t blk = 0;
+    for (uint32_t i = 0; i < F.instructions.size(); ++i) {
+        const IRInstruction* ir = F.instructions[i];
+        while (blk + 1 < cfg.size() && cfg.blocks[blk + 1].first <= i) ++blk;
+        if (!ir || !cfg.reachable(blk)) continue;
         std::vector<MIPSInstruction> code;
         switch (ir->opCode) {
             case IRInstruction::OpCode::LABEL: {
-                auto lbl = std::dynamic_pointer_cast<IRLabelOperand>(ir->operands[0]);
-                std::string L = qualLabel(F.name, lbl->getName());
+                auto lbl = ir->operands[0]->asLabel();
+                std::string L = labelNames[lbl->id];
                 code.emplace_back(MIPSOp::SLL, L, std::vector<std::shared_ptr<MIPSOperand>>{
                     Registers::zero(), Registers::zero(), std::make_shared<Immediate>(0)
                 });
                 break;
             }
             case IRInstruction::OpCode::ASSIGN: {
-                auto dst = std::dynamic_pointer_cast<IRVariableOperand>(ir->operands[0]);
+                auto dst = ir->operands[0]->asVariable();
                 if (!dst) break;
-                if (ir->operands.size() == 3 && std::dynamic_pointer_cast<IRArrayType>(dst->type)) {
+                if (ir->operands.size() == 3 && dst->isArray()) {
                     auto tCnt  = Registers::t0();
                     auto tVal  = Registers::t1();
                     auto tIdx  = Registers::t2();
@@ -97,13 +104,12 @@ std::vector<MIPSInstruction> emitFunctionNaive(const IRFunction& F) {
                     loadOp(ir->operands[1], tCnt, code);
                     loadOp(ir->operands[2], tVal, code);
                     code.emplace_back(MIPSOp::LI, "", std::vector<std::shared_ptr<MIPSOperand>>{ tIdx, std::make_shared<Immediate>(0) });
-                    int baseOff = fi.varOffset[dst->getName()];
-                    if (fi.paramArrayNames.count(dst->getName())) {
+                    int baseOff = fi.offsetOf(dst);
+                    if (fi.passedByPointer(dst)) {
                         code.emplace_back(MIPSOp::LW, "", std::vector<std::shared_ptr<MIPSOperand>>{ baseR, std::make_shared<Address>(baseOff, Registers::fp()) });
                     } else {
                         code.emplace_back(MIPSOp::ADDI, "", std::vector<std::shared_ptr<MIPSOperand>>{ baseR, Registers::fp(), std::make_shared<Immediate>(baseOff) });
                     }
-                    static int arrSetCounter = 0;
                     std::string Lloop = F.name + std::string("_arrset_") + std::to_string(arrSetCounter++);
                     std::string Lend  = F.name + std::string("_arrset_end_") + std::to_string(arrSetCounter++);
                     code.emplace_back(MIPSOp::SLL, Lloop, std::vector<std::shared_ptr<MIPSOperand>>{ Registers::zero(), Registers::zero(), std::make_shared<Immediate>(0) });
@@ -118,7 +124,7 @@ std::vector<MIPSInstruction> emitFunctionNaive(const IRFunction& F) {
                     auto src = ir->operands[1];
                     auto t0 = Registers::t0();
                     loadOp(src, t0, code);
-                    storeVar(dst->getName(), t0, code);
+                    storeVar(dst, t0, code);
                 }
                 break;
             }
@@ -128,7 +134,7 @@ std::vector<MIPSInstruction> emitFunctionNaive(const IRFunction& F) {
             case IRInstruction::OpCode::DIV:
             case IRInstruction::OpCode::AND:
             case IRInstruction::OpCode::OR: {
-                auto dst = std::dynamic_pointer_cast<IRVariableOperand>(ir->operands[0]);
+                auto dst = ir->operands[0]->asVariable();
                 auto t0 = Registers::t0();
                 auto t1 = Registers::t1();
                 auto t2 = Registers::t2();
@@ -141,13 +147,18 @@ std::vector<MIPSInstruction> emitFunctionNaive(const IRFunction& F) {
                 else if (ir->opCode == IRInstruction::OpCode::AND) op = MIPSOp::AND;
                 else if (ir->opCode == IRInstruction::OpCode::OR)  op = MIPSOp::OR;
                 code.emplace_back(op, "", std::vector<std::shared_ptr<MIPSOperand>>{ t2, t0, t1 });
-                storeVar(dst->getName(), t2, code);
+                storeVar(dst, t2, code);
+                for (uint32_t k : sr.advance[i]) {
+                    code.emplace_back(MIPSOp::ADDI, "", std::vector<std::shared_ptr<MIPSOperand>>{
+                        sr.pointers[k].reg, sr.pointers[k].reg, std::make_shared<Immediate>(sr.pointers[k].stride)
+                    });
+                }
                 break;
             }
             case IRInstruction::OpCode::GOTO: {
-                auto lbl = std::dynamic_pointer_cast<IRLabelOperand>(ir->operands[0]);
+                auto lbl = ir->operands[0]->asLabel();
                 code.emplace_back(MIPSOp::J, "", std::vector<std::shared_ptr<MIPSOperand>>{
-                    std::make_shared<Label>(qualLabel(F.name, lbl->getName()))
+                    std::make_shared<Label>(labelNames[lbl->id])
                 });
                 break;
             }
@@ -156,7 +167,7 @@ std::vector<MIPSInstruction> emitFunctionNaive(const IRFunction& F) {
             case IRInstruction::OpCode::BRLT:
             case IRInstruction::OpCode::BRGT:
             case IRInstruction::OpCode::BRGEQ: {
-                auto lbl = std::dynamic_pointer_cast<IRLabelOperand>(ir->operands[0]);
+                auto lbl = ir->operands[0]->asLabel();
                 auto t0 = Registers::t0();
                 auto t1 = Registers::t1();
                 loadOp(ir->operands[1], t0, code);
@@ -167,14 +178,14 @@ std::vector<MIPSInstruction> emitFunctionNaive(const IRFunction& F) {
                 else if (ir->opCode == IRInstruction::OpCode::BRGT) bop = MIPSOp::BGT;
                 else if (ir->opCode == IRInstruction::OpCode::BRGEQ) bop = MIPSOp::BGE;
                 code.emplace_back(bop, "", std::vector<std::shared_ptr<MIPSOperand>>{
-                    t0, t1, std::make_shared<Label>(qualLabel(F.name, lbl->getName()))
+                    t0, t1, std::make_shared<Label>(labelNames[lbl->id])
                 });
                 break;
             }
             case IRInstruction::OpCode::CALL:
             case IRInstruction::OpCode::CALLR: {
                 size_t idx = (ir->opCode == IRInstruction::OpCode::CALLR) ? 2 : 1;
-                auto fnOp = std::dynamic_pointer_cast<IRFunctionOperand>(ir->operands[idx-1]);
+                auto fnOp = ir->operands[idx-1]->asFunction();
                 std::string callee = fnOp ? fnOp->getName() : ir->operands[idx-1]->toString();
                 if (callee == "geti") {
                     out.emplace_back(MIPSOp::LI, "", std::vector<std::shared_ptr<MIPSOperand>>{
@@ -182,8 +193,8 @@ std::vector<MIPSInstruction> emitFunctionNaive(const IRFunction& F) {
                     });
                     out.emplace_back(MIPSOp::SYSCALL, "", std::vector<std::shared_ptr<MIPSOperand>>{});
                     if (ir->opCode == IRInstruction::OpCode::CALLR) {
-                        auto dst = std::dynamic_pointer_cast<IRVariableOperand>(ir->operands[0]);
-                        storeVar(dst->getName(), Registers::v0(), code);
+                        auto dst = ir->operands[0]->asVariable();
+                        storeVar(dst, Registers::v0(), code);
                     }
                     break;
                 }
@@ -193,8 +204,8 @@ std::vector<MIPSInstruction> emitFunctionNaive(const IRFunction& F) {
                     });
                     out.emplace_back(MIPSOp::SYSCALL, "", std::vector<std::shared_ptr<MIPSOperand>>{});
                     if (ir->opCode == IRInstruction::OpCode::CALLR) {
-                        auto dst = std::dynamic_pointer_cast<IRVariableOperand>(ir->operands[0]);
-                        storeVar(dst->getName(), Registers::v0(), code);
+                        auto dst = ir->operands[0]->asVariable();
+                        storeVar(dst, Registers::v0(), code);
                     }
                     break;
                 }
@@ -210,8 +221,8 @@ std::vector<MIPSInstruction> emitFunctionNaive(const IRFunction& F) {
                 if (callee == "putf") {
                     auto f12 = std::make_shared<Register>(Register{"f12", true});
                     if (idx < ir->operands.size()) {
-                        if (auto v = std::dynamic_pointer_cast<IRVariableOperand>(ir->operands[idx])) {
-                            int off = fi.varOffset[v->getName()];
+                        if (auto v = ir->operands[idx]->asVariable()) {
+                            int off = fi.offsetOf(v);
                             code.emplace_back(MIPSOp::L_S, "", std::vector<std::shared_ptr<MIPSOperand>>{
                                 f12, std::make_shared<Address>(off, Registers::fp())
                             });
@@ -229,10 +240,10 @@ std::vector<MIPSInstruction> emitFunctionNaive(const IRFunction& F) {
                     });
                     out.emplace_back(MIPSOp::SYSCALL, "", std::vector<std::shared_ptr<MIPSOperand>>{});
                     if (ir->opCode == IRInstruction::OpCode::CALLR) {
-                        auto dst = std::dynamic_pointer_cast<IRVariableOperand>(ir->operands[0]);
+                        auto dst = ir->operands[0]->asVariable();
                         auto f0 = std::make_shared<Register>(Register{"f0", true});
                         // store float to slot
-                        int off = fi.varOffset[dst->getName()];
+                        int off = fi.offsetOf(dst);
                         code.emplace_back(MIPSOp::S_S, "", std::vector<std::shared_ptr<MIPSOperand>>{ f0, std::make_shared<Address>(off, Registers::fp()) });
                     }
                     break;
@@ -240,10 +251,10 @@ std::vector<MIPSInstruction> emitFunctionNaive(const IRFunction& F) {
                 static std::shared_ptr<Register> aRegs[4] = { Registers::a0(), Registers::a1(), Registers::a2(), Registers::a3() };
                 for (size_t a = 0; a < 4 && idx + a < ir->operands.size(); ++a) {
                     auto arg = ir->operands[idx + a];
-                    if (auto v = std::dynamic_pointer_cast<IRVariableOperand>(arg)) {
-                        if (std::dynamic_pointer_cast<IRArrayType>(v->type)) {
-                            int base = fi.varOffset[v->getName()];
-                            if (fi.paramArrayNames.count(v->getName())) {
+                    if (auto v = arg->asVariable()) {
+                        if (v->isArray()) {
+                            int base = fi.offsetOf(v);
+                            if (fi.passedByPointer(v)) {
                                 code.emplace_back(MIPSOp::LW, "", std::vector<std::shared_ptr<MIPSOperand>>{ aRegs[a], std::make_shared<Address>(base, Registers::fp()) });
                             } else {
                                 code.emplace_back(MIPSOp::ADDI, "", std::vector<std::shared_ptr<MIPSOperand>>{ aRegs[a], Registers::fp(), std::make_shared<Immediate>(base) });
@@ -257,7 +268,7 @@ std::vector<MIPSInstruction> emitFunctionNaive(const IRFunction& F) {
                 }
                 if (idx + 4 < ir->operands.size()) {
                     size_t extraStart = idx + 4;
-                    std::vector<std::shared_ptr<IROperand>> extras;
+                    std::vector<const IROperand*> extras;
                     for (size_t a = extraStart; a < ir->operands.size(); ++a) extras.push_back(ir->operands[a]);
                     for (size_t r = extras.size(); r-- > 0; ) {
                         auto t = Registers::t0();
@@ -266,14 +277,23 @@ std::vector<MIPSInstruction> emitFunctionNaive(const IRFunction& F) {
                         code.emplace_back(MIPSOp::SW, "", std::vector<std::shared_ptr<MIPSOperand>>{ t, std::make_shared<Address>(0, Registers::sp()) });
                     }
                 }
+                if (canJumpToTailCallee(fi, F, i)) {
+                    emitTailJump(fi, callee, code);
+                    break;
+                }
+                // Without clobber summaries, any call may overwrite a pointer.
+                for (uint32_t k : sr.active[blk])
+                    code.emplace_back(MIPSOp::SW, "", std::vector<std::shared_ptr<MIPSOperand>>{ sr.pointers[k].reg, std::make_shared<Address>(fi.savedSlot(k), Registers::fp()) });
                 code.emplace_back(MIPSOp::JAL, "", std::vector<std::shared_ptr<MIPSOperand>>{ std::make_shared<Label>(callee) });
+                for (uint32_t k : sr.active[blk])
+                    code.emplace_back(MIPSOp::LW, "", std::vector<std::shared_ptr<MIPSOperand>>{ sr.pointers[k].reg, std::make_shared<Address>(fi.savedSlot(k), Registers::fp()) });
                 if (idx + 4 < ir->operands.size()) {
                     int extra = int(ir->operands.size() - (idx + 4));
                     code.emplace_back(MIPSOp::ADDI, "", std::vector<std::shared_ptr<MIPSOperand>>{ Registers::sp(), Registers::sp(), std::make_shared<Immediate>(extra * 4) });
                 }
                 if (ir->opCode == IRInstruction::OpCode::CALLR) {
-                    auto dst = std::dynamic_pointer_cast<IRVariableOperand>(ir->operands[0]);
-                    storeVar(dst->getName(), Registers::v0(), code);
+                    auto dst = ir->operands[0]->asVariable();
+                    storeVar(dst, Registers::v0(), code);
                 }
                 break;
             }
@@ -289,11 +309,15 @@ std::vector<MIPSInstruction> emitFunctionNaive(const IRFunction& F) {
                 auto tIdx = Registers::t1();
                 auto tAddr = Registers::t2();
                 loadOp(ir->operands[0], tVal, code);
-                auto arrVar = std::dynamic_pointer_cast<IRVariableOperand>(ir->operands[1]);
+                if (sr.access[i] != StrengthReduction::kNone) {
+                    code.emplace_back(MIPSOp::SW, "", std::vector<std::shared_ptr<MIPSOperand>>{ tVal, std::make_shared<Address>(0, sr.pointers[sr.access[i]].reg) });
+                    break;
+                }
+                auto arrVar = ir->operands[1]->asVariable();
                 loadOp(ir->operands[2], tIdx, code);
                 std::shared_ptr<Register> baseReg = Registers::t3();
-                int baseOff = fi.varOffset[arrVar->getName()];
-                if (fi.paramArrayNames.count(arrVar->getName())) {
+                int baseOff = fi.offsetOf(arrVar);
+                if (fi.passedByPointer(arrVar)) {
                     code.emplace_back(MIPSOp::LW, "", std::vector<std::shared_ptr<MIPSOperand>>{ baseReg, std::make_shared<Address>(baseOff, Registers::fp()) });
                 } else {
                     code.emplace_back(MIPSOp::ADDI, "", std::vector<std::shared_ptr<MIPSOperand>>{ baseReg, Registers::fp(), std::make_shared<Immediate>(baseOff) });
@@ -304,15 +328,20 @@ std::vector<MIPSInstruction> emitFunctionNaive(const IRFunction& F) {
                 break;
             }
             case IRInstruction::OpCode::ARRAY_LOAD: {
-                auto dst = std::dynamic_pointer_cast<IRVariableOperand>(ir->operands[0]);
+                auto dst = ir->operands[0]->asVariable();
                 auto tIdx = Registers::t0();
                 auto tAddr = Registers::t1();
                 auto tVal = Registers::t2();
-                auto arrVar = std::dynamic_pointer_cast<IRVariableOperand>(ir->operands[1]);
+                if (sr.access[i] != StrengthReduction::kNone) {
+                    code.emplace_back(MIPSOp::LW, "", std::vector<std::shared_ptr<MIPSOperand>>{ tVal, std::make_shared<Address>(0, sr.pointers[sr.access[i]].reg) });
+                    storeVar(dst, tVal, code);
+                    break;
+                }
+                auto arrVar = ir->operands[1]->asVariable();
                 loadOp(ir->operands[2], tIdx, code);
                 std::shared_ptr<Register> baseReg = Registers::t3();
-                int baseOff = fi.varOffset[arrVar->getName()];
-                if (fi.paramArrayNames.count(arrVar->getName())) {
+                int baseOff = fi.offsetOf(arrVar);
+                if (fi.passedByPointer(arrVar)) {
                     code.emplace_back(MIPSOp::LW, "", std::vector<std::shared_ptr<MIPSOperand>>{ baseReg, std::make_shared<Address>(baseOff, Registers::fp()) });
                 } else {
                     code.emplace_back(MIPSOp::ADDI, "", std::vector<std::shared_ptr<MIPSOperand>>{ baseReg, Registers::fp(), std::make_shared<Immediate>(baseOff) });
@@ -320,11 +349,26 @@ std::vector<MIPSInstruction> emitFunctionNaive(const IRFunction& F) {
                 code.emplace_back(MIPSOp::SLL, "", std::vector<std::shared_ptr<MIPSOperand>>{ tAddr, tIdx, std::make_shared<Immediate>(2) });
                 code.emplace_back(MIPSOp::ADD, "", std::vector<std::shared_ptr<MIPSOperand>>{ tAddr, baseReg, tAddr });
                 code.emplace_back(MIPSOp::LW,  "", std::vector<std::shared_ptr<MIPSOperand>>{ tVal, std::make_shared<Address>(0, tAddr) });
-                storeVar(dst->getName(), tVal, code);
+                storeVar(dst, tVal, code);
                 break;
             }
             default: break;
         }
+        // Pointers into a loop this block enters are set on the way out:
+        // before a closing jump or branch, after anything else, and after
+        // the branch for a loop entered only by falling through.
+        if (i == cfg.blocks[blk].last) {
+            auto setPointers = [&](const std::vector<uint32_t>& ks, std::vector<MIPSInstruction>& setup){
+                for (uint32_t k : ks) {
+                    loadOp(sr.pointers[k].index, Registers::t2(), setup);
+                    emitComputeArrayAddr(fi, sr.pointers[k].array, Registers::t2(), sr.pointers[k].reg, Registers::t3(), setup);
+                }
+            };
+            std::vector<MIPSInstruction> setup;
+            setPointers(sr.init[blk], setup);
+            code.insert(ir->isJump() ? code.begin() : code.end(), setup.begin(), setup.end());
+            setPointers(sr.fallInit[blk], code);
+        }
         out.insert(out.end(), code.begin(), code.end());
     }
 
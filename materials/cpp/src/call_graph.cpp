@@ -0,0 +1,145 @@
+#include "call_graph.hpp"
+
+#include <algorithm>
+
+namespace ircpp {
+
+CallGraph CallGraph::build(const IRProgram& program) {
+    std::vector<std::string_view> names;
+    std::vector<std::vector<std::string_view>> calls;
+    for (const auto& fn : program.functions) {
+        if (!fn) continue;
+        names.push_back(fn->name);
+        calls.emplace_back();
+        for (const IRInstruction* ir : fn->instructions) {
+            if (!ir || (ir->opCode != IRInstruction::OpCode::CALL && ir->opCode != IRInstruction::OpCode::CALLR)) continue;
+            if (auto callee = ir->operands[ir->opCode == IRInstruction::OpCode::CALLR ? 1 : 0]->asFunction())
+                calls.back().push_back(callee->value);
+        }
+    }
+    return build(names, calls);
+}
+
+CallGraph CallGraph::build(const std::vector<std::string_view>& names,
+                           const std::vector<std::vector<std::string_view>>& calls) {
+    const uint32_t n = static_cast<uint32_t>(names.size());
+    CallGraph G;
+    std::unordered_map<std::string_view, uint32_t> index;
+    for (uint32_t f = 0; f < n; ++f) index.emplace(names[f], f); // first definition wins
+    G.callees.resize(n);
+    for (uint32_t f = 0; f < n; ++f) {
+        for (std::string_view c : calls[f]) {
+            auto it = index.find(c);
+            if (it != index.end()) G.callees[f].push_back(it->second);
+        }
+        std::sort(G.callees[f].begin(), G.callees[f].end());
+        G.callees[f].erase(std::unique(G.callees[f].begin(), G.callees[f].end()), G.callees[f].end());
+    }
+    G.names.assign(names.begin(), names.end());
+
+    // Tarjan's algorithm with an explicit stack, so deep call chains cannot
+    // overflow ours. It closes components in reverse topological order,
+    // which is exactly callees first.
+    constexpr uint32_t kUnvisited = UINT32_MAX;
+    std::vector<uint32_t> order(n, kUnvisited), low(n, 0), stack;
+    std::vector<bool> onStack(n, false);
+    std::vector<std::pair<uint32_t, size_t>> frames; // function, next callee to visit
+    G.componentOf.assign(n, 0);
+    uint32_t counter = 0;
+    for (uint32_t root = 0; root < n; ++root) {
+        if (order[root] != kUnvisited) continue;
+        frames.push_back({root, 0});
+        order[root] = low[root] = counter++;
+        stack.push_back(root);
+        onStack[root] = true;
+        while (!frames.empty()) {
+            auto& [f, next] = frames.back();
+            if (next < G.callees[f].size()) {
+                const uint32_t c = G.callees[f][next++];
+                if (order[c] == kUnvisited) {
+                    order[c] = low[c] = counter++;
+                    stack.push_back(c);
+                    onStack[c] = true;
+                    frames.push_back({c, 0});
+                } else if (onStack[c]) {
+                    low[f] = std::min(low[f], order[c]);
+                }
+                continue;
+            }
+            const uint32_t done = f;
+            frames.pop_back();
+            if (!frames.empty()) low[frames.back().first] = std::min(low[frames.back().first], low[done]);
+            if (low[done] != order[done]) continue;
+            G.components.emplace_back();
+            uint32_t m;
+            do {
+                m = stack.back();
+                stack.pop_back();
+                onStack[m] = false;
+                G.componentOf[m] = static_cast<uint32_t>(G.components.size() - 1);
+                G.components.back().push_back(m);
+            } while (m != done);
+            std::sort(G.components.back().begin(), G.components.back().end());
+        }
+    }
+    return G;
+}
+
+uint32_t ClobberSummaries::of(std::string_view callee) const {
+    auto it = masks_.find(std::string(callee));
+    return it == masks_.end() ? kAll : it->second;
+}
+
+bool ClobberSummaries::has(std::string_view callee) const {
+    return masks_.count(std::string(callee)) != 0;
+}
+
+uint32_t clobberedRegisters(const std::vector<MIPSInstruction>& code, const ClobberSummaries& callees) {
+    uint32_t mask = 0;
+    auto add = [&](const std::shared_ptr<MIPSOperand>& op) {
+        if (auto r = std::dynamic_pointer_cast<Register>(op)) {
+            const int n = gprNumber(r->name);
+            if (n >= 0) mask |= 1u << n;
+        }
+    };
+    for (const MIPSInstruction& ins : code) {
+        switch (ins.op) {
+            // Stores, compares and jumps write no general register.
+            case MIPSOp::SW: case MIPSOp::S_S:
+            case MIPSOp::BEQ: case MIPSOp::BNE: case MIPSOp::BLT: case MIPSOp::BGT: case MIPSOp::BGE:
+            case MIPSOp::JR: case MIPSOp::BC1T: case MIPSOp::BC1F:
+            case MIPSOp::C_EQ_S: case MIPSOp::C_NE_S: case MIPSOp::C_LT_S: case MIPSOp::C_GT_S: case MIPSOp::C_GE_S:
+                break;
+            case MIPSOp::JAL:
+                mask |= callees.of(ins.operands[0]->toString());
+                break;
+            case MIPSOp::J:
+                if (callees.has(ins.operands[0]->toString())) mask |= callees.of(ins.operands[0]->toString());
+                break;
+            case MIPSOp::SYSCALL:
+                mask |= 1u << gprNumber("v0");
+                break;
+            default:
+                if (!ins.operands.empty()) add(ins.operands[0]);
+                break;
+        }
+    }
+    return mask & ~(1u << gprNumber("sp") | 1u << gprNumber("fp") | 1u << gprNumber("ra"));
+}
+
+bool isTailCall(const IRFunction& F, size_t i) {
+    using Op = IRInstruction::OpCode;
+    const IRInstruction* call = F.instructions[i];
+    if (!call || (call->opCode != Op::CALL && call->opCode != Op::CALLR)) return false;
+    for (size_t j = i + 1; j < F.instructions.size(); ++j) {
+        const IRInstruction* ir = F.instructions[j];
+        if (!ir || ir->opCode == Op::LABEL) continue;
+        if (ir->opCode != Op::RETURN) return false;
+        if (call->opCode == Op::CALL) return !F.returnType;
+        auto v = ir->operands[0]->asVariable();
+        return v && v->id == call->operands[0]->asVariable()->id;
+    }
+    return call->opCode == Op::CALL && !F.returnType;
+}
+
+} // namespace ircpp
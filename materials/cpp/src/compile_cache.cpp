@@ -0,0 +1,270 @@
+#include "compile_cache.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <unordered_map>
+#include <system_error>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/stat.h>
+#endif
+
+namespace ircpp {
+
+namespace {
+
+// Bump when the entry layout or key derivation changes.
+constexpr const char* kCacheFormat = "ircpp-cache-2";
+
+uint64_t fnv1a(std::string_view s, uint64_t h = 14695981039346656037ull) {
+    for (unsigned char c : s) { h ^= c; h *= 1099511628211ull; }
+    return h;
+}
+
+// Word-at-a-time multiply/rotate hash with a splitmix64 finalizer; unrelated
+// to FNV, so the pair behaves like one 128-bit key.
+uint64_t mix64(std::string_view s, uint64_t h) {
+    const uint64_t k1 = 0x9E3779B97F4A7C15ull, k2 = 0xC2B2AE3D27D4EB4Full;
+    h ^= s.size() * k1;
+    size_t i = 0;
+    for (; i + 8 <= s.size(); i += 8) {
+        uint64_t w;
+        std::memcpy(&w, s.data() + i, 8);
+        h ^= w * k2;
+        h = ((h << 31) | (h >> 33)) * k1;
+    }
+    uint64_t tail = 0;
+    for (size_t j = 0; i + j < s.size(); ++j) tail |= uint64_t(static_cast<unsigned char>(s[i + j])) << (8 * j);
+    h ^= tail * k2;
+    h ^= h >> 30; h *= 0xBF58476D1CE4E5B9ull;
+    h ^= h >> 27; h *= 0x94D049BB133111EBull;
+    h ^= h >> 31;
+    return h;
+}
+
+// An entry is the function's own clobber mask (see compileWithCache) as
+// eight hex digits and a newline, then its assembly.
+std::string makeEntry(uint32_t clobbers, std::string_view text) {
+    static const char hex[] = "0123456789abcdef";
+    std::string entry(9, '\n');
+    for (int i = 0; i < 8; ++i) entry[7 - i] = hex[(clobbers >> (4 * i)) & 0xf];
+    entry.append(text);
+    return entry;
+}
+
+bool readEntry(std::string& entry, uint32_t& clobbers) {
+    if (entry.size() < 9 || entry[8] != '\n') return false;
+    clobbers = 0;
+    for (int i = 0; i < 8; ++i) {
+        const char c = entry[i];
+        const int d = c >= '0' && c <= '9' ? c - '0' : c >= 'a' && c <= 'f' ? c - 'a' + 10 : -1;
+        if (d < 0) return false;
+        clobbers = clobbers << 4 | uint32_t(d);
+    }
+    entry.erase(0, 9);
+    return true;
+}
+
+} // namespace
+
+CompileCache::CompileCache(std::string dir, std::string config)
+    : dir_(std::move(dir)), config_(std::string(kCacheFormat) + ";" + std::move(config)) {}
+
+CompileCache::Key CompileCache::keyFor(std::string_view functionText, std::string_view context) const {
+    // Parts are separated by a NUL, which IR text never contains.
+    const std::string_view nul("\0", 1);
+    uint64_t a = fnv1a(context, fnv1a(nul, fnv1a(functionText, fnv1a(nul, fnv1a(config_)))));
+    uint64_t b = mix64(context, mix64(functionText, mix64(config_, 0x243F6A8885A308D3ull)));
+    return {a, b};
+}
+
+std::string CompileCache::pathFor(const Key& key) const {
+    static const char hex[] = "0123456789abcdef";
+    std::string name(32, '0');
+    for (int i = 0; i < 16; ++i) {
+        name[15 - i] = hex[(key.hi >> (4 * i)) & 0xf];
+        name[31 - i] = hex[(key.lo >> (4 * i)) & 0xf];
+    }
+    return (std::filesystem::path(dir_) / (name + ".s")).string();
+}
+
+bool CompileCache::lookup(const Key& key, std::string& text, uint32_t& clobbers) {
+    std::ifstream in(pathFor(key), std::ios::in | std::ios::binary);
+    if (!in) { ++misses_; return false; }
+    text.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    if (in.bad() || !readEntry(text, clobbers)) { ++misses_; return false; }
+    ++hits_;
+    return true;
+}
+
+void CompileCache::store(const Key& key, uint32_t clobbers, std::string_view text) {
+    std::error_code ec;
+    if (!dirReady_) dirReady_ = std::filesystem::create_directories(dir_, ec) || std::filesystem::is_directory(dir_, ec);
+    const std::string path = pathFor(key);
+    static thread_local std::mt19937_64 rng{std::random_device{}()};
+    const std::string tmp = path + ".tmp" + std::to_string(rng());
+    {
+        std::ofstream out(tmp, std::ios::out | std::ios::trunc | std::ios::binary);
+        if (!out) return;
+        const std::string entry = makeEntry(clobbers, text);
+        out.write(entry.data(), static_cast<std::streamsize>(entry.size()));
+        if (!out.good()) { out.close(); std::filesystem::remove(tmp, ec); return; }
+    }
+    std::filesystem::rename(tmp, path, ec);
+    if (ec) std::filesystem::remove(tmp, ec);
+}
+
+std::string cacheConfigFor(const IRToMIPSSelector& selector) {
+    std::string config = selector.getAllocMode() == IRToMIPSSelector::AllocMode::Naive ? "naive" : "greedy";
+#if defined(__linux__)
+    // A rebuilt compiler has a new size or mtime; elsewhere only kCacheFormat
+    // guards against stale entries.
+    struct stat st;
+    if (::stat("/proc/self/exe", &st) == 0) {
+        config += ";" + std::to_string(static_cast<long long>(st.st_size));
+        config += ";" + std::to_string(static_cast<long long>(st.st_mtime));
+    }
+#endif
+    return config;
+}
+
+std::string compileWithCache(std::string_view irText, const IRReader& reader,
+                             IRToMIPSSelector& selector, CompileCache& cache,
+                             const std::function<void(IRFunction&)>& prepare,
+                             const InlineLimits* inlining,
+                             PeepholeOptimizer* peephole) {
+    std::vector<std::string_view> blocks, names;
+    std::vector<std::vector<std::string_view>> calls;
+    bool split = !IRReader::isBinaryIR(irText) && IRReader::splitFunctions(irText, blocks);
+    if (split) {
+        names.resize(blocks.size());
+        calls.resize(blocks.size());
+        for (size_t b = 0; b < blocks.size() && split; ++b) split = IRReader::scanCalls(blocks[b], names[b], calls[b]);
+    }
+    if (!split) {
+        IRProgram program = IRReader::isBinaryIR(irText) ? reader.parseIRBinary(irText)
+                                                         : reader.parseIRString(irText);
+        const CallGraph graph = CallGraph::build(program);
+        if (inlining) inlineLeafCalls(program, *inlining);
+        if (prepare)
+            for (auto& fn : program.functions) prepare(*fn);
+        std::vector<MIPSInstruction> code = selector.selectProgram(program, &graph);
+        if (peephole) peephole->run(code);
+        return selector.generateAssembly(code);
+    }
+
+    // Same order as selectProgram: components bottom-up, each function's
+    // own mask taken with its component's members counted as clobbering
+    // nothing, and the component's summary the union of those. Components
+    // are grouped into waves whose callees all lie in earlier waves, so each
+    // wave's keys can name its callees' summaries and its misses are still
+    // parsed together.
+    const CallGraph graph = CallGraph::build(names, calls);
+    const size_t n = blocks.size();
+    std::vector<std::vector<uint32_t>> waves;
+    std::vector<uint32_t> waveOf(graph.components.size(), 0);
+    for (uint32_t c = 0; c < graph.components.size(); ++c) {
+        for (uint32_t f : graph.components[c])
+            for (uint32_t g : graph.callees[f])
+                if (graph.componentOf[g] != c) waveOf[c] = std::max(waveOf[c], waveOf[graph.componentOf[g]] + 1);
+        if (waveOf[c] >= waves.size()) waves.resize(waveOf[c] + 1);
+        waves[waveOf[c]].push_back(c);
+    }
+
+    ClobberSummaries summaries;
+    std::vector<std::string> pieces(n);
+    std::vector<uint32_t> own(n, 0);
+    std::vector<CompileCache::Key> keys(n);
+    std::vector<std::vector<MIPSInstruction>> code(n);
+    std::vector<bool> isDirty(n, false);
+    // Leaves as parsed, before `prepare`, for inlining into misses; all of
+    // them sit in the first wave, but may be parsed in any.
+    std::vector<IRProgram> leafPrograms;
+    std::unordered_map<std::string_view, const IRFunction*> leaves;
+    std::vector<bool> leafParsed(n, false);
+    auto leaf = [&](std::string_view name) {
+        auto it = leaves.find(name);
+        return it == leaves.end() ? nullptr : it->second;
+    };
+    for (const auto& wave : waves) {
+        std::vector<uint32_t> dirty;
+        for (uint32_t c : wave) {
+            for (uint32_t f : graph.components[c]) {
+                // Calls to names the program does not define always clobber
+                // everything, so only defined callees need a say in the key.
+                std::string context;
+                for (uint32_t g : graph.callees[f]) {
+                    if (graph.componentOf[g] == c) continue;
+                    context += graph.names[g];
+                    context += '=' + std::to_string(summaries.of(graph.names[g])) + ';';
+                    if (inlining && graph.callees[g].empty()) {
+                        context += '{';
+                        context += blocks[g];
+                        context += '}';
+                    }
+                }
+                keys[f] = cache.keyFor(blocks[f], context);
+                if (!cache.lookup(keys[f], pieces[f], own[f])) {
+                    dirty.push_back(f);
+                    isDirty[f] = true;
+                }
+            }
+        }
+
+        if (!dirty.empty() && inlining) {
+            std::string leafText;
+            for (uint32_t f : dirty)
+                for (uint32_t g : graph.callees[f]) {
+                    if (!graph.callees[g].empty() || leafParsed[g]) continue;
+                    leafParsed[g] = true;
+                    leafText.append(blocks[g]);
+                    leafText.push_back('\n');
+                }
+            if (!leafText.empty()) {
+                leafPrograms.push_back(reader.parseIRString(leafText));
+                for (const auto& fn : leafPrograms.back().functions) leaves.emplace(fn->name, fn.get());
+            }
+        }
+        if (!dirty.empty()) {
+            std::string dirtyText;
+            for (uint32_t f : dirty) { dirtyText.append(blocks[f]); dirtyText.push_back('\n'); }
+            IRProgram program = reader.parseIRString(dirtyText);
+            if (program.functions.size() != dirty.size()) throw IRException("Unexpected function count");
+            for (size_t i = 0; i < dirty.size(); ++i) {
+                if (inlining) inlineLeafCalls(*program.functions[i], leaf, *inlining);
+                if (prepare) prepare(*program.functions[i]);
+                code[dirty[i]] = selector.selectFunction(*program.functions[i], &summaries);
+            }
+        }
+
+        for (uint32_t c : wave) {
+            const auto& members = graph.components[c];
+            for (uint32_t f : members) summaries.set(graph.names[f], 0);
+            uint32_t mask = 0;
+            for (uint32_t f : members) {
+                if (isDirty[f]) {
+                    own[f] = clobberedRegisters(code[f], summaries);
+                    if (peephole) peephole->run(code[f]);
+                    pieces[f] = selector.generateText(code[f]);
+                    cache.store(keys[f], own[f], pieces[f]);
+                    code[f].clear();
+                }
+                mask |= own[f];
+            }
+            for (uint32_t f : members) summaries.set(graph.names[f], mask);
+        }
+    }
+
+    std::string out = ".text\n" + selector.generateText(selector.selectEntry());
+    size_t total = out.size();
+    for (const auto& p : pieces) total += p.size();
+    out.reserve(total);
+    for (const auto& p : pieces) out += p;
+    return out;
+}
+
+} // namespace ircpp
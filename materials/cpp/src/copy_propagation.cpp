@@ -0,0 +1,94 @@
+#include "pass_manager.hpp"
+
+#include "ssa.hpp"
+
+namespace ircpp {
+
+namespace {
+
+using Op = IRInstruction::OpCode;
+
+bool isCopy(const IRInstruction* ir) {
+    if (ir->opCode != Op::ASSIGN || ir->operands.size() != 2 || !ir->scalarDef()) return false;
+    auto src = ir->operands[1]->asVariable();
+    return src && !src->isArray();
+}
+
+// Global copy propagation on SSA form. There every version has one
+// definition that dominates its reads, so after `assign d, s` every read of d
+// can read s instead, wherever it is; the copy is then dead and goes. A phi
+// whose inputs are all one value (or the phi itself, around a loop) is a copy
+// too. destructSSA keeps versions whose ranges now overlap apart.
+class CopyPropagationPass : public FunctionPass {
+public:
+    const char* name() const override { return "copyprop"; }
+
+    uint32_t run(IRFunction& F, FunctionAnalyses&) override {
+        bool any = false;
+        for (const IRInstruction* ir : F.instructions) {
+            if (!ir || ir->opCode == Op::PHI) return Analysis::kAll;
+            any |= isCopy(ir);
+        }
+        if (!any) return Analysis::kAll;
+        constructSSA(F);
+        propagate(F);
+        destructSSA(F);
+        return Analysis::kNone;
+    }
+
+private:
+    static void propagate(IRFunction& F) {
+        auto& ins = F.instructions;
+        // Each version's replacement, followed to the end of its chain on
+        // lookup.
+        std::vector<IRVariableOperand*> repl(F.variables.begin(), F.variables.end());
+        auto find = [&](IROperand* op) {
+            auto v = static_cast<IRVariableOperand*>(op);
+            while (repl[v->id] != v) v = repl[v->id] = repl[repl[v->id]->id];
+            return v;
+        };
+        std::vector<bool> removed(ins.size(), false);
+        for (uint32_t i = 0; i < ins.size(); ++i) {
+            if (!isCopy(ins[i])) continue;
+            auto d = static_cast<IRVariableOperand*>(ins[i]->operands[0]);
+            repl[d->id] = find(ins[i]->operands[1]);
+            removed[i] = true;
+        }
+        // Resolving one phi can make another trivial, so repeat until none is.
+        for (bool again = true; again; ) {
+            again = false;
+            for (uint32_t i = 0; i < ins.size(); ++i) {
+                if (removed[i] || ins[i]->opCode != Op::PHI) continue;
+                auto d = static_cast<IRVariableOperand*>(ins[i]->operands[0]);
+                IRVariableOperand* same = nullptr;
+                bool trivial = true;
+                for (size_t k = 1; k < ins[i]->operands.size() && trivial; k += 2) {
+                    if (!ins[i]->operands[k]->asVariable()) { trivial = false; break; }
+                    IRVariableOperand* v = find(ins[i]->operands[k]);
+                    if (v == d || v == same) continue;
+                    if (same) trivial = false;
+                    same = v;
+                }
+                if (!trivial || !same) continue;
+                repl[d->id] = same;
+                removed[i] = again = true;
+            }
+        }
+
+        std::vector<IRInstruction*> out;
+        out.reserve(ins.size());
+        for (uint32_t i = 0; i < ins.size(); ++i) {
+            if (removed[i]) continue;
+            IRInstruction* ir = ins[i];
+            ir->forEachScalarUseIndex([&](size_t k) { ir->operands[k] = find(ir->operands[k]); });
+            out.push_back(ir);
+        }
+        ins = std::move(out);
+    }
+};
+
+} // namespace
+
+std::unique_ptr<FunctionPass> createCopyPropagationPass() { return std::make_unique<CopyPropagationPass>(); }
+
+} // namespace ircpp
@@ -0,0 +1,106 @@
+#include "pass_manager.hpp"
+
+namespace ircpp {
+
+namespace {
+
+using Op = IRInstruction::OpCode;
+
+// Whether the instruction does nothing but write its scalar result, so it
+// can go when nothing reads that. Calls and array stores change state the
+// IR does not track; a divide by anything but a nonzero constant may fault.
+bool removable(const IRInstruction* ir) {
+    if (!ir->scalarDef()) return false;
+    switch (ir->opCode) {
+        case Op::ASSIGN: case Op::ADD: case Op::SUB: case Op::MULT: case Op::AND: case Op::OR:
+        case Op::ARRAY_LOAD: case Op::PHI:
+            return true;
+        case Op::DIV: {
+            auto c = ir->operands[2]->asConstant();
+            return c && c->type->isInt() && c->intValue != 0;
+        }
+        default:
+            return false;
+    }
+}
+
+// Dead code elimination in two steps, repeated until nothing changes.
+// First, a variable is needed if an instruction that must stay reads it, or
+// if it feeds a needed variable; definitions of the rest go, which also
+// catches values that only feed themselves around a loop. Then each block is
+// walked backwards against liveness and a definition nothing later reads goes.
+// A callr whose result is dead becomes a plain call.
+class DeadCodeEliminationPass : public FunctionPass {
+public:
+    const char* name() const override { return "dce"; }
+
+    uint32_t run(IRFunction& F, FunctionAnalyses& analyses) override {
+        for (const IRInstruction* ir : F.instructions)
+            if (!ir) return Analysis::kAll;
+        bool changed = false;
+        while (sweep(F, analyses.cfg(), analyses.liveness())) {
+            analyses.invalidate(Analysis::kNone);
+            changed = true;
+        }
+        return changed ? Analysis::kNone : Analysis::kAll;
+    }
+
+private:
+    static bool sweep(IRFunction& F, const ControlFlowGraph& cfg, const Liveness& live) {
+        auto& ins = F.instructions;
+        const uint32_t nvars = static_cast<uint32_t>(F.variables.size());
+
+        std::vector<std::vector<uint32_t>> defs(nvars);
+        std::vector<bool> needed(nvars, false);
+        std::vector<uint32_t> work;
+        auto need = [&](const IRVariableOperand* v) {
+            if (!needed[v->id]) { needed[v->id] = true; work.push_back(v->id); }
+        };
+        for (uint32_t i = 0; i < ins.size(); ++i) {
+            if (removable(ins[i])) defs[ins[i]->scalarDef()->id].push_back(i);
+            else ins[i]->forEachScalarUse(need);
+        }
+        while (!work.empty()) {
+            const uint32_t v = work.back();
+            work.pop_back();
+            for (uint32_t i : defs[v]) ins[i]->forEachScalarUse(need);
+        }
+
+        std::vector<bool> dead(ins.size(), false);
+        bool changed = false;
+        VarSet now(nvars);
+        for (uint32_t b = 0; b < cfg.size(); ++b) {
+            now = live.liveOut[b];
+            for (uint32_t i = cfg.blocks[b].last + 1; i-- > cfg.blocks[b].first; ) {
+                IRInstruction* ir = ins[i];
+                const IRVariableOperand* d = ir->scalarDef();
+                if (d && (!needed[d->id] || !now.test(d->id))) {
+                    if (removable(ir)) {
+                        dead[i] = changed = true;
+                        continue;
+                    }
+                    if (ir->opCode == Op::CALLR) {
+                        auto call = F.arena.make<IRInstruction>(Op::CALL, ir->irLineNumber);
+                        for (size_t k = 1; k < ir->operands.size(); ++k) call->operands.push_back(F.arena, ir->operands[k]);
+                        ins[i] = ir = call;
+                        changed = true;
+                    }
+                }
+                Liveness::transfer(*ir, now);
+            }
+        }
+        if (!changed) return false;
+        std::vector<IRInstruction*> out;
+        out.reserve(ins.size());
+        for (uint32_t i = 0; i < ins.size(); ++i)
+            if (!dead[i]) out.push_back(ins[i]);
+        ins = std::move(out);
+        return true;
+    }
+};
+
+} // namespace
+
+std::unique_ptr<FunctionPass> createDeadCodeEliminationPass() { return std::make_unique<DeadCodeEliminationPass>(); }
+
+} // namespace ircpp
@@ -0,0 +1,71 @@
+#include "def_use.hpp"
+
+#include <algorithm>
+
+namespace ircpp {
+
+DefUseIndex DefUseIndex::build(const IRFunction& function) {
+    const size_t nvars = function.variables.size();
+    const auto& ins = function.instructions;
+    DefUseIndex du;
+
+    // Pass 1 counts occurrences per variable, pass 2 fills them in order.
+    // `last` remembers which instruction each variable was last recorded for,
+    // so repeated operands and read-write instructions merge into one entry.
+    std::vector<uint32_t> last(nvars, kNone);
+    du.begin.assign(nvars + 1, 0);
+    for (uint32_t i = 0; i < ins.size(); ++i) {
+        if (!ins[i]) continue;
+        auto count = [&](const IRVariableOperand* v) {
+            if (last[v->id] != i) { last[v->id] = i; ++du.begin[v->id + 1]; }
+        };
+        ins[i]->forEachScalarUse(count);
+        if (auto d = ins[i]->scalarDef()) count(d);
+    }
+    for (size_t v = 0; v < nvars; ++v) du.begin[v + 1] += du.begin[v];
+
+    du.pos.assign(du.begin[nvars], 0);
+    du.flags.assign(du.begin[nvars], 0);
+    std::vector<uint32_t> fill(du.begin.begin(), du.begin.end() - 1);
+    std::fill(last.begin(), last.end(), kNone);
+    for (uint32_t i = 0; i < ins.size(); ++i) {
+        if (!ins[i]) continue;
+        auto record = [&](const IRVariableOperand* v, uint8_t f) {
+            if (last[v->id] != i) { last[v->id] = i; du.pos[fill[v->id]++] = i; }
+            du.flags[fill[v->id] - 1] |= f;
+        };
+        ins[i]->forEachScalarUse([&](const IRVariableOperand* v) { record(v, Use); });
+        if (auto d = ins[i]->scalarDef()) record(d, Def);
+    }
+
+    du.defBefore.assign(du.pos.size(), kNone);
+    for (size_t v = 0; v < nvars; ++v) {
+        uint32_t lastDef = kNone;
+        for (uint32_t k = du.begin[v]; k < du.begin[v + 1]; ++k) {
+            du.defBefore[k] = lastDef;
+            if (du.flags[k] & Def) lastDef = du.pos[k];
+        }
+    }
+    return du;
+}
+
+uint32_t DefUseIndex::firstAfter(uint32_t var, uint32_t after) const {
+    auto b = pos.begin() + begin[var], e = pos.begin() + begin[var + 1];
+    return static_cast<uint32_t>(std::upper_bound(b, e, after) - pos.begin());
+}
+
+uint32_t DefUseIndex::nextUse(uint32_t var, uint32_t after, uint32_t limit) const {
+    uint32_t k = firstAfter(var, after);
+    if (k == begin[var + 1] || pos[k] > limit || !(flags[k] & Use)) return kNone;
+    return pos[k];
+}
+
+uint32_t DefUseIndex::prevDef(uint32_t var, uint32_t at) const {
+    const uint32_t e = begin[var + 1];
+    const uint32_t k = static_cast<uint32_t>(std::lower_bound(pos.begin() + begin[var], pos.begin() + e, at) - pos.begin());
+    if (k < e) return defBefore[k];
+    if (k == begin[var]) return kNone;
+    return (flags[k - 1] & Def) ? pos[k - 1] : defBefore[k - 1];
+}
+
+} // namespace ircpp
@@ -1,18 +1,20 @@
 #include "emit_helpers.hpp"
 
+#include "call_graph.hpp"
+
 namespace ircpp {
 
 void emitLoadOperand(const FrameInfo& fi,
-                     const std::shared_ptr<IROperand>& op,
+                     const IROperand* op,
                      const std::shared_ptr<Register>& dst,
                      std::vector<MIPSInstruction>& code) {
-    if (auto c = std::dynamic_pointer_cast<IRConstantOperand>(op)) {
-        int val = std::stoi(c->getValueString());
+    if (auto c = op->asConstant()) {
+        int val = c->immediate();
         code.emplace_back(MIPSOp::LI, "", std::vector<std::shared_ptr<MIPSOperand>>{ dst, std::make_shared<Immediate>(val) });
         return;
     }
-    if (auto v = std::dynamic_pointer_cast<IRVariableOperand>(op)) {
-        int off = fi.varOffset.at(v->getName());
+    if (auto v = op->asVariable()) {
+        int off = fi.offsetOf(v);
         code.emplace_back(MIPSOp::LW, "", std::vector<std::shared_ptr<MIPSOperand>>{ dst, std::make_shared<Address>(off, Registers::fp()) });
         return;
     }
@@ -20,21 +22,21 @@ void emitLoadOperand(const FrameInfo& fi,
 }
 
 void emitStoreVar(const FrameInfo& fi,
-                  const std::string& name,
+                  const IRVariableOperand* var,
                   const std::shared_ptr<Register>& src,
                   std::vector<MIPSInstruction>& code) {
-    int off = fi.varOffset.at(name);
+    int off = fi.offsetOf(var);
     code.emplace_back(MIPSOp::SW, "", std::vector<std::shared_ptr<MIPSOperand>>{ src, std::make_shared<Address>(off, Registers::fp()) });
 }
 
 void emitComputeArrayAddr(const FrameInfo& fi,
-                          const std::string& arrayName,
+                          const IRVariableOperand* array,
                           const std::shared_ptr<Register>& indexReg,
                           const std::shared_ptr<Register>& addrReg,
                           const std::shared_ptr<Register>& baseReg,
                           std::vector<MIPSInstruction>& code) {
-    int baseOff = fi.varOffset.at(arrayName);
-    if (fi.paramArrayNames.count(arrayName)) {
+    int baseOff = fi.offsetOf(array);
+    if (fi.passedByPointer(array)) {
         // load pointer from slot
         code.emplace_back(MIPSOp::LW, "", std::vector<std::shared_ptr<MIPSOperand>>{ baseReg, std::make_shared<Address>(baseOff, Registers::fp()) });
     } else {
@@ -47,23 +49,38 @@ void emitComputeArrayAddr(const FrameInfo& fi,
 }
 
 void emitStoreF32(const FrameInfo& fi,
-                  const std::string& name,
+                  const IRVariableOperand* var,
                   const std::shared_ptr<Register>& fSrc,
                   std::vector<MIPSInstruction>& code) {
-    int off = fi.varOffset.at(name);
+    int off = fi.offsetOf(var);
     code.emplace_back(MIPSOp::S_S, "", std::vector<std::shared_ptr<MIPSOperand>>{ fSrc, std::make_shared<Address>(off, Registers::fp()) });
 }
 
 void emitLoadF32(const FrameInfo& fi,
-                 const std::shared_ptr<IROperand>& op,
+                 const IROperand* op,
                  const std::shared_ptr<Register>& fDst,
                  std::vector<MIPSInstruction>& code) {
-    if (auto v = std::dynamic_pointer_cast<IRVariableOperand>(op)) {
-        int off = fi.varOffset.at(v->getName());
+    if (auto v = op->asVariable()) {
+        int off = fi.offsetOf(v);
         code.emplace_back(MIPSOp::L_S, "", std::vector<std::shared_ptr<MIPSOperand>>{ fDst, std::make_shared<Address>(off, Registers::fp()) });
     }
 }
 
-} // namespace ircpp
+bool canJumpToTailCallee(const FrameInfo& fi, const IRFunction& func, size_t i) {
+    if (!isTailCall(func, i)) return false;
+    const IRInstruction* call = func.instructions[i];
+    const size_t first = call->opCode == IRInstruction::OpCode::CALLR ? 2 : 1;
+    if (call->operands.size() - first > 4) return false;
+    for (size_t a = first; a < call->operands.size(); ++a)
+        if (auto v = call->operands[a]->asVariable(); v && fi.isLocalArray[v->id]) return false;
+    return true;
+}
 
+void emitTailJump(const FrameInfo& fi, const std::string& callee, std::vector<MIPSInstruction>& code) {
+    code.emplace_back(MIPSOp::LW, "", std::vector<std::shared_ptr<MIPSOperand>>{ Registers::ra(), std::make_shared<Address>(0, Registers::fp()) });
+    code.emplace_back(MIPSOp::LW, "", std::vector<std::shared_ptr<MIPSOperand>>{ Registers::fp(), std::make_shared<Address>(4, Registers::fp()) });
+    code.emplace_back(MIPSOp::ADDI, "", std::vector<std::shared_ptr<MIPSOperand>>{ Registers::sp(), Registers::sp(), std::make_shared<Immediate>(fi.frameBytes) });
+    code.emplace_back(MIPSOp::J, "", std::vector<std::shared_ptr<MIPSOperand>>{ std::make_shared<Label>(callee) });
+}
 
+} // namespace ircpp
@@ -2,33 +2,38 @@
 
 namespace ircpp {
 
-FrameInfo buildFrame(const IRFunction& func) {
+FrameInfo buildFrame(const IRFunction& func, uint32_t savedRegs) {
     FrameInfo fi;
+    const size_t n = func.variables.size();
+    fi.varOffset.assign(n, 0);
+    fi.isParamArray.assign(n, false);
+    fi.isLocalArray.assign(n, false);
     // Reserve 8 bytes at frame top: 0($fp)=ra, 4($fp)=fp
     int off = 8;
-    // Mark which variables are array parameters
-    std::unordered_set<std::string> paramNames;
-    for (const auto& p : func.parameters) if (p) paramNames.insert(p->getName());
+    // Parameters take the lowest ids, so ids below this are parameters
+    const uint32_t paramCount = static_cast<uint32_t>(func.parameters.size());
 
-    auto slotSize = [&](const std::shared_ptr<IRVariableOperand>& v){
-        auto arr = std::dynamic_pointer_cast<IRArrayType>(v->type);
+    auto slotSize = [&](const IRVariableOperand* v){
+        auto arr = v->type->asArray();
         if (!arr) return 4; // scalars
-        if (paramNames.count(v->getName())) {
+        if (v->id < paramCount) {
             // Array parameter: store pointer only
-            fi.paramArrayNames.insert(v->getName());
+            fi.isParamArray[v->id] = true;
             return 4;
         }
         // Local array: allocate full space in frame
-        fi.localArrayNames.insert(v->getName());
+        fi.isLocalArray[v->id] = true;
         return arr->size * 4;
     };
 
     for (const auto& v : func.variables) {
         if (!v) continue;
         int sz = slotSize(v);
-        fi.varOffset[v->getName()] = off;
+        fi.varOffset[v->id] = off;
         off += sz;
     }
+    fi.savedOffset = off;
+    off += 4 * int(savedRegs);
     // Align to 8 bytes
     if (off % 8) off += (8 - (off % 8));
     fi.frameBytes = off;
@@ -39,6 +44,11 @@ std::string qualLabel(const std::string& fn, const std::string& lbl) {
     return fn + std::string("_") + lbl;
 }
 
-} // namespace ircpp
-
+std::vector<std::string> qualLabels(const IRFunction& func) {
+    std::vector<std::string> out;
+    out.reserve(func.labels.size());
+    for (auto lbl : func.labels) out.push_back(qualLabel(func.name, std::string(lbl)));
+    return out;
+}
 
+} // namespace ircpp
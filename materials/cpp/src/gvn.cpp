@@ -0,0 +1,240 @@
+#include "pass_manager.hpp"
+
+#include <cstring>
+#include <unordered_map>
+
+#include "ssa.hpp"
+
+namespace ircpp {
+
+namespace {
+
+using Op = IRInstruction::OpCode;
+
+bool isArithmetic(Op op) {
+    return op == Op::ADD || op == Op::SUB || op == Op::MULT || op == Op::DIV || op == Op::AND || op == Op::OR;
+}
+bool isCommutative(Op op) { return op == Op::ADD || op == Op::MULT || op == Op::AND || op == Op::OR; }
+bool isIntrinsic(std::string_view callee) {
+    return callee == "geti" || callee == "getc" || callee == "getf" ||
+           callee == "puti" || callee == "putc" || callee == "putf";
+}
+
+// One computed value: an arithmetic op on two value numbers, or a load of
+// element `b` of array `a` in memory generation `c`.
+struct Key {
+    uint32_t op;
+    uint64_t a, b, c;
+    bool operator==(const Key& o) const { return op == o.op && a == o.a && b == o.b && c == o.c; }
+};
+struct KeyHash {
+    size_t operator()(const Key& k) const {
+        uint64_t h = k.op;
+        for (uint64_t x : {k.a, k.b, k.c}) h = (h ^ x) * 0x9e3779b97f4a7c15ull;
+        return static_cast<size_t>(h ^ (h >> 29));
+    }
+};
+
+// Dominator-based value numbering on SSA form. Walking the dominator tree
+// with a scoped table, an instruction that recomputes a value some
+// dominating instruction already holds is deleted and its reads take that
+// value instead. Phis of one block with the same inputs merge too.
+//
+// Array loads are values as well, keyed by the array and the generation of
+// its memory. Arrays fall into alias classes: each local array is its own,
+// and array parameters share one, since a caller may pass one array twice.
+// A store, a bulk assign, or a call taking an array starts a new generation
+// of that array's class; a store also makes its value the one later loads of
+// that element see. Where paths merge, every class written on some path
+// from the dominator is bumped too.
+//
+// Arithmetic is not reused across a call to a program function either: the
+// value would have to outlive the call in memory, and a store plus a reload
+// cost more than computing it again.
+class GVNPass : public FunctionPass {
+public:
+    const char* name() const override { return "gvn"; }
+
+    uint32_t run(IRFunction& F, FunctionAnalyses&) override {
+        if (F.instructions.empty()) return Analysis::kAll;
+        for (const IRInstruction* ir : F.instructions)
+            if (!ir || ir->opCode == Op::PHI) return Analysis::kAll;
+        constructSSA(F);
+        number(F);
+        destructSSA(F);
+        return Analysis::kNone;
+    }
+
+private:
+    static void number(IRFunction& F) {
+        auto& ins = F.instructions;
+        const ControlFlowGraph cfg = CFGBuilder::buildCFG(F);
+        const uint32_t nblocks = static_cast<uint32_t>(cfg.size());
+        const uint32_t nvars = static_cast<uint32_t>(F.variables.size());
+        constexpr uint32_t kNone = ControlFlowGraph::kNone;
+
+        std::vector<uint32_t> classOf(nvars, kNone);
+        uint32_t nclasses = 1; // class 0: every array parameter
+        for (const IRVariableOperand* p : F.parameters)
+            if (p->isArray()) classOf[p->id] = 0;
+        for (uint32_t v = 0; v < nvars; ++v)
+            if (F.variables[v]->isArray() && classOf[v] == kNone) classOf[v] = nclasses++;
+        // Not memory: written by every call that is not a syscall intrinsic.
+        const uint32_t callClass = nclasses++;
+        auto forEachWrittenClass = [&](const IRInstruction* ir, auto&& f) {
+            if (ir->opCode == Op::ARRAY_STORE) f(classOf[ir->operands[1]->asVariable()->id]);
+            else if (ir->opCode == Op::ASSIGN && ir->operands.size() == 3) f(classOf[ir->operands[0]->asVariable()->id]);
+            else if (ir->opCode == Op::CALL || ir->opCode == Op::CALLR) {
+                for (IROperand* a : ir->operands)
+                    if (auto v = a->asVariable(); v && v->isArray()) f(classOf[v->id]);
+                if (!isIntrinsic(ir->operands[ir->opCode == Op::CALLR ? 1 : 0]->value)) f(callClass);
+            }
+        };
+        std::vector<std::vector<uint32_t>> blockWrites(nblocks);
+        for (uint32_t b = 0; b < nblocks; ++b)
+            for (uint32_t i = cfg.blocks[b].first; i <= cfg.blocks[b].last; ++i)
+                forEachWrittenClass(ins[i], [&](uint32_t c) { blockWrites[b].push_back(c); });
+
+        // Each version's replacement: another variable or an int constant.
+        std::vector<IROperand*> repl(F.variables.begin(), F.variables.end());
+        auto find = [&](IROperand* op) {
+            while (op->isVariable() && repl[op->asVariable()->id] != op) op = repl[op->asVariable()->id];
+            return op;
+        };
+        auto vn = [&](const IROperand* op) -> uint64_t {
+            if (auto v = op->asVariable()) return v->id;
+            auto c = op->asConstant();
+            if (c->type->isInt()) return 1ull << 32 | static_cast<uint32_t>(c->intValue);
+            uint32_t bits;
+            std::memcpy(&bits, &c->floatValue, sizeof bits);
+            return 2ull << 32 | bits;
+        };
+
+        std::unordered_map<Key, IROperand*, KeyHash> table;
+        std::vector<Key> inserted;                            // undo log of table
+        std::vector<uint64_t> gen(nclasses, 0);
+        std::vector<std::pair<uint32_t, uint64_t>> genUndo;   // class, previous generation
+        uint64_t nextGen = 0;
+        auto write = [&](uint32_t c) {
+            genUndo.push_back({c, gen[c]});
+            gen[c] = ++nextGen;
+        };
+        auto writeAll = [&] {
+            for (uint32_t c = 0; c < nclasses; ++c) write(c);
+        };
+        auto loadKey = [&](IROperand* array, IROperand* index) {
+            return Key{uint32_t(Op::ARRAY_LOAD), array->asVariable()->id, vn(index), gen[classOf[array->asVariable()->id]]};
+        };
+
+        // Classes written on some path from idom(b) to b, found walking
+        // backwards from b's predecessors up to the dominator (past a size
+        // limit, every class). A path that comes back through the dominator
+        // first needs nothing more: whatever it wrote was already bumped on
+        // entry to the dominator, and values defined there are recomputed.
+        constexpr size_t kWalkLimit = 1024;
+        std::vector<uint32_t> seenAt(nblocks, kNone), walk;
+        auto mergeWrites = [&](uint32_t b) {
+            const uint32_t d = cfg.idom[b];
+            auto preds = cfg.predecessors(b);
+            if (preds.size() == 1 && *preds.begin() == d) return;
+            walk.clear();
+            for (uint32_t p : preds)
+                if (p != d && cfg.reachable(p) && seenAt[p] != b) { seenAt[p] = b; walk.push_back(p); }
+            std::vector<bool> written(nclasses, false);
+            for (size_t k = 0; k < walk.size(); ++k) {
+                if (walk.size() > kWalkLimit) { writeAll(); return; }
+                for (uint32_t c : blockWrites[walk[k]]) written[c] = true;
+                for (uint32_t p : cfg.predecessors(walk[k]))
+                    if (p != d && cfg.reachable(p) && seenAt[p] != b) { seenAt[p] = b; walk.push_back(p); }
+            }
+            for (uint32_t c = 0; c < nclasses; ++c)
+                if (written[c]) write(c);
+        };
+
+        std::vector<bool> removed(ins.size(), false);
+        std::vector<uint32_t> phis;
+        auto visit = [&](uint32_t b) {
+            if (b != 0) mergeWrites(b);
+            phis.clear();
+            for (uint32_t i = cfg.blocks[b].first; i <= cfg.blocks[b].last; ++i) {
+                IRInstruction* ir = ins[i];
+                ir->forEachScalarUseIndex([&](size_t k) { ir->operands[k] = find(ir->operands[k]); });
+                IROperand* d = ir->scalarDef() ? ir->operands[0] : nullptr;
+                auto reuse = [&](const Key& key) {
+                    auto [it, fresh] = table.emplace(key, d);
+                    if (fresh) { inserted.push_back(key); return; }
+                    repl[d->asVariable()->id] = it->second;
+                    removed[i] = true;
+                };
+                if (ir->opCode == Op::PHI) {
+                    for (uint32_t j : phis) {
+                        const IRInstruction* other = ins[j];
+                        bool same = other->operands.size() == ir->operands.size();
+                        for (size_t k = 1; k < ir->operands.size() && same; k += 2)
+                            same = find(other->operands[k]) == find(ir->operands[k]);
+                        if (!same) continue;
+                        repl[d->asVariable()->id] = other->operands[0];
+                        removed[i] = true;
+                        break;
+                    }
+                    if (!removed[i]) phis.push_back(i);
+                } else if (d && isArithmetic(ir->opCode)) {
+                    uint64_t x = vn(ir->operands[1]), y = vn(ir->operands[2]);
+                    if (isCommutative(ir->opCode) && x > y) std::swap(x, y);
+                    reuse({uint32_t(ir->opCode) | uint32_t(d->asVariable()->type->kind) << 8, x, y, gen[callClass]});
+                } else if (d && ir->opCode == Op::ARRAY_LOAD) {
+                    reuse(loadKey(ir->operands[1], ir->operands[2]));
+                } else {
+                    forEachWrittenClass(ir, write);
+                    if (ir->opCode != Op::ARRAY_STORE) continue;
+                    // Later loads of this element read the stored value, as
+                    // long as it is something a read can be replaced with.
+                    IROperand* value = ir->operands[0];
+                    auto c = value->asConstant();
+                    if (c && !c->type->isInt()) continue;
+                    const Key key = loadKey(ir->operands[1], ir->operands[2]);
+                    if (table.emplace(key, value).second) inserted.push_back(key);
+                }
+            }
+        };
+
+        // Preorder over the dominator tree; on leaving a block, undo what it
+        // and its subtree added.
+        struct Frame { uint32_t block; size_t child, tableMark, genMark; };
+        std::vector<Frame> stack;
+        auto enter = [&](uint32_t b) {
+            stack.push_back({b, 0, inserted.size(), genUndo.size()});
+            visit(b);
+        };
+        enter(0);
+        while (!stack.empty()) {
+            Frame& f = stack.back();
+            auto children = cfg.domTreeChildren(f.block);
+            if (f.child < children.size()) {
+                enter(children.begin()[f.child++]);
+                continue;
+            }
+            for (; inserted.size() > f.tableMark; inserted.pop_back()) table.erase(inserted.back());
+            for (; genUndo.size() > f.genMark; genUndo.pop_back()) gen[genUndo.back().first] = genUndo.back().second;
+            stack.pop_back();
+        }
+
+        // Phi inputs from back edges were read before their replacements
+        // were known.
+        std::vector<IRInstruction*> out;
+        out.reserve(ins.size());
+        for (uint32_t i = 0; i < ins.size(); ++i) {
+            if (removed[i]) continue;
+            IRInstruction* ir = ins[i];
+            ir->forEachScalarUseIndex([&](size_t k) { ir->operands[k] = find(ir->operands[k]); });
+            out.push_back(ir);
+        }
+        ins = std::move(out);
+    }
+};
+
+} // namespace
+
+std::unique_ptr<FunctionPass> createGVNPass() { return std::make_unique<GVNPass>(); }
+
+} // namespace ircpp
@@ -0,0 +1,205 @@
+#include "inliner.hpp"
+
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "call_graph.hpp"
+#include "frame_builder.hpp"
+#include "loops.hpp"
+
+namespace ircpp {
+
+namespace {
+
+using Op = IRInstruction::OpCode;
+
+uint32_t bodySize(const IRFunction& F) {
+    uint32_t n = 0;
+    for (const IRInstruction* ir : F.instructions) n += ir && ir->opCode != Op::LABEL;
+    return n;
+}
+
+bool inlinable(const IRFunction& callee, const InlineLimits& limits) {
+    if (bodySize(callee) > limits.calleeSize) return false;
+    for (const IRInstruction* ir : callee.instructions)
+        if (!ir || ir->opCode == Op::PHI) return false;
+    std::vector<bool> isParam(callee.variables.size(), false);
+    for (const IRVariableOperand* p : callee.parameters) isParam[p->id] = true;
+    for (const IRVariableOperand* v : callee.variables)
+        if (v->isArray() && !isParam[v->id]) return false;
+    return true;
+}
+
+const IRType* typeOf(const IROperand* op) {
+    if (auto v = op->asVariable()) return v->type;
+    if (auto c = op->asConstant()) return c->type;
+    return nullptr;
+}
+
+// Scalars of one kind, or arrays of one element kind.
+bool sameKind(const IRType* a, const IRType* b) {
+    if (!a || !b || a->kind != b->kind) return false;
+    if (!a->isArray()) return true;
+    return a->asArray()->elementType->kind == b->asArray()->elementType->kind;
+}
+
+bool callFits(const IRInstruction* call, const IRFunction& callee) {
+    const size_t first = call->opCode == Op::CALLR ? 2 : 1;
+    if (call->operands.size() - first != callee.parameters.size()) return false;
+    for (size_t k = 0; k < callee.parameters.size(); ++k) {
+        const IROperand* arg = call->operands[first + k];
+        const IRVariableOperand* p = callee.parameters[k];
+        if (!sameKind(typeOf(arg), p->type) || (p->isArray() && !arg->isVariable())) return false;
+    }
+    if (call->opCode == Op::CALLR)
+        return callee.returnType && sameKind(call->operands[0]->asVariable()->type, callee.returnType.get());
+    return true;
+}
+
+} // namespace
+
+std::string InlineLimits::describe() const {
+    return "inline(" + std::to_string(calleeSize) + "," + std::to_string(callerGrowth) + ")";
+}
+
+uint32_t inlineLeafCalls(IRFunction& F, const std::function<const IRFunction*(std::string_view)>& leaf,
+                         const InlineLimits& limits) {
+    auto& ins = F.instructions;
+    for (const IRInstruction* ir : ins)
+        if (!ir || ir->opCode == Op::PHI) return 0;
+
+    struct Site { uint32_t at; const IRFunction* callee; uint32_t size; uint32_t depth; };
+    std::vector<Site> sites;
+    for (uint32_t i = 0; i < ins.size(); ++i) {
+        const IRInstruction* ir = ins[i];
+        if (ir->opCode != Op::CALL && ir->opCode != Op::CALLR) continue;
+        const IRFunctionOperand* target = ir->operands[ir->opCode == Op::CALLR ? 1 : 0]->asFunction();
+        const IRFunction* callee = target ? leaf(target->value) : nullptr;
+        if (!callee || callee == &F || !inlinable(*callee, limits) || !callFits(ir, *callee)) continue;
+        sites.push_back({i, callee, bodySize(*callee), 0});
+    }
+    if (sites.empty()) return 0;
+
+    // The cost model: a call costs its frame setup and teardown each time it
+    // runs, so the sites that run most often (by loop nesting) win, and
+    // among those the cheapest copies.
+    const ControlFlowGraph cfg = CFGBuilder::buildCFG(F);
+    const LoopInfo loops = LoopInfo::compute(F, cfg);
+    sites.erase(std::remove_if(sites.begin(), sites.end(), [&](const Site& s) { return !cfg.reachable(cfg.blockOf(s.at)); }),
+                sites.end());
+    for (Site& s : sites) {
+        const uint32_t l = loops.blockLoop[cfg.blockOf(s.at)];
+        s.depth = l == LoopInfo::kNone ? 0 : loops.loops[l].depth;
+    }
+    std::stable_sort(sites.begin(), sites.end(), [](const Site& a, const Site& b) {
+        return a.depth != b.depth ? a.depth > b.depth : a.size < b.size;
+    });
+    std::vector<const IRFunction*> chosen(ins.size(), nullptr);
+    uint32_t budget = limits.callerGrowth, count = 0;
+    for (const Site& s : sites) {
+        // The copy replaces the call and adds a copy per scalar parameter.
+        const uint32_t cost = s.size + static_cast<uint32_t>(s.callee->parameters.size());
+        if (cost > budget) continue;
+        budget -= cost;
+        chosen[s.at] = s.callee;
+        ++count;
+    }
+    if (count == 0) return 0;
+
+    std::unordered_set<std::string> varNames;
+    for (const IRVariableOperand* v : F.variables) varNames.insert(std::string(v->value));
+    auto fresh = [](std::unordered_set<std::string>& taken, const std::string& base) {
+        std::string name = base;
+        for (uint32_t n = 1; !taken.insert(name).second; ++n) name = base + "_" + std::to_string(n);
+        return name;
+    };
+
+    std::vector<IRInstruction*> out;
+    out.reserve(ins.size() + limits.callerGrowth - budget + 2 * count);
+    for (uint32_t i = 0; i < ins.size(); ++i) {
+        IRInstruction* call = ins[i];
+        const IRFunction* callee = chosen[i];
+        if (!callee) { out.push_back(call); continue; }
+        const IRFunction& C = *callee;
+        const int line = call->irLineNumber;
+
+        std::vector<IROperand*> vars(C.variables.size(), nullptr);
+        std::vector<IRLabelOperand*> labels(C.labels.size(), nullptr);
+        auto var = [&](const IRVariableOperand* v) {
+            if (!vars[v->id]) {
+                auto text = F.arena.copyString(fresh(varNames, qualLabel(C.name, std::string(v->value))));
+                auto nv = F.arena.make<IRVariableOperand>(v->type, text, static_cast<uint32_t>(F.variables.size()));
+                F.variables.push_back(nv);
+                vars[v->id] = nv;
+            }
+            return vars[v->id];
+        };
+        auto map = [&](const IROperand* op) -> IROperand* {
+            switch (op->kind) {
+                case IROperand::Kind::Variable: return var(op->asVariable());
+                case IROperand::Kind::Label: {
+                    const IRLabelOperand* l = op->asLabel();
+                    if (!labels[l->id]) labels[l->id] = F.addLabel(qualLabel(C.name, std::string(l->value)));
+                    return labels[l->id];
+                }
+                case IROperand::Kind::Constant: {
+                    auto c = F.arena.make<IRConstantOperand>(*op->asConstant());
+                    c->value = F.arena.copyString(c->value);
+                    return c;
+                }
+                case IROperand::Kind::Function:
+                    return F.arena.make<IRFunctionOperand>(F.arena.copyString(op->value));
+            }
+            return nullptr;
+        };
+
+        const size_t first = call->opCode == Op::CALLR ? 2 : 1;
+        for (size_t k = 0; k < C.parameters.size(); ++k) {
+            const IRVariableOperand* p = C.parameters[k];
+            if (p->isArray()) vars[p->id] = call->operands[first + k];
+            else out.push_back(F.makeInstruction(Op::ASSIGN, line, {var(p), call->operands[first + k]}));
+        }
+        IRLabelOperand* end = nullptr;
+        for (size_t j = 0; j < C.instructions.size(); ++j) {
+            const IRInstruction* ir = C.instructions[j];
+            if (ir->opCode != Op::RETURN) {
+                auto copy = F.arena.make<IRInstruction>(ir->opCode, line);
+                for (const IROperand* op : ir->operands) copy->operands.push_back(F.arena, map(op));
+                out.push_back(copy);
+                continue;
+            }
+            if (first == 2) out.push_back(F.makeInstruction(Op::ASSIGN, line, {call->operands[0], map(ir->operands[0])}));
+            if (j + 1 < C.instructions.size()) {
+                if (!end) end = F.addLabel(qualLabel(C.name, "end"));
+                out.push_back(F.makeInstruction(Op::GOTO, line, {end}));
+            }
+        }
+        if (end) out.push_back(F.makeInstruction(Op::LABEL, line, {end}));
+    }
+    ins = std::move(out);
+    return count;
+}
+
+uint32_t inlineLeafCalls(IRProgram& program, const InlineLimits& limits) {
+    std::vector<IRFunction*> fns;
+    for (const auto& fn : program.functions)
+        if (fn) fns.push_back(fn.get());
+    const CallGraph graph = CallGraph::build(program);
+    std::unordered_map<std::string_view, const IRFunction*> leaves;
+    for (uint32_t f = 0; f < fns.size(); ++f)
+        if (graph.callees[f].empty()) leaves.emplace(fns[f]->name, fns[f]);
+    auto leaf = [&](std::string_view name) {
+        auto it = leaves.find(name);
+        return it == leaves.end() ? nullptr : it->second;
+    };
+    // Leaves contain no call to inline, so they stay as they were parsed
+    // while their callers change.
+    uint32_t count = 0;
+    for (uint32_t f = 0; f < fns.size(); ++f)
+        if (!graph.callees[f].empty()) count += inlineLeafCalls(*fns[f], leaf, limits);
+    return count;
+}
+
+} // namespace ircpp
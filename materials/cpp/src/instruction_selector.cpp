@@ -171,7 +171,7 @@ namespace {
 }
 
 std::vector<MIPSInstruction>
-IRToMIPSSelector::selectProgram(const IRProgram& program) {
+IRToMIPSSelector::selectEntry() {
     std::vector<MIPSInstruction> out;
     // Program entry: call main and then exit (syscall 10)
     out.emplace_back(MIPSOp::JAL, "", std::vector<std::shared_ptr<MIPSOperand>>{
@@ -181,43 +181,57 @@ IRToMIPSSelector::selectProgram(const IRProgram& program) {
         Registers::v0(), std::make_shared<Immediate>(10)
     });
     out.emplace_back(MIPSOp::SYSCALL, "", std::vector<std::shared_ptr<MIPSOperand>>{});
+    return out;
+}
 
-    for (const auto& fn : program.functions) {
-        if (!fn) continue;
-        const IRFunction& F = *fn;
-
-        if (getAllocMode() == AllocMode::Naive) {
-            auto part = emitFunctionNaive(F);
-            out.insert(out.end(), part.begin(), part.end());
-        } else {
-            auto part = emitFunctionGreedy(F);
-            out.insert(out.end(), part.begin(), part.end());
-        }
+std::vector<MIPSInstruction>
+IRToMIPSSelector::selectProgram(const IRProgram& program, const CallGraph* calls) {
+    std::vector<const IRFunction*> functions;
+    for (const auto& fn : program.functions)
+        if (fn) functions.push_back(fn.get());
+    std::optional<CallGraph> built;
+    const CallGraph& graph = calls ? *calls : built.emplace(CallGraph::build(program));
+    if (graph.names.size() != functions.size()) throw IRException("Call graph does not match the program");
+
+    // Bottom-up, one component at a time. Calls inside a component were
+    // selected without a summary; the component's summary is then the union
+    // of what its members write and what they call outside it.
+    ClobberSummaries summaries;
+    std::vector<std::vector<MIPSInstruction>> parts(functions.size());
+    for (const auto& component : graph.components) {
+        for (uint32_t f : component) parts[f] = selectFunction(*functions[f], &summaries);
+        for (uint32_t f : component) summaries.set(graph.names[f], 0);
+        uint32_t mask = 0;
+        for (uint32_t f : component) mask |= clobberedRegisters(parts[f], summaries);
+        for (uint32_t f : component) summaries.set(graph.names[f], mask);
     }
+
+    std::vector<MIPSInstruction> out = selectEntry();
+    for (auto& part : parts) out.insert(out.end(), part.begin(), part.end());
     return out;
 }
 
-// Legacy selector methods unused by the simple emitter.
 std::vector<MIPSInstruction>
-IRToMIPSSelector::selectFunction(const IRFunction& function) {
-    (void)function;
-    return {};
+IRToMIPSSelector::selectFunction(const IRFunction& function, const ClobberSummaries* callees) {
+    const ControlFlowGraph cfg = CFGBuilder::buildCFG(function);
+    if (getAllocMode() == AllocMode::Naive) return emitFunctionNaive(function, cfg);
+    return emitFunctionGreedy(function, cfg, callees);
 }
 
 std::shared_ptr<Register>
-InstructionSelector::getRegisterForOperand(std::shared_ptr<IROperand> irOp,
+InstructionSelector::getRegisterForOperand(const IROperand* irOp,
                                            SelectionContext& ctx) {
     if (!irOp) {
         // Fallback: give a scratch virtual
         return ctx.regManager.getVirtualRegister();
     }
 
-    if (auto v = std::dynamic_pointer_cast<IRVariableOperand>(irOp)) {
+    if (auto v = irOp->asVariable()) {
         // Map IR variable name -> (possibly physical) register
         return ctx.regManager.getRegister(v->getName());
     }
 
-    if (std::dynamic_pointer_cast<IRConstantOperand>(irOp)) {
+    if (irOp->asConstant()) {
         // For immediates we return a temp register; the *selector* should emit LI/ADDI
         // (handleImmediate returns a virtual scratch by policy)
         return ctx.regManager.handleImmediate(/*value_unused_here*/0);
@@ -234,9 +248,13 @@ IRToMIPSSelector::selectInstruction(const IRInstruction& /*instruction*/, Select
 
 std::string
 IRToMIPSSelector::generateAssembly(const std::vector<MIPSInstruction>& instructions) {
-    std::ostringstream oss;
     // Ensure the text section is declared so the interpreter sets PC correctly
-    oss << ".text\n";
+    return ".text\n" + generateText(instructions);
+}
+
+std::string
+IRToMIPSSelector::generateText(const std::vector<MIPSInstruction>& instructions) {
+    std::ostringstream oss;
     for (const auto& ins : instructions) {
         oss << ins.toString();
     }
@@ -0,0 +1,366 @@
+#include "ir.hpp"
+
+#include <cstring>
+
+using namespace ircpp;
+
+// Binary IR layout. Fixed-width integers are little-endian; `var` is an
+// unsigned LEB128 varint.
+//
+//   file     := "IRCPPBIN" u32 version u32 functionCount u64 offset[functionCount] function*
+//   function := var stringCount (var len, bytes)*      -- per-function string table
+//               var name type returnType
+//               var paramCount var varCount (type var name)*   -- ids in order, params first
+//               var labelCount (var name)*                     -- ids in order
+//               var instCount instruction*
+//   type     := u8 tag [u8 elementTag var size if tag == Array]
+//   instruction := u8 opcode var lineDelta var operandCount operand*
+//   operand  := var (payload << 3 | kind) [constant]
+//   constant := var zigzag(intValue) for int constants, u32 IEEE bits for float constants
+//
+// lineDelta is the zigzag-encoded difference from the previous instruction's
+// irLineNumber. An operand payload is a string index for constants and
+// callees and an id for variables and labels. Constants carry their decoded
+// value, so reading them back never parses digits.
+//
+// Every function record is self-contained, so offsets let a reader decode
+// any function on its own. Names are referenced by index; the reader copies
+// each string into the function's arena once.
+
+namespace {
+
+constexpr char kMagic[8] = {'I', 'R', 'C', 'P', 'P', 'B', 'I', 'N'};
+constexpr uint32_t kVersion = 2;
+
+enum TypeTag : uint8_t { TypeVoid = 0, TypeInt = 1, TypeFloat = 2, TypeArray = 3 };
+enum OperandKind : uint8_t { OpIntConst = 0, OpFloatConst = 1, OpVariable = 2, OpLabel = 3, OpFunction = 4 };
+
+constexpr uint8_t kOpCodeCount = static_cast<uint8_t>(IRInstruction::OpCode::LABEL) + 1;
+
+void putU8(std::string& out, uint8_t v) { out.push_back(static_cast<char>(v)); }
+void putU32(std::string& out, uint32_t v) {
+    for (int i = 0; i < 4; ++i) out.push_back(static_cast<char>((v >> (8 * i)) & 0xff));
+}
+void putVar(std::string& out, uint32_t v) {
+    while (v >= 0x80) { out.push_back(static_cast<char>((v & 0x7f) | 0x80)); v >>= 7; }
+    out.push_back(static_cast<char>(v));
+}
+uint32_t zigzag(int32_t v) { return (static_cast<uint32_t>(v) << 1) ^ static_cast<uint32_t>(v >> 31); }
+int32_t unzigzag(uint32_t v) { return static_cast<int32_t>(v >> 1) ^ -static_cast<int32_t>(v & 1); }
+
+void putU64(std::string& out, uint64_t v) {
+    for (int i = 0; i < 8; ++i) out.push_back(static_cast<char>((v >> (8 * i)) & 0xff));
+}
+
+uint8_t scalarTag(const IRType* t) {
+    if (t->isInt()) return TypeInt;
+    if (t->isFloat()) return TypeFloat;
+    throw IRException("Unsupported type in binary IR");
+}
+
+void putType(std::string& out, const IRType* t) {
+    if (!t) { putU8(out, TypeVoid); return; }
+    if (auto arr = t->asArray()) {
+        putU8(out, TypeArray);
+        putU8(out, scalarTag(arr->elementType.get()));
+        putVar(out, static_cast<uint32_t>(arr->size));
+        return;
+    }
+    putU8(out, scalarTag(t));
+}
+
+std::string encodeFunction(const IRFunction& fn) {
+    std::vector<std::string_view> strings;
+    std::unordered_map<std::string_view, uint32_t> stringIndex;
+    auto intern = [&](std::string_view s) -> uint32_t {
+        auto it = stringIndex.find(s);
+        if (it != stringIndex.end()) return it->second;
+        uint32_t idx = static_cast<uint32_t>(strings.size());
+        strings.push_back(s);
+        stringIndex.emplace(s, idx);
+        return idx;
+    };
+
+    std::string body;
+    putVar(body, intern(fn.name));
+    putType(body, fn.returnType.get());
+    putVar(body, static_cast<uint32_t>(fn.parameters.size()));
+    putVar(body, static_cast<uint32_t>(fn.variables.size()));
+    for (const auto* v : fn.variables) {
+        putType(body, v->type);
+        putVar(body, intern(v->value));
+    }
+    putVar(body, static_cast<uint32_t>(fn.labels.size()));
+    for (auto lbl : fn.labels) putVar(body, intern(lbl));
+    putVar(body, static_cast<uint32_t>(fn.instructions.size()));
+    int prevLine = 0;
+    for (const auto* inst : fn.instructions) {
+        putU8(body, static_cast<uint8_t>(inst->opCode));
+        putVar(body, zigzag(inst->irLineNumber - prevLine));
+        prevLine = inst->irLineNumber;
+        putVar(body, static_cast<uint32_t>(inst->operands.size()));
+        for (const IROperand* op : inst->operands) {
+            uint32_t kind, payload;
+            if (auto c = op->asConstant()) {
+                kind = c->type->isFloat() ? OpFloatConst : OpIntConst;
+                payload = intern(c->value);
+            } else if (auto v = op->asVariable()) {
+                kind = OpVariable;
+                payload = v->id;
+            } else if (auto l = op->asLabel()) {
+                kind = OpLabel;
+                payload = l->id;
+            } else {
+                kind = OpFunction;
+                payload = intern(op->value);
+            }
+            if (payload >= (1u << 29)) throw IRException("Operand index too large for binary IR");
+            putVar(body, payload << 3 | kind);
+            if (kind == OpIntConst) {
+                putVar(body, zigzag(op->asConstant()->intValue));
+            } else if (kind == OpFloatConst) {
+                uint32_t bits;
+                float f = op->asConstant()->floatValue;
+                std::memcpy(&bits, &f, sizeof bits);
+                putU32(body, bits);
+            }
+        }
+    }
+
+    std::string out;
+    putVar(out, static_cast<uint32_t>(strings.size()));
+    for (auto s : strings) {
+        putVar(out, static_cast<uint32_t>(s.size()));
+        out.append(s.data(), s.size());
+    }
+    out += body;
+    return out;
+}
+
+// Bounds-checked little-endian reader over one mapped buffer.
+class Cursor {
+public:
+    Cursor(std::string_view data, size_t pos) : data_(data), pos_(pos) {
+        if (pos > data.size()) corrupt();
+    }
+    uint8_t u8() { need(1); return static_cast<uint8_t>(data_[pos_++]); }
+    uint32_t u32() {
+        need(4);
+        uint32_t v = 0;
+        for (int i = 0; i < 4; ++i) v |= uint32_t(static_cast<uint8_t>(data_[pos_ + i])) << (8 * i);
+        pos_ += 4;
+        return v;
+    }
+    uint32_t var() {
+        uint32_t v = 0;
+        for (int shift = 0; shift < 35; shift += 7) {
+            uint8_t b = u8();
+            v |= uint32_t(b & 0x7f) << shift;
+            if (!(b & 0x80)) return v;
+        }
+        corrupt();
+    }
+    uint64_t u64() {
+        need(8);
+        uint64_t v = 0;
+        for (int i = 0; i < 8; ++i) v |= uint64_t(static_cast<uint8_t>(data_[pos_ + i])) << (8 * i);
+        pos_ += 8;
+        return v;
+    }
+    // Every counted entry takes at least one byte, so a count larger than the
+    // remaining input is corrupt; checking it up front keeps reserve() sane.
+    uint32_t count() { uint32_t n = var(); need(n); return n; }
+    // The same check for a fixed-width count of fixed-size entries, like the
+    // header's table of function offsets.
+    uint32_t u32Count(size_t entrySize) { uint32_t n = u32(); need(size_t(n) * entrySize); return n; }
+    std::string_view bytes(size_t n) { need(n); auto s = data_.substr(pos_, n); pos_ += n; return s; }
+
+    [[noreturn]] static void corrupt() { throw IRException("Corrupt binary IR"); }
+
+private:
+    void need(size_t n) const { if (data_.size() - pos_ < n) corrupt(); }
+    std::string_view data_;
+    size_t pos_;
+};
+
+std::shared_ptr<IRType> scalarType(uint8_t tag) {
+    if (tag == TypeInt) return IRIntType::get();
+    if (tag == TypeFloat) return IRFloatType::get();
+    Cursor::corrupt();
+}
+
+std::shared_ptr<IRType> getType(Cursor& in) {
+    uint8_t tag = in.u8();
+    if (tag == TypeVoid) return nullptr;
+    if (tag != TypeArray) return scalarType(tag);
+    auto elem = scalarType(in.u8());
+    uint32_t size = in.var();
+    if (size == 0 || size > 0x7fffffff) Cursor::corrupt();
+    return IRArrayType::get(elem, static_cast<int>(size));
+}
+
+// Operand shapes the parser guarantees for text IR and the backends rely on:
+// 'L' label, 'F' callee, 'V' variable, 'v' constant or variable. A trailing
+// '*' allows any number of further 'v' operands. Their types are checked
+// afterwards by IRReader::checkOperandTypes, as for text.
+const char* operandShape(IRInstruction::OpCode op, size_t count) {
+    switch (op) {
+        case IRInstruction::OpCode::LABEL:
+        case IRInstruction::OpCode::GOTO: return "L";
+        case IRInstruction::OpCode::BREQ:
+        case IRInstruction::OpCode::BRNEQ:
+        case IRInstruction::OpCode::BRLT:
+        case IRInstruction::OpCode::BRGT:
+        case IRInstruction::OpCode::BRGEQ: return "Lvv";
+        case IRInstruction::OpCode::ASSIGN: return count == 3 ? "Vvv" : "Vv";
+        case IRInstruction::OpCode::RETURN: return "v";
+        case IRInstruction::OpCode::CALL: return "F*";
+        case IRInstruction::OpCode::CALLR: return "VF*";
+        case IRInstruction::OpCode::ARRAY_STORE: return "vVv";
+        case IRInstruction::OpCode::ARRAY_LOAD: return "VVv";
+        default: return "Vvv"; // binary arithmetic
+    }
+}
+
+bool kindFits(char want, uint32_t kind) {
+    switch (want) {
+        case 'L': return kind == OpLabel;
+        case 'F': return kind == OpFunction;
+        case 'V': return kind == OpVariable;
+        default: return kind == OpIntConst || kind == OpFloatConst || kind == OpVariable;
+    }
+}
+
+std::shared_ptr<IRFunction> decodeFunction(Cursor& in) {
+    uint32_t stringCount = in.count();
+    std::vector<std::string_view> raw;
+    raw.reserve(stringCount);
+    for (uint32_t i = 0; i < stringCount; ++i) raw.push_back(in.bytes(in.var()));
+    auto str = [&](uint32_t idx) -> std::string_view {
+        if (idx >= raw.size()) Cursor::corrupt();
+        return raw[idx];
+    };
+
+    std::string_view name = str(in.var());
+    auto retType = getType(in);
+    auto fn = std::make_shared<IRFunction>(std::string(name), retType);
+    IRArena& arena = fn->arena;
+
+    // Each string is copied into the arena at most once.
+    std::vector<std::string_view> interned(raw.size());
+    auto internStr = [&](uint32_t idx) -> std::string_view {
+        str(idx);
+        if (interned[idx].data() == nullptr && !raw[idx].empty()) interned[idx] = arena.copyString(raw[idx]);
+        return interned[idx];
+    };
+
+    uint32_t paramCount = in.var();
+    uint32_t varCount = in.count();
+    if (paramCount > varCount) Cursor::corrupt();
+    fn->variables.reserve(varCount);
+    for (uint32_t id = 0; id < varCount; ++id) {
+        auto type = getType(in);
+        if (!type) Cursor::corrupt();
+        auto v = arena.make<IRVariableOperand>(type.get(), internStr(in.var()), id);
+        fn->variables.push_back(v);
+        if (id < paramCount) fn->parameters.push_back(v);
+    }
+    uint32_t labelCount = in.count();
+    fn->labels.reserve(labelCount);
+    for (uint32_t id = 0; id < labelCount; ++id) fn->labels.push_back(internStr(in.var()));
+
+    const IRType* intT = IRIntType::get().get();
+    const IRType* floatT = IRFloatType::get().get();
+    uint32_t instCount = in.count();
+    fn->instructions.reserve(instCount);
+    int line = 0;
+    for (uint32_t k = 0; k < instCount; ++k) {
+        uint8_t opByte = in.u8();
+        if (opByte >= kOpCodeCount) Cursor::corrupt();
+        auto op = static_cast<IRInstruction::OpCode>(opByte);
+        line += unzigzag(in.var());
+        auto inst = arena.make<IRInstruction>(op, line);
+        uint32_t operandCount = in.var();
+        const char* shape = operandShape(op, operandCount);
+        size_t fixed = std::strlen(shape);
+        bool variadic = fixed && shape[fixed - 1] == '*';
+        if (variadic) --fixed;
+        if (operandCount < fixed || (!variadic && operandCount != fixed)) Cursor::corrupt();
+        for (uint32_t j = 0; j < operandCount; ++j) {
+            uint32_t word = in.var();
+            uint32_t kind = word & 7, payload = word >> 3;
+            if (!kindFits(j < fixed ? shape[j] : 'v', kind)) Cursor::corrupt();
+            IROperand* operand = nullptr;
+            switch (kind) {
+                case OpIntConst: {
+                    std::string_view text = internStr(payload);
+                    operand = arena.make<IRConstantOperand>(intT, text, unzigzag(in.var()));
+                    break;
+                }
+                case OpFloatConst: {
+                    std::string_view text = internStr(payload);
+                    uint32_t bits = in.u32();
+                    float f;
+                    std::memcpy(&f, &bits, sizeof f);
+                    operand = arena.make<IRConstantOperand>(floatT, text, f);
+                    break;
+                }
+                case OpVariable:
+                    if (payload >= varCount) Cursor::corrupt();
+                    operand = fn->variables[payload];
+                    break;
+                case OpLabel:
+                    if (payload >= labelCount) Cursor::corrupt();
+                    operand = arena.make<IRLabelOperand>(fn->labels[payload], payload);
+                    break;
+                case OpFunction: operand = arena.make<IRFunctionOperand>(internStr(payload)); break;
+                default: Cursor::corrupt();
+            }
+            inst->operands.push_back(arena, operand);
+        }
+        IRReader::checkOperandTypes(*inst);
+        fn->instructions.push_back(inst);
+    }
+    return fn;
+}
+
+} // namespace
+
+void IRBinaryWriter::writeProgram(const IRProgram& program) const {
+    std::vector<std::string> records;
+    records.reserve(program.functions.size());
+    for (const auto& fn : program.functions) records.push_back(encodeFunction(*fn));
+
+    std::string header(kMagic, sizeof(kMagic));
+    putU32(header, kVersion);
+    putU32(header, static_cast<uint32_t>(records.size()));
+    uint64_t offset = header.size() + 8 * records.size();
+    for (const auto& r : records) {
+        putU64(header, offset);
+        offset += r.size();
+    }
+    os.write(header.data(), static_cast<std::streamsize>(header.size()));
+    for (const auto& r : records) os.write(r.data(), static_cast<std::streamsize>(r.size()));
+}
+
+bool IRReader::isBinaryIR(std::string_view data) {
+    return data.size() >= sizeof(kMagic) && std::memcmp(data.data(), kMagic, sizeof(kMagic)) == 0;
+}
+
+IRProgram IRReader::parseIRBinary(std::string_view data) const {
+    if (!isBinaryIR(data)) throw IRException("Not a binary IR file");
+    Cursor header(data, sizeof(kMagic));
+    uint32_t version = header.u32();
+    if (version != kVersion) throw IRException("Unsupported binary IR version " + std::to_string(version));
+    uint32_t count = header.u32Count(8);
+
+    IRProgram p;
+    p.functions.reserve(count);
+    for (uint32_t i = 0; i < count; ++i) {
+        uint64_t offset = header.u64();
+        if (offset > data.size()) Cursor::corrupt();
+        Cursor body(data, static_cast<size_t>(offset));
+        p.functions.push_back(decodeFunction(body));
+    }
+    return p;
+}
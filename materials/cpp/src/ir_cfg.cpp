@@ -0,0 +1,241 @@
+#include "ir.hpp"
+#include "loops.hpp"
+
+#include <algorithm>
+#include <sstream>
+
+using namespace ircpp;
+
+namespace {
+
+bool endsBlock(const IRInstruction& ir) {
+    return ir.isJump() || ir.opCode == IRInstruction::OpCode::RETURN;
+}
+
+// Turn per-block edge lists gathered as (from, to) pairs into a flat array
+// indexed by [begin, end) ranges on each block, keeping the pairs' order.
+void fillRanges(std::vector<BasicBlock>& blocks, const std::vector<std::pair<uint32_t, uint32_t>>& edges,
+                std::vector<uint32_t>& flat, uint32_t BasicBlock::*begin, uint32_t BasicBlock::*end) {
+    std::vector<uint32_t> count(blocks.size() + 1, 0);
+    for (const auto& e : edges) ++count[e.first + 1];
+    for (size_t b = 0; b < blocks.size(); ++b) count[b + 1] += count[b];
+    flat.assign(edges.size(), 0);
+    for (size_t b = 0; b < blocks.size(); ++b) { blocks[b].*begin = count[b]; blocks[b].*end = count[b]; }
+    for (const auto& e : edges) flat[(blocks[e.first].*end)++] = e.second;
+}
+
+} // namespace
+
+uint32_t ControlFlowGraph::blockOf(uint32_t i) const {
+    auto it = std::upper_bound(blocks.begin(), blocks.end(), i,
+                               [](uint32_t idx, const BasicBlock& bb) { return idx < bb.first; });
+    return static_cast<uint32_t>(it - blocks.begin()) - 1;
+}
+
+ControlFlowGraph CFGBuilder::buildCFG(const IRFunction& function) {
+    ControlFlowGraph cfg;
+    cfg.function = &function;
+    identifyBasicBlocks(cfg);
+    buildEdges(cfg);
+    computeOrder(cfg);
+    computeDominators(cfg);
+    return cfg;
+}
+
+void CFGBuilder::identifyBasicBlocks(ControlFlowGraph& cfg) {
+    const auto& ins = cfg.function->instructions;
+    const uint32_t n = static_cast<uint32_t>(ins.size());
+    cfg.labelBlock.assign(cfg.function->labels.size(), ControlFlowGraph::kNone);
+    uint32_t start = 0;
+    for (uint32_t i = 0; i < n; ++i) {
+        const IRInstruction* ir = ins[i];
+        if (!ir) continue;
+        if (ir->opCode == IRInstruction::OpCode::LABEL) {
+            if (i > start) cfg.blocks.push_back({start, i - 1});
+            start = i;
+            cfg.labelBlock[ir->operands[0]->asLabel()->id] = static_cast<uint32_t>(cfg.blocks.size());
+        }
+        if (endsBlock(*ir)) {
+            cfg.blocks.push_back({start, i});
+            start = i + 1;
+        }
+    }
+    if (start < n) cfg.blocks.push_back({start, n - 1});
+}
+
+void CFGBuilder::buildEdges(ControlFlowGraph& cfg) {
+    const auto& ins = cfg.function->instructions;
+    const uint32_t nblocks = static_cast<uint32_t>(cfg.blocks.size());
+    std::vector<std::pair<uint32_t, uint32_t>> edges;
+    edges.reserve(nblocks * 2);
+    for (uint32_t b = 0; b < nblocks; ++b) {
+        const IRInstruction* term = ins[cfg.blocks[b].last];
+        const uint32_t next = b + 1 < nblocks ? b + 1 : ControlFlowGraph::kNone;
+        uint32_t target = ControlFlowGraph::kNone;
+        bool fallsThrough = true;
+        if (term && endsBlock(*term)) {
+            if (term->opCode == IRInstruction::OpCode::RETURN) fallsThrough = false;
+            else {
+                // A jump to a label that is never placed has no successor.
+                target = cfg.labelBlock[term->operands[0]->asLabel()->id];
+                fallsThrough = term->opCode != IRInstruction::OpCode::GOTO;
+            }
+        }
+        if (target != ControlFlowGraph::kNone) edges.push_back({b, target});
+        if (fallsThrough && next != ControlFlowGraph::kNone && next != target) edges.push_back({b, next});
+    }
+    fillRanges(cfg.blocks, edges, cfg.succs, &BasicBlock::succBegin, &BasicBlock::succEnd);
+    // Reversed, the edges are still in source order, so predecessor lists
+    // come out in block order.
+    for (auto& e : edges) std::swap(e.first, e.second);
+    fillRanges(cfg.blocks, edges, cfg.preds, &BasicBlock::predBegin, &BasicBlock::predEnd);
+}
+
+void CFGBuilder::computeOrder(ControlFlowGraph& cfg) {
+    const uint32_t n = static_cast<uint32_t>(cfg.blocks.size());
+    cfg.rpoIndex.assign(n, ControlFlowGraph::kNone);
+    cfg.rpo.clear();
+    if (n == 0) return;
+    // Iterative DFS; each stack entry remembers how many successors it has
+    // already pushed.
+    std::vector<uint32_t> post;
+    post.reserve(n);
+    std::vector<bool> seen(n, false);
+    std::vector<std::pair<uint32_t, uint32_t>> stack;
+    stack.push_back({0, 0});
+    seen[0] = true;
+    while (!stack.empty()) {
+        auto& top = stack.back();
+        auto succ = cfg.successors(top.first);
+        if (top.second < succ.size()) {
+            uint32_t s = succ.begin()[top.second++];
+            if (!seen[s]) { seen[s] = true; stack.push_back({s, 0}); }
+        } else {
+            post.push_back(top.first);
+            stack.pop_back();
+        }
+    }
+    cfg.rpo.assign(post.rbegin(), post.rend());
+    for (uint32_t i = 0; i < cfg.rpo.size(); ++i) cfg.rpoIndex[cfg.rpo[i]] = i;
+}
+
+void CFGBuilder::computeDominators(ControlFlowGraph& cfg) {
+    // Cooper, Harvey and Kennedy, "A Simple, Fast Dominance Algorithm":
+    // iterate idom over reverse postorder, intersecting by walking up the
+    // partial tree with rpo numbers as the finger order.
+    const uint32_t n = static_cast<uint32_t>(cfg.blocks.size());
+    const uint32_t NONE = ControlFlowGraph::kNone;
+    cfg.idom.assign(n, NONE);
+    cfg.domChildBegin.assign(n + 1, 0);
+    cfg.domChildren.clear();
+    cfg.domPre.assign(n, NONE);
+    cfg.domPost.assign(n, NONE);
+    if (cfg.rpo.empty()) return;
+
+    const uint32_t entry = cfg.rpo[0];
+    cfg.idom[entry] = entry;
+    auto intersect = [&](uint32_t a, uint32_t b) {
+        while (a != b) {
+            while (cfg.rpoIndex[a] > cfg.rpoIndex[b]) a = cfg.idom[a];
+            while (cfg.rpoIndex[b] > cfg.rpoIndex[a]) b = cfg.idom[b];
+        }
+        return a;
+    };
+    for (bool changed = true; changed; ) {
+        changed = false;
+        for (size_t k = 1; k < cfg.rpo.size(); ++k) {
+            const uint32_t b = cfg.rpo[k];
+            uint32_t newIdom = NONE;
+            for (uint32_t p : cfg.predecessors(b)) {
+                if (cfg.idom[p] == NONE) continue; // unprocessed or unreachable
+                newIdom = newIdom == NONE ? p : intersect(p, newIdom);
+            }
+            if (cfg.idom[b] != newIdom) { cfg.idom[b] = newIdom; changed = true; }
+        }
+    }
+
+    // Children in block order, then pre/post numbers from an iterative walk.
+    for (uint32_t b = 0; b < n; ++b)
+        if (cfg.idom[b] != NONE && b != entry) ++cfg.domChildBegin[cfg.idom[b] + 1];
+    for (uint32_t b = 0; b < n; ++b) cfg.domChildBegin[b + 1] += cfg.domChildBegin[b];
+    cfg.domChildren.assign(cfg.domChildBegin[n], 0);
+    std::vector<uint32_t> fill(cfg.domChildBegin.begin(), cfg.domChildBegin.end() - 1);
+    for (uint32_t b = 0; b < n; ++b)
+        if (cfg.idom[b] != NONE && b != entry) cfg.domChildren[fill[cfg.idom[b]]++] = b;
+
+    uint32_t pre = 0, postNo = 0;
+    std::vector<std::pair<uint32_t, uint32_t>> stack{{entry, 0}};
+    cfg.domPre[entry] = pre++;
+    while (!stack.empty()) {
+        auto& top = stack.back();
+        auto kids = cfg.domTreeChildren(top.first);
+        if (top.second < kids.size()) {
+            uint32_t c = kids.begin()[top.second++];
+            cfg.domPre[c] = pre++;
+            stack.push_back({c, 0});
+        } else {
+            cfg.domPost[top.first] = postNo++;
+            stack.pop_back();
+        }
+    }
+}
+
+void CFGBuilder::printCFG(const ControlFlowGraph& cfg, std::ostream& os) {
+    os << "cfg " << (cfg.function ? cfg.function->name : std::string()) << '\n';
+    for (uint32_t b = 0; b < cfg.size(); ++b) {
+        const BasicBlock& bb = cfg.blocks[b];
+        os << "  B" << b << " [" << bb.first << ", " << bb.last << "]";
+        if (!cfg.reachable(b)) os << " unreachable";
+        else {
+            os << " rpo " << cfg.rpoIndex[b];
+            if (cfg.idom[b] != b) os << " idom B" << cfg.idom[b];
+        }
+        os << " ->";
+        for (uint32_t s : cfg.successors(b)) os << " B" << s;
+        os << " <-";
+        for (uint32_t p : cfg.predecessors(b)) os << " B" << p;
+        os << '\n';
+    }
+}
+
+void CFGBuilder::printCFGDot(const ControlFlowGraph& cfg, std::ostream& os, const LoopInfo* loops) {
+    auto escape = [](const std::string& s) {
+        std::string r;
+        for (char c : s) {
+            if (c == '"' || c == '\\' || c == '{' || c == '}' || c == '<' || c == '>' || c == '|') r.push_back('\\');
+            if (c == '\n') { r += "\\l"; continue; }
+            r.push_back(c);
+        }
+        return r;
+    };
+    const std::string name = cfg.function ? cfg.function->name : std::string("cfg");
+    os << "digraph \"" << escape(name) << "\" {\n";
+    os << "  node [shape=record, fontname=\"monospace\"];\n";
+    for (uint32_t b = 0; b < cfg.size(); ++b) {
+        std::ostringstream body;
+        IRPrinter printer(body);
+        for (uint32_t i = cfg.blocks[b].first; i <= cfg.blocks[b].last; ++i)
+            if (cfg.function->instructions[i]) printer.printInstruction(*cfg.function->instructions[i]);
+        std::ostringstream title;
+        title << 'B' << b;
+        if (loops && loops->depth(b)) {
+            title << " depth " << loops->depth(b);
+            if (loops->isHeader(b)) {
+                const Loop& L = loops->loops[loops->blockLoop[b]];
+                if (L.tripCount != Loop::kNone) title << ", " << L.tripCount << " trips";
+                for (const auto& iv : L.inductionVariables)
+                    title << ", " << iv.var->value << (iv.step < 0 ? "" : "+") << iv.step;
+            }
+        }
+        os << "  B" << b << " [label=\"{" << escape(title.str()) << "|" << escape(body.str()) << "}\"";
+        if (!cfg.reachable(b)) os << ", style=dashed";
+        os << "];\n";
+    }
+    for (uint32_t b = 0; b < cfg.size(); ++b)
+        for (uint32_t s : cfg.successors(b)) {
+            os << "  B" << b << " -> B" << s;
+            if (loops && loops->isHeader(s) && loops->loops[loops->blockLoop[s]].contains(b)) os << " [style=bold]";
+            os << ";\n";
+        }
+    os << "}\n";
+}
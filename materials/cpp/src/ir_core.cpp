@@ -1,7 +1,70 @@
 #include "ir.hpp"
 
+#include <algorithm>
+#include <cstring>
+
 using namespace ircpp;
 
+void* IRArena::allocate(size_t bytes, size_t align) {
+    auto p = reinterpret_cast<std::uintptr_t>(cur_);
+    std::uintptr_t aligned = (p + align - 1) & ~(std::uintptr_t)(align - 1);
+    if (!cur_ || aligned + bytes > reinterpret_cast<std::uintptr_t>(end_)) {
+        // Oversized requests get a block of their own.
+        size_t size = std::max(nextBlockSize_, bytes + align);
+        nextBlockSize_ = std::min(nextBlockSize_ * 2, kMaxBlockSize);
+        blocks_.push_back({std::unique_ptr<char[]>(new char[size]), size});
+        cur_ = blocks_.back().data.get();
+        end_ = cur_ + size;
+        p = reinterpret_cast<std::uintptr_t>(cur_);
+        aligned = (p + align - 1) & ~(std::uintptr_t)(align - 1);
+    }
+    cur_ = reinterpret_cast<char*>(aligned + bytes);
+    bytesUsed_ += bytes;
+    return reinterpret_cast<void*>(aligned);
+}
+
+std::string_view IRArena::copyString(std::string_view s) {
+    if (s.empty()) return std::string_view();
+    char* dst = static_cast<char*>(allocate(s.size(), 1));
+    std::memcpy(dst, s.data(), s.size());
+    return std::string_view(dst, s.size());
+}
+
+void IRArena::reset() {
+    if (blocks_.size() > 1) blocks_.erase(blocks_.begin() + 1, blocks_.end());
+    cur_ = blocks_.empty() ? nullptr : blocks_.front().data.get();
+    end_ = blocks_.empty() ? nullptr : cur_ + blocks_.front().size;
+    nextBlockSize_ = blocks_.empty() ? firstBlockSize_ : std::min(blocks_.front().size * 2, kMaxBlockSize);
+    bytesUsed_ = 0;
+}
+
+void IROperandList::push_back(IRArena& arena, IROperand* op) {
+    if (count_ == capacity_) {
+        uint32_t cap = capacity_ * 2;
+        auto** grown = static_cast<IROperand**>(arena.allocate(cap * sizeof(IROperand*), alignof(IROperand*)));
+        std::memcpy(grown, data(), count_ * sizeof(IROperand*));
+        heap_ = grown;
+        capacity_ = cap;
+    }
+    data()[count_++] = op;
+}
+
+IRLabelOperand* IRFunction::addLabel(std::string_view base) {
+    for (; labelNamesSeen_ < labels.size(); ++labelNamesSeen_) labelNames_.insert(labels[labelNamesSeen_]);
+    std::string name(base);
+    for (uint32_t n = 1; labelNames_.count(name); ++n) name = std::string(base) + "_" + std::to_string(n);
+    auto text = arena.copyString(name);
+    auto lbl = arena.make<IRLabelOperand>(text, static_cast<uint32_t>(labels.size()));
+    labels.push_back(text);
+    return lbl;
+}
+
+IRInstruction* IRFunction::makeInstruction(IRInstruction::OpCode op, int line, std::initializer_list<IROperand*> ops) {
+    auto ir = arena.make<IRInstruction>(op, line);
+    for (auto o : ops) ir->operands.push_back(arena, o);
+    return ir;
+}
+
 static const char* opToString(IRInstruction::OpCode op) {
     switch (op) {
         case IRInstruction::OpCode::ASSIGN: return "assign";
@@ -23,6 +86,7 @@ static const char* opToString(IRInstruction::OpCode op) {
         case IRInstruction::OpCode::ARRAY_STORE: return "array_store";
         case IRInstruction::OpCode::ARRAY_LOAD: return "array_load";
         case IRInstruction::OpCode::LABEL: return "label";
+        case IRInstruction::OpCode::PHI: return "phi";
     }
     return "";
 }
@@ -34,20 +98,19 @@ void IRPrinter::printProgram(const IRProgram& program) const {
     }
 }
 
-static std::string typeToString(const std::shared_ptr<IRType>& t) {
+static std::string typeToString(const IRType* t) {
     if (!t) return "void";
-    if (t.get() == IRIntType::get().get()) return "int";
-    if (t.get() == IRFloatType::get().get()) return "float";
-    auto arr = std::dynamic_pointer_cast<IRArrayType>(t);
-    if (arr) {
-        return typeToString(arr->elementType) + "[" + std::to_string(arr->size) + "]";
+    if (t->isInt()) return "int";
+    if (t->isFloat()) return "float";
+    if (auto arr = t->asArray()) {
+        return typeToString(arr->elementType.get()) + "[" + std::to_string(arr->size) + "]";
     }
     return "";
 }
 
 void IRPrinter::printFunction(const IRFunction& function) const {
     os << "#start_function\n";
-    os << (function.returnType ? typeToString(function.returnType) : std::string("void"));
+    os << (function.returnType ? typeToString(function.returnType.get()) : std::string("void"));
     os << ' ' << function.name << '(';
     bool first = true;
     for (const auto& p : function.parameters) {
@@ -60,14 +123,15 @@ void IRPrinter::printFunction(const IRFunction& function) const {
     // variable lists
     std::vector<std::string> intList;
     std::vector<std::string> floatList;
-    for (const auto& v : function.variables) {
-        auto arr = std::dynamic_pointer_cast<IRArrayType>(v->type);
-        if (arr) {
+    // Parameters are declared by the signature, not the variable lists.
+    for (size_t id = function.parameters.size(); id < function.variables.size(); ++id) {
+        const IRVariableOperand* v = function.variables[id];
+        if (auto arr = v->type->asArray()) {
             std::string entry = v->getName() + "[" + std::to_string(arr->size) + "]";
-            if (arr->elementType.get() == IRIntType::get().get()) intList.push_back(entry);
+            if (arr->elementType->isInt()) intList.push_back(entry);
             else floatList.push_back(entry);
         } else {
-            if (v->type.get() == IRIntType::get().get()) intList.push_back(v->getName());
+            if (v->type->isInt()) intList.push_back(v->getName());
             else floatList.push_back(v->getName());
         }
     }
@@ -1,321 +1,588 @@
 #include "ir.hpp"
 
+#include <algorithm>
+#include <atomic>
+#include <exception>
 #include <fstream>
-#include <sstream>
-#include <regex>
+#include <iterator>
+#include <thread>
+#include <string_view>
 #include <cctype>
+#include <charconv>
+#include <cmath>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define IRCPP_HAVE_MMAP 1
+#endif
 
 using namespace ircpp;
 
-static bool isConstantToken(const std::string& s) {
-    static const std::regex kNum(R"(^-?\d+(?:\.\d*)?$)");
-    return std::regex_match(s, kNum);
+namespace {
+
+// Hand-written lexer helpers. Everything here works on std::string_view slices of
+// the current line, so scanning a token never allocates.
+
+inline char upper(char c) { return (c >= 'a' && c <= 'z') ? char(c - 'a' + 'A') : c; }
+inline bool isDigit(char c) { return c >= '0' && c <= '9'; }
+inline bool isSpace(char c) { return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\v' || c == '\f'; }
+inline bool isIdentStart(char c) { return (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || c == '_'; }
+inline bool isIdentChar(char c) { return isIdentStart(c) || isDigit(c); }
+
+std::string_view trim(std::string_view s) {
+    size_t b = 0, e = s.size();
+    while (b < e && isSpace(s[b])) ++b;
+    while (e > b && isSpace(s[e - 1])) --e;
+    return s.substr(b, e - b);
+}
+
+// [A-Za-z_][A-Za-z0-9_]*
+bool isIdentifier(std::string_view s) {
+    if (s.empty() || !isIdentStart(s[0])) return false;
+    for (size_t i = 1; i < s.size(); ++i) if (!isIdentChar(s[i])) return false;
+    return true;
 }
 
+// -?\d+(\.\d*)?
+bool isConstantToken(std::string_view s) {
+    size_t i = 0;
+    if (i < s.size() && s[i] == '-') ++i;
+    size_t digits = i;
+    while (i < s.size() && isDigit(s[i])) ++i;
+    if (i == digits) return false;
+    if (i < s.size() && s[i] == '.') {
+        ++i;
+        while (i < s.size() && isDigit(s[i])) ++i;
+    }
+    return i == s.size();
+}
+
+// Parse a run of decimal digits as a positive array size. Returns -1 on
+// empty input, non-digits or overflow.
+int parseSize(std::string_view s) {
+    if (s.empty()) return -1;
+    long long v = 0;
+    for (char c : s) {
+        if (!isDigit(c)) return -1;
+        v = v * 10 + (c - '0');
+        if (v > 0x7fffffff) return -1;
+    }
+    return static_cast<int>(v);
+}
+
+// Split `line` on whitespace and any character in `delims`, appending views to
+// `out`. `out` is reused across lines so its capacity amortizes to zero allocations.
+void splitTokens(std::string_view line, std::string_view delims, std::vector<std::string_view>& out) {
+    out.clear();
+    size_t i = 0, n = line.size();
+    auto isDelim = [&](char c) { return isSpace(c) || delims.find(c) != std::string_view::npos; };
+    while (i < n) {
+        while (i < n && isDelim(line[i])) ++i;
+        size_t b = i;
+        while (i < n && !isDelim(line[i])) ++i;
+        if (i > b) out.push_back(line.substr(b, i - b));
+    }
+}
+
+// Perfect hash over the 18 IR mnemonics (case-insensitive). The hash mixes the
+// length with the 2nd, 3rd and last characters; the table stores the canonical
+// spelling so a hit is confirmed with a single compare.
+struct OpEntry { std::string_view name; IRInstruction::OpCode op; };
+constexpr size_t kOpTableSize = 24;
+const OpEntry kOpTable[kOpTableSize] = {
+    {"BRLT", IRInstruction::OpCode::BRLT},
+    {"ASSIGN", IRInstruction::OpCode::ASSIGN},
+    {"BREQ", IRInstruction::OpCode::BREQ},
+    {"", IRInstruction::OpCode::LABEL},
+    {"", IRInstruction::OpCode::LABEL},
+    {"DIV", IRInstruction::OpCode::DIV},
+    {"MULT", IRInstruction::OpCode::MULT},
+    {"BRGT", IRInstruction::OpCode::BRGT},
+    {"", IRInstruction::OpCode::LABEL},
+    {"CALLR", IRInstruction::OpCode::CALLR},
+    {"ARRAY_STORE", IRInstruction::OpCode::ARRAY_STORE},
+    {"", IRInstruction::OpCode::LABEL},
+    {"BRNEQ", IRInstruction::OpCode::BRNEQ},
+    {"SUB", IRInstruction::OpCode::SUB},
+    {"CALL", IRInstruction::OpCode::CALL},
+    {"ADD", IRInstruction::OpCode::ADD},
+    {"OR", IRInstruction::OpCode::OR},
+    {"BRGEQ", IRInstruction::OpCode::BRGEQ},
+    {"RETURN", IRInstruction::OpCode::RETURN},
+    {"AND", IRInstruction::OpCode::AND},
+    {"ARRAY_LOAD", IRInstruction::OpCode::ARRAY_LOAD},
+    {"GOTO", IRInstruction::OpCode::GOTO},
+    {"", IRInstruction::OpCode::LABEL},
+    {"", IRInstruction::OpCode::LABEL},
+};
+
+// Decode a token accepted by isConstantToken. Ints must fit in int32 and
+// floats must be finite, otherwise the constant is rejected.
+int32_t decodeInt(std::string_view s) {
+    int32_t v = 0;
+    auto r = std::from_chars(s.data(), s.data() + s.size(), v);
+    if (r.ec != std::errc() || r.ptr != s.data() + s.size()) throw IRException("Integer constant out of range");
+    return v;
+}
+
+float decodeFloat(std::string_view s) {
+    float v = 0.0f;
+    auto r = std::from_chars(s.data(), s.data() + s.size(), v);
+    if (r.ec != std::errc() || r.ptr != s.data() + s.size() || !std::isfinite(v)) throw IRException("Float constant out of range");
+    return v;
+}
+
+IRInstruction::OpCode lookupOpCode(std::string_view s) {
+    if (s.size() < 2) throw IRException("Invalid OpCode");
+    auto at = [&](size_t i) -> unsigned { return i < s.size() ? (unsigned char)upper(s[i]) : 0u; };
+    size_t h = (s.size() * 13 + at(1) * 10 + at(2) * 13 + at(s.size() - 1)) % kOpTableSize;
+    const OpEntry& e = kOpTable[h];
+    if (e.name.size() != s.size()) throw IRException("Invalid OpCode");
+    for (size_t i = 0; i < s.size(); ++i) if (upper(s[i]) != e.name[i]) throw IRException("Invalid OpCode");
+    return e.op;
+}
+
+// Read-only view of a whole file. Uses mmap where available and falls back to
+// reading into an owned buffer elsewhere.
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& filename) {
+#ifdef IRCPP_HAVE_MMAP
+        int fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd < 0) throw IRException("File not found: " + filename);
+        struct stat st;
+        if (::fstat(fd, &st) != 0) { ::close(fd); throw IRException("File not found: " + filename); }
+        size_ = static_cast<size_t>(st.st_size);
+        if (size_ > 0) {
+            void* p = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p == MAP_FAILED) { ::close(fd); throw IRException("Failed to map file: " + filename); }
+            ::madvise(p, size_, MADV_SEQUENTIAL);
+            data_ = static_cast<const char*>(p);
+        }
+        ::close(fd);
+#else
+        std::ifstream in(filename, std::ios::in | std::ios::binary);
+        if (!in) throw IRException("File not found: " + filename);
+        owned_.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        data_ = owned_.data();
+        size_ = owned_.size();
+#endif
+    }
+    ~MappedFile() {
+#ifdef IRCPP_HAVE_MMAP
+        if (data_) ::munmap(const_cast<char*>(data_), size_);
+#endif
+    }
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    std::string_view view() const { return std::string_view(data_, size_); }
+
+private:
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+#ifndef IRCPP_HAVE_MMAP
+    std::string owned_;
+#endif
+};
+
+} // namespace
+
 IRProgram IRReader::parseIRFile(const std::string& filename) const {
-    std::ifstream in(filename);
+    std::ifstream in(filename, std::ios::in | std::ios::binary);
     if (!in) throw IRException("File not found: " + filename);
+    std::string text((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    return isBinaryIR(text) ? parseIRBinary(text) : parseIRString(text);
+}
+
+IRProgram IRReader::parseIRFileMapped(const std::string& filename) const {
+    MappedFile file(filename);
+    return isBinaryIR(file.view()) ? parseIRBinary(file.view()) : parseIRString(file.view());
+}
+
+bool IRReader::splitFunctions(std::string_view text, std::vector<std::string_view>& blocks) {
+    // Same line and marker rules as the prescan in parseIRString.
+    blocks.clear();
+    const size_t npos = std::string_view::npos;
+    size_t blockBegin = npos;
+    size_t pos = 0;
+    while (pos < text.size()) {
+        size_t nl = text.find('\n', pos);
+        size_t end = (nl == npos) ? text.size() : nl;
+        std::string_view s = trim(text.substr(pos, end - pos));
+        if (s.substr(0, 15) == "#start_function") {
+            if (blockBegin != npos) return false;
+            blockBegin = pos;
+        } else if (s.substr(0, 13) == "#end_function") {
+            if (blockBegin == npos) return false;
+            blocks.push_back(text.substr(blockBegin, end - blockBegin));
+            blockBegin = npos;
+        } else if (!s.empty() && blockBegin == npos) {
+            return false;
+        }
+        pos = end + 1;
+    }
+    return blockBegin == npos;
+}
+
+bool IRReader::scanCalls(std::string_view block, std::string_view& name, std::vector<std::string_view>& callees) {
+    // Same line rules as parseFunction: blank lines do not count, the
+    // signature follows #start_function, and two variable lists precede the
+    // body, which ends at the next # line.
+    callees.clear();
+    std::vector<std::string_view> tok;
+    size_t lineIndex = 0, pos = 0;
+    while (pos < block.size()) {
+        size_t nl = block.find('\n', pos);
+        size_t end = (nl == std::string_view::npos) ? block.size() : nl;
+        std::string_view s = trim(block.substr(pos, end - pos));
+        pos = end + 1;
+        if (s.empty()) continue;
+        const size_t k = lineIndex++;
+        if (k == 1) {
+            splitTokens(s, "(),:", tok);
+            if (tok.size() < 2) return false;
+            name = tok[1];
+            continue;
+        }
+        if (k < 4) continue;
+        if (s[0] == '#') break;
+        if (s.back() == ':') continue;
+        splitTokens(s, ",", tok);
+        if (tok.empty()) continue;
+        auto is = [&](std::string_view op) {
+            if (tok[0].size() != op.size()) return false;
+            for (size_t i = 0; i < op.size(); ++i) if (upper(tok[0][i]) != op[i]) return false;
+            return true;
+        };
+        if (is("CALL")) {
+            if (tok.size() < 2) return false;
+            callees.push_back(tok[1]);
+        } else if (is("CALLR")) {
+            if (tok.size() < 3) return false;
+            callees.push_back(tok[2]);
+        }
+    }
+    return lineIndex >= 4;
+}
+
+void IRReader::checkOperandTypes(const IRInstruction& inst) {
+    using Op = IRInstruction::OpCode;
+    static const IRType* const intT = IRIntType::get().get();
+    auto type = [&](size_t k) -> const IRType* {
+        const IROperand* x = inst.operands[k];
+        if (auto c = x->asConstant()) return c->type;
+        if (auto v = x->asVariable()) return v->type;
+        return nullptr;
+    };
+    auto isArray = [](const IRType* t) { return t && t->isArray(); };
+    auto elementOf = [](const IRType* t) -> const IRType* {
+        auto arr = t ? t->asArray() : nullptr;
+        return arr ? arr->elementType.get() : nullptr;
+    };
 
-    struct IRLine { int lineNumber; std::string line; };
+    bool ok = true;
+    switch (inst.opCode) {
+        case Op::ASSIGN:
+            if (inst.operands.size() > 2) ok = isArray(type(0)) && type(1) == intT && elementOf(type(0)) == type(2);
+            else ok = !isArray(type(0)) && type(0) == type(1);
+            break;
+        case Op::ADD: case Op::SUB: case Op::MULT: case Op::DIV: case Op::AND: case Op::OR:
+            ok = inst.operands[0]->isVariable() && !isArray(type(0)) && type(0) == type(1) && type(1) == type(2);
+            break;
+        case Op::BREQ: case Op::BRNEQ: case Op::BRLT: case Op::BRGT: case Op::BRGEQ:
+            ok = !isArray(type(1)) && type(1) == type(2);
+            break;
+        case Op::RETURN:
+            ok = !isArray(type(0));
+            break;
+        case Op::CALLR:
+            ok = inst.operands[0]->isVariable() && !isArray(type(0));
+            break;
+        case Op::ARRAY_STORE:
+            ok = !isArray(type(0)) && isArray(type(1)) && type(2) == intT && elementOf(type(1)) == type(0);
+            break;
+        case Op::ARRAY_LOAD:
+            ok = inst.operands[0]->isVariable() && !isArray(type(0)) && isArray(type(1)) && type(2) == intT &&
+                 elementOf(type(1)) == type(0);
+            break;
+        default:
+            break;
+    }
+    if (!ok) throw IRException("Invalid operand");
+}
+
+IRProgram IRReader::parseIRString(std::string_view text) const {
+    // Lines are views into `text`; nothing is copied until names are interned
+    // into operands.
+    struct IRLine { int lineNumber; std::string_view line; };
     std::vector<IRLine> irLines;
+    irLines.reserve(text.size() / 16);
 
-    std::string raw;
     int lineNo = 0;
-    while (std::getline(in, raw)) {
+    size_t pos = 0;
+    while (pos < text.size()) {
+        size_t nl = text.find('\n', pos);
+        size_t end = (nl == std::string_view::npos) ? text.size() : nl;
         ++lineNo;
-        std::string s;
-        s.reserve(raw.size());
-        size_t b = raw.find_first_not_of(" \t\r\n");
-        if (b == std::string::npos) continue;
-        size_t e = raw.find_last_not_of(" \t\r\n");
-        s = raw.substr(b, e - b + 1);
+        std::string_view s = trim(text.substr(pos, end - pos));
         if (!s.empty()) irLines.push_back({lineNo, s});
+        pos = end + 1;
     }
 
-    auto toUpper = [](std::string x){ for (auto& c : x) c = (char)toupper(c); return x; };
-
-    auto parseType = [&](const std::string& typeStr, int /*ln*/) -> std::shared_ptr<IRType> {
-        static const std::regex pat(R"(^(?:(void)|(?:(int|float)(?:\[(\d+)\])?))$)");
-        std::smatch m;
-        if (!std::regex_match(typeStr, m, pat)) throw IRException("Invalid type");
-        if (m[1].matched) return nullptr;
+    auto parseType = [&](std::string_view typeStr, int /*ln*/) -> std::shared_ptr<IRType> {
+        // void | (int|float)([N])?
+        if (typeStr == "void") return nullptr;
         std::shared_ptr<IRType> elem;
-        if (m[2].str() == "int") elem = IRIntType::get();
-        else if (m[2].str() == "float") elem = IRFloatType::get();
+        std::string_view rest;
+        if (typeStr.substr(0, 3) == "int") { elem = IRIntType::get(); rest = typeStr.substr(3); }
+        else if (typeStr.substr(0, 5) == "float") { elem = IRFloatType::get(); rest = typeStr.substr(5); }
         else throw IRException("Invalid type");
-        if (!m[3].matched) return elem;
-        int size = std::stoi(m[3].str());
+        if (rest.empty()) return elem;
+        if (rest.size() < 3 || rest.front() != '[' || rest.back() != ']') throw IRException("Invalid type");
+        std::string_view digits = rest.substr(1, rest.size() - 2);
+        for (char c : digits) if (!isDigit(c)) throw IRException("Invalid type");
+        int size = parseSize(digits);
         if (size <= 0) throw IRException("Invalid array size");
         return IRArrayType::get(elem, size);
     };
 
-    auto getDataType = [&](const std::shared_ptr<IROperand>& x) -> std::shared_ptr<IRType> {
-        if (auto c = std::dynamic_pointer_cast<IRConstantOperand>(x)) return c->type;
-        if (auto v = std::dynamic_pointer_cast<IRVariableOperand>(x)) return v->type;
-        return nullptr;
-    };
+    const IRType* const intT = IRIntType::get().get();
+    const IRType* const floatT = IRFloatType::get().get();
+    auto isArray = [](const IRType* t) { return t && t->isArray(); };
 
-    auto parseFunction = [&](const std::vector<IRLine>& lines) -> std::shared_ptr<IRFunction> {
-        std::unordered_map<std::string, std::shared_ptr<IRVariableOperand>> variableMap;
+    // Parses irLines[first, last] (inclusive of the #start/#end markers).
+    auto parseFunction = [&](size_t first, size_t last) -> std::shared_ptr<IRFunction> {
+        auto lineAt = [&](size_t k) -> const IRLine& {
+            if (first + k > last) throw IRException("Truncated function");
+            return irLines[first + k];
+        };
+        const size_t lineCount = last - first + 1;
+        // Keys view the arena copy of each name, so lookups never allocate.
+        std::unordered_map<std::string_view, IRVariableOperand*> variableMap;
+        std::unordered_map<std::string_view, uint32_t> labelIds;
+        std::vector<std::string_view> tok;
+        tok.reserve(16);
         size_t idx = 1;
-        const auto& sig = lines.at(idx++);
-        std::string sigLine = sig.line;
-        for (char& c : sigLine) if (c == '(' || c == ')' || c == ',' || c == ':') c = ' ';
-        std::stringstream ss(sigLine);
-        std::vector<std::string> tok; std::string t;
-        while (ss >> t) tok.push_back(t);
+        const auto& sig = lineAt(idx++);
+        splitTokens(sig.line, "(),:", tok);
         if (tok.size() < 2 || (tok.size() % 2) != 0) throw IRException("Invalid function signature");
 
         auto retType = parseType(tok[0], sig.lineNumber);
-        if (std::dynamic_pointer_cast<IRArrayType>(retType)) throw IRException("Invalid type");
-        std::string fnName = tok[1];
+        if (isArray(retType.get())) throw IRException("Invalid type");
+        auto fn = std::make_shared<IRFunction>(std::string(tok[1]), retType);
+        IRArena& arena = fn->arena;
 
-        std::vector<std::shared_ptr<IRVariableOperand>> params;
         for (size_t i = 2; i < tok.size(); i += 2) {
             auto pType = parseType(tok[i], sig.lineNumber);
             if (!pType) throw IRException("Invalid type");
-            const std::string& pName = tok[i + 1];
-            if (!std::regex_match(pName, std::regex(R"(^[A-Za-z_][A-Za-z0-9_]*$)")))
-                throw IRException("Invalid parameter name");
+            std::string_view pName = tok[i + 1];
+            if (!isIdentifier(pName)) throw IRException("Invalid parameter name");
             if (variableMap.count(pName)) throw IRException("Redefinition of variable");
-            auto p = std::make_shared<IRVariableOperand>(pType, pName, nullptr);
-            variableMap[pName] = p;
-            params.push_back(p);
+            auto p = arena.make<IRVariableOperand>(pType.get(), arena.copyString(pName), static_cast<uint32_t>(fn->variables.size()));
+            variableMap[p->value] = p;
+            fn->parameters.push_back(p);
+            fn->variables.push_back(p);
         }
 
-        const auto& intListLine = lines.at(idx++);
-        const auto& floatListLine = lines.at(idx++);
+        const auto& intListLine = lineAt(idx++);
+        const auto& floatListLine = lineAt(idx++);
         auto parseVarList = [&](const IRLine& vline, std::shared_ptr<IRType> elementType) {
-            auto colon = vline.line.find(':');
-            std::string rest = (colon == std::string::npos) ? std::string() : vline.line.substr(colon + 1);
-            size_t b = rest.find_first_not_of(" \t");
-            if (b == std::string::npos) return;
-            rest = rest.substr(b);
-            std::stringstream ssv(rest);
-            std::string name;
-            while (std::getline(ssv, name, ',')) {
-                size_t bb = name.find_first_not_of(" \t");
-                size_t ee = name.find_last_not_of(" \t");
-                if (bb == std::string::npos) continue;
-                name = name.substr(bb, ee - bb + 1);
-                std::smatch m;
-                static const std::regex arrPat(R"(^(.+)\[(\d+)\]$)");
-                if (std::regex_match(name, m, arrPat)) {
-                    int size = std::stoi(m[2].str());
-                    if (size <= 0) throw IRException("Invalid array size");
-                    std::string base = m[1].str();
-                    if (!std::regex_match(base, std::regex(R"(^[A-Za-z_][A-Za-z0-9_]*$)")))
-                        throw IRException("Invalid variable name");
-                    auto tarr = IRArrayType::get(elementType, size);
-                    if (variableMap.count(base)) throw IRException("Redefinition of variable");
-                    variableMap[base] = std::make_shared<IRVariableOperand>(tarr, base, nullptr);
-                } else {
-                    if (!std::regex_match(name, std::regex(R"(^[A-Za-z_][A-Za-z0-9_]*$)")))
-                        throw IRException("Invalid variable name");
-                    if (variableMap.count(name)) throw IRException("Redefinition of variable");
-                    variableMap[name] = std::make_shared<IRVariableOperand>(elementType, name, nullptr);
+            std::string_view line = vline.line;
+            auto colon = line.find(':');
+            std::string_view rest = (colon == std::string_view::npos) ? std::string_view() : line.substr(colon + 1);
+            while (!rest.empty()) {
+                size_t comma = rest.find(',');
+                std::string_view name = trim(rest.substr(0, comma));
+                rest = (comma == std::string_view::npos) ? std::string_view() : rest.substr(comma + 1);
+                if (name.empty()) continue;
+                std::string_view base = name;
+                const IRType* type = elementType.get();
+                // name[N]
+                size_t lb = name.rfind('[');
+                if (name.back() == ']' && lb != std::string_view::npos && lb > 0 && lb + 2 < name.size()) {
+                    std::string_view digits = name.substr(lb + 1, name.size() - lb - 2);
+                    int size = parseSize(digits);
+                    if (size >= 0) {
+                        if (size == 0) throw IRException("Invalid array size");
+                        base = name.substr(0, lb);
+                        type = IRArrayType::get(elementType, size).get();
+                    }
                 }
+                if (!isIdentifier(base)) throw IRException("Invalid variable name");
+                if (variableMap.count(base)) throw IRException("Redefinition of variable");
+                auto v = arena.make<IRVariableOperand>(type, arena.copyString(base), static_cast<uint32_t>(fn->variables.size()));
+                variableMap[v->value] = v;
+                fn->variables.push_back(v);
             }
         };
 
         parseVarList(intListLine, IRIntType::get());
         parseVarList(floatListLine, IRFloatType::get());
 
-        std::vector<std::shared_ptr<IRInstruction>> insts;
-        auto makeConstOrVar = [&](IRInstruction* parent, const std::string& tok) -> std::shared_ptr<IROperand> {
+        // Variables resolve to their single declared operand; constants, labels
+        // and callee names get a fresh arena operand per use (label text is
+        // interned once per name).
+        auto makeConstOrVar = [&](std::string_view tok) -> IROperand* {
             if (isConstantToken(tok)) {
-                if (tok.find('.') != std::string::npos) return std::make_shared<IRConstantOperand>(IRFloatType::get(), tok, parent);
-                return std::make_shared<IRConstantOperand>(IRIntType::get(), tok, parent);
+                if (tok.find('.') != std::string_view::npos)
+                    return arena.make<IRConstantOperand>(floatT, arena.copyString(tok), decodeFloat(tok));
+                return arena.make<IRConstantOperand>(intT, arena.copyString(tok), decodeInt(tok));
             }
             auto it = variableMap.find(tok);
             if (it == variableMap.end()) throw IRException("Variable used without definition");
-            return std::make_shared<IRVariableOperand>(it->second->type, it->second->getName(), parent);
+            return it->second;
+        };
+        auto makeLabel = [&](std::string_view name) -> IROperand* {
+            auto it = labelIds.find(name);
+            if (it == labelIds.end()) {
+                std::string_view interned = arena.copyString(name);
+                it = labelIds.emplace(interned, static_cast<uint32_t>(fn->labels.size())).first;
+                fn->labels.push_back(interned);
+            }
+            return arena.make<IRLabelOperand>(it->first, it->second);
+        };
+        auto makeCallee = [&](std::string_view name) -> IROperand* {
+            return arena.make<IRFunctionOperand>(arena.copyString(name));
         };
 
-        while (idx < lines.size()) {
-            const auto& l = lines.at(idx++);
+        std::vector<std::string_view> tokens;
+        tokens.reserve(16);
+        fn->instructions.reserve(lineCount);
+        while (idx < lineCount) {
+            const auto& l = lineAt(idx++);
             if (!l.line.empty() && l.line[0] == '#') break;
 
-            auto inst = std::make_shared<IRInstruction>();
-            inst->irLineNumber = l.lineNumber;
-
             if (!l.line.empty() && l.line.back() == ':') {
-                std::string label = l.line.substr(0, l.line.size() - 1);
-                inst->opCode = IRInstruction::OpCode::LABEL;
-                inst->operands.push_back(std::make_shared<IRLabelOperand>(label, inst.get()));
-                insts.push_back(inst);
+                auto inst = arena.make<IRInstruction>(IRInstruction::OpCode::LABEL, l.lineNumber);
+                inst->operands.push_back(arena, makeLabel(l.line.substr(0, l.line.size() - 1)));
+                fn->instructions.push_back(inst);
                 continue;
             }
 
-            std::vector<std::string> tokens;
-            {
-                std::string tmp = l.line;
-                for (char& c : tmp) if (c == ',') c = ' ';
-                std::stringstream sst(tmp);
-                std::string x;
-                while (sst >> x) tokens.push_back(x);
-            }
+            splitTokens(l.line, ",", tokens);
             if (tokens.empty()) continue;
-            std::string opUpper = toUpper(tokens[0]);
-            auto parseOp = [&](const std::string& s)->IRInstruction::OpCode{
-                if (s=="ASSIGN") return IRInstruction::OpCode::ASSIGN;
-                if (s=="ADD") return IRInstruction::OpCode::ADD;
-                if (s=="SUB") return IRInstruction::OpCode::SUB;
-                if (s=="MULT") return IRInstruction::OpCode::MULT;
-                if (s=="DIV") return IRInstruction::OpCode::DIV;
-                if (s=="AND") return IRInstruction::OpCode::AND;
-                if (s=="OR") return IRInstruction::OpCode::OR;
-                if (s=="GOTO") return IRInstruction::OpCode::GOTO;
-                if (s=="BREQ") return IRInstruction::OpCode::BREQ;
-                if (s=="BRNEQ") return IRInstruction::OpCode::BRNEQ;
-                if (s=="BRLT") return IRInstruction::OpCode::BRLT;
-                if (s=="BRGT") return IRInstruction::OpCode::BRGT;
-                if (s=="BRGEQ") return IRInstruction::OpCode::BRGEQ;
-                if (s=="RETURN") return IRInstruction::OpCode::RETURN;
-                if (s=="CALL") return IRInstruction::OpCode::CALL;
-                if (s=="CALLR") return IRInstruction::OpCode::CALLR;
-                if (s=="ARRAY_STORE") return IRInstruction::OpCode::ARRAY_STORE;
-                if (s=="ARRAY_LOAD") return IRInstruction::OpCode::ARRAY_LOAD;
-                throw IRException("Invalid OpCode");
-            };
-            inst->opCode = parseOp(opUpper);
-
-            auto getType = [&](const std::shared_ptr<IROperand>& x){ return getDataType(x); };
+            auto inst = arena.make<IRInstruction>(lookupOpCode(tokens[0]), l.lineNumber);
+            auto& ops = inst->operands;
+            // Every opcode reads a fixed prefix of operands; reject short lines
+            // instead of indexing past the end.
+            size_t minTokens = 4;
+            switch (inst->opCode) {
+                case IRInstruction::OpCode::ASSIGN: minTokens = 3; break;
+                case IRInstruction::OpCode::GOTO:
+                case IRInstruction::OpCode::RETURN:
+                case IRInstruction::OpCode::CALL: minTokens = 2; break;
+                case IRInstruction::OpCode::CALLR: minTokens = 3; break;
+                default: break;
+            }
+            if (tokens.size() < minTokens) throw IRException("Invalid operand");
 
             switch (inst->opCode) {
-                case IRInstruction::OpCode::ASSIGN: {
-                    if (tokens.size() > 3) {
-                        inst->operands.push_back(makeConstOrVar(inst.get(), tokens[1]));
-                        inst->operands.push_back(makeConstOrVar(inst.get(), tokens[2]));
-                        inst->operands.push_back(makeConstOrVar(inst.get(), tokens[3]));
-                        auto t0 = getType(inst->operands[0]);
-                        auto t1 = getType(inst->operands[1]);
-                        auto t2 = getType(inst->operands[2]);
-                        auto arr = std::dynamic_pointer_cast<IRArrayType>(t0);
-                        if (!(arr && t1.get() == IRIntType::get().get() && arr->elementType.get() == t2.get()))
-                            throw IRException("Invalid operand");
-                    } else {
-                        inst->operands.push_back(makeConstOrVar(inst.get(), tokens[1]));
-                        inst->operands.push_back(makeConstOrVar(inst.get(), tokens[2]));
-                        auto t0 = getType(inst->operands[0]);
-                        auto t1 = getType(inst->operands[1]);
-                        if (std::dynamic_pointer_cast<IRArrayType>(t0) || t0.get() != t1.get())
-                            throw IRException("Invalid operand");
-                    }
+                case IRInstruction::OpCode::ASSIGN:
+                    ops.push_back(arena, makeConstOrVar(tokens[1]));
+                    ops.push_back(arena, makeConstOrVar(tokens[2]));
+                    if (tokens.size() > 3) ops.push_back(arena, makeConstOrVar(tokens[3]));
                     break;
-                }
                 case IRInstruction::OpCode::ADD:
                 case IRInstruction::OpCode::SUB:
                 case IRInstruction::OpCode::MULT:
                 case IRInstruction::OpCode::DIV:
                 case IRInstruction::OpCode::AND:
-                case IRInstruction::OpCode::OR: {
-                    inst->operands.push_back(makeConstOrVar(inst.get(), tokens[1]));
-                    inst->operands.push_back(makeConstOrVar(inst.get(), tokens[2]));
-                    inst->operands.push_back(makeConstOrVar(inst.get(), tokens[3]));
-                    auto t0 = getType(inst->operands[0]);
-                    auto t1 = getType(inst->operands[1]);
-                    auto t2 = getType(inst->operands[2]);
-                    if (!(std::dynamic_pointer_cast<IRVariableOperand>(inst->operands[0]) &&
-                          !std::dynamic_pointer_cast<IRArrayType>(t0) && t0.get()==t1.get() && t1.get()==t2.get()))
-                        throw IRException("Invalid operand");
+                case IRInstruction::OpCode::OR:
+                case IRInstruction::OpCode::ARRAY_STORE:
+                case IRInstruction::OpCode::ARRAY_LOAD:
+                    ops.push_back(arena, makeConstOrVar(tokens[1]));
+                    ops.push_back(arena, makeConstOrVar(tokens[2]));
+                    ops.push_back(arena, makeConstOrVar(tokens[3]));
                     break;
-                }
-                case IRInstruction::OpCode::GOTO: {
-                    inst->operands.push_back(std::make_shared<IRLabelOperand>(tokens[1], inst.get()));
+                case IRInstruction::OpCode::GOTO:
+                    ops.push_back(arena, makeLabel(tokens[1]));
                     break;
-                }
                 case IRInstruction::OpCode::BREQ:
                 case IRInstruction::OpCode::BRNEQ:
                 case IRInstruction::OpCode::BRLT:
                 case IRInstruction::OpCode::BRGT:
-                case IRInstruction::OpCode::BRGEQ: {
-                    inst->operands.push_back(std::make_shared<IRLabelOperand>(tokens[1], inst.get()));
-                    inst->operands.push_back(makeConstOrVar(inst.get(), tokens[2]));
-                    inst->operands.push_back(makeConstOrVar(inst.get(), tokens[3]));
-                    auto t1 = getType(inst->operands[1]);
-                    auto t2 = getType(inst->operands[2]);
-                    if (std::dynamic_pointer_cast<IRArrayType>(t1) || t1.get() != t2.get())
-                        throw IRException("Invalid operand");
-                    break;
-                }
-                case IRInstruction::OpCode::RETURN: {
-                    inst->operands.push_back(makeConstOrVar(inst.get(), tokens[1]));
-                    auto t0 = getType(inst->operands[0]);
-                    if (std::dynamic_pointer_cast<IRArrayType>(t0)) throw IRException("Invalid operand");
+                case IRInstruction::OpCode::BRGEQ:
+                    ops.push_back(arena, makeLabel(tokens[1]));
+                    ops.push_back(arena, makeConstOrVar(tokens[2]));
+                    ops.push_back(arena, makeConstOrVar(tokens[3]));
                     break;
-                }
-                case IRInstruction::OpCode::CALL: {
-                    inst->operands.push_back(std::make_shared<IRFunctionOperand>(tokens[1], inst.get()));
-                    for (size_t i = 2; i < tokens.size(); ++i) inst->operands.push_back(makeConstOrVar(inst.get(), tokens[i]));
+                case IRInstruction::OpCode::RETURN:
+                    ops.push_back(arena, makeConstOrVar(tokens[1]));
                     break;
-                }
-                case IRInstruction::OpCode::CALLR: {
-                    inst->operands.push_back(makeConstOrVar(inst.get(), tokens[1]));
-                    inst->operands.push_back(std::make_shared<IRFunctionOperand>(tokens[2], inst.get()));
-                    for (size_t i = 3; i < tokens.size(); ++i) inst->operands.push_back(makeConstOrVar(inst.get(), tokens[i]));
-                    auto t0 = getType(inst->operands[0]);
-                    if (!(std::dynamic_pointer_cast<IRVariableOperand>(inst->operands[0]) && !std::dynamic_pointer_cast<IRArrayType>(t0)))
-                        throw IRException("Invalid operand");
+                case IRInstruction::OpCode::CALL:
+                    ops.push_back(arena, makeCallee(tokens[1]));
+                    for (size_t i = 2; i < tokens.size(); ++i) ops.push_back(arena, makeConstOrVar(tokens[i]));
                     break;
-                }
-                case IRInstruction::OpCode::ARRAY_STORE: {
-                    inst->operands.push_back(makeConstOrVar(inst.get(), tokens[1]));
-                    inst->operands.push_back(makeConstOrVar(inst.get(), tokens[2]));
-                    inst->operands.push_back(makeConstOrVar(inst.get(), tokens[3]));
-                    auto t0 = getType(inst->operands[0]);
-                    auto t1 = getType(inst->operands[1]);
-                    auto t2 = getType(inst->operands[2]);
-                    auto arr = std::dynamic_pointer_cast<IRArrayType>(t1);
-                    if (!(!std::dynamic_pointer_cast<IRArrayType>(t0) && arr && t2.get()==IRIntType::get().get() && arr->elementType.get()==t0.get()))
-                        throw IRException("Invalid operand");
-                    break;
-                }
-                case IRInstruction::OpCode::ARRAY_LOAD: {
-                    inst->operands.push_back(makeConstOrVar(inst.get(), tokens[1]));
-                    inst->operands.push_back(makeConstOrVar(inst.get(), tokens[2]));
-                    inst->operands.push_back(makeConstOrVar(inst.get(), tokens[3]));
-                    auto t0 = getType(inst->operands[0]);
-                    auto t1 = getType(inst->operands[1]);
-                    auto t2 = getType(inst->operands[2]);
-                    auto arr = std::dynamic_pointer_cast<IRArrayType>(t1);
-                    if (!(std::dynamic_pointer_cast<IRVariableOperand>(inst->operands[0]) && !std::dynamic_pointer_cast<IRArrayType>(t0) && arr && t2.get()==IRIntType::get().get() && arr->elementType.get()==t0.get()))
-                        throw IRException("Invalid operand");
+                case IRInstruction::OpCode::CALLR:
+                    ops.push_back(arena, makeConstOrVar(tokens[1]));
+                    ops.push_back(arena, makeCallee(tokens[2]));
+                    for (size_t i = 3; i < tokens.size(); ++i) ops.push_back(arena, makeConstOrVar(tokens[i]));
                     break;
-                }
                 default: throw IRException("Invalid OpCode");
             }
+            checkOperandTypes(*inst);
 
-            insts.push_back(inst);
+            fn->instructions.push_back(inst);
         }
 
-        std::vector<std::shared_ptr<IRVariableOperand>> vars;
-        vars.reserve(variableMap.size());
-        for (auto& kv : variableMap) vars.push_back(kv.second);
-
-        return std::make_shared<IRFunction>(fnName, retType, params, vars, insts);
+        return fn;
     };
 
-    std::vector<std::shared_ptr<IRFunction>> functions;
-    std::vector<IRLine> buf;
-    for (size_t i = 0; i < irLines.size(); ++i) {
-        const auto& L = irLines[i];
-        if (L.line.rfind("#start_function", 0) == 0) {
-            if (!buf.empty()) throw IRException("Unexpected #start_function");
-            buf.push_back(L);
-        } else if (L.line.rfind("#end_function", 0) == 0) {
-            if (buf.empty()) throw IRException("Unexpected #end_function");
-            buf.push_back(L);
-            functions.push_back(parseFunction(buf));
-            buf.clear();
-        } else {
-            buf.push_back(L);
+    // Prescan: find every #start_function/#end_function block. A structural
+    // error is remembered rather than thrown so that a parse error in an
+    // earlier function is still reported first, exactly as a serial parse would.
+    struct Block { size_t first, last; };
+    std::vector<Block> blocks;
+    std::string structuralError;
+    const size_t npos = static_cast<size_t>(-1);
+    size_t blockBegin = npos;
+    for (size_t i = 0; i < irLines.size() && structuralError.empty(); ++i) {
+        std::string_view L = irLines[i].line;
+        if (L.substr(0, 15) == "#start_function") {
+            if (blockBegin != npos) structuralError = "Unexpected #start_function";
+            blockBegin = i;
+        } else if (L.substr(0, 13) == "#end_function") {
+            if (blockBegin == npos) structuralError = "Unexpected #end_function";
+            else blocks.push_back({blockBegin, i});
+            blockBegin = npos;
+        } else if (blockBegin == npos) {
+            blockBegin = i;
         }
     }
 
+    // Function bodies are independent, so parse them on a pool of workers that
+    // pull block indices from a shared counter. Results land in their original
+    // slots, so IRProgram::functions keeps file order.
+    std::vector<std::shared_ptr<IRFunction>> functions(blocks.size());
+    std::vector<std::exception_ptr> errors(blocks.size());
+    std::atomic<size_t> nextBlock{0};
+    auto worker = [&]() {
+        for (size_t b; (b = nextBlock.fetch_add(1, std::memory_order_relaxed)) < blocks.size(); ) {
+            try {
+                functions[b] = parseFunction(blocks[b].first, blocks[b].last);
+            } catch (...) {
+                errors[b] = std::current_exception();
+            }
+        }
+    };
+
+    unsigned workers = parseThreads ? parseThreads : std::thread::hardware_concurrency();
+    // Small inputs are not worth a thread spawn.
+    const size_t kBlocksPerWorker = 16;
+    workers = static_cast<unsigned>(std::min<size_t>(std::max(1u, workers), blocks.size() / kBlocksPerWorker));
+    std::vector<std::thread> pool;
+    for (unsigned t = 1; t < workers; ++t) pool.emplace_back(worker);
+    worker();
+    for (auto& th : pool) th.join();
+
+    for (const auto& e : errors) if (e) std::rethrow_exception(e);
+    if (!structuralError.empty()) throw IRException(structuralError);
+
     IRProgram p;
     p.functions = std::move(functions);
     return p;
 }
-
-
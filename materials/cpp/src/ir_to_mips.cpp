@@ -1,28 +1,69 @@
 #include <bits/stdc++.h>
 #include "ir.hpp"
 #include "instruction_selector.hpp"
+#include "compile_cache.hpp"
+#include "loops.hpp"
+#include "pass_manager.hpp"
 #include "mips_instructions.hpp"
 #include "register_manager.hpp"
 
 int main(int argc, char* argv[]) {
     // Usage:
-    //   ./ir_to_mips <input.ir> <output.s> [--naive | --greedy]
-    // Default mode is --naive
-    if (argc < 3 || argc > 4) {
-        std::cerr << "Usage: " << argv[0] << " <input.ir> <output.s> [--naive|--greedy]" << std::endl;
+    //   ./ir_to_mips <input.ir> <output.s> [--naive | --greedy] [--emit-ir | --emit-ir-binary | --emit-cfg-dot]
+    //                [--cache-dir <dir>] [-O0 | -O1 | -O2] [--ssa]
+    //                [--inline-size <n>] [--inline-growth <n>] [--stats]
+    // Default mode is --naive at -O0. The input may be IR text or binary IR.
+    // --emit-ir / --emit-ir-binary write the parsed IR (text or binary) to
+    // <output> instead of assembly; --emit-cfg-dot writes each function's
+    // control flow graph as a Graphviz digraph.
+    // --cache-dir reuses assembly for functions unchanged since an earlier
+    // build with the same mode and reports hits and misses on stderr.
+    // -O1 / -O2 run the IR optimization pipeline (PassManager::forLevel) on
+    // each function before output; --ssa appends an SSA round trip to it.
+    // -O2 first inlines calls to small leaf functions: --inline-size sets the
+    // largest callee body and --inline-growth how much one caller may grow
+    // (InlineLimits).
+    // -O1 and up also run the peephole optimizer over the selected code;
+    // --stats prints its per-rule hits to stderr (with --cache-dir, only
+    // for functions that missed).
+    auto usage = [&]() {
+        std::cerr << "Usage: " << argv[0] << " <input.ir> <output.s> [--naive|--greedy] [--emit-ir|--emit-ir-binary|--emit-cfg-dot] [--cache-dir <dir>] [-O0|-O1|-O2] [--ssa] [--inline-size <n>] [--inline-growth <n>] [--stats]" << std::endl;
         return 1;
-    }
+    };
+    if (argc < 3) return usage();
     
     std::string inputFile(argv[1]);
     std::string outputFile(argv[2]);
     ircpp::IRToMIPSSelector::AllocMode mode = ircpp::IRToMIPSSelector::AllocMode::Naive;
-    if (argc == 4) {
-        std::string flag(argv[3]);
+    enum class Output { Assembly, IRText, IRBinary, CFGDot } output = Output::Assembly;
+    std::string cacheDir;
+    int optLevel = 0;
+    bool ssa = false;
+    bool stats = false;
+    ircpp::InlineLimits inlineLimits;
+    auto limit = [&](const char* text, uint32_t& out) {
+        char* end = nullptr;
+        const unsigned long v = std::strtoul(text, &end, 10);
+        if (!*text || *end || v > UINT32_MAX) return false;
+        out = static_cast<uint32_t>(v);
+        return true;
+    };
+    for (int i = 3; i < argc; ++i) {
+        std::string flag(argv[i]);
         if (flag == "--naive") mode = ircpp::IRToMIPSSelector::AllocMode::Naive;
         else if (flag == "--greedy") mode = ircpp::IRToMIPSSelector::AllocMode::Greedy;
+        else if (flag == "--emit-ir") output = Output::IRText;
+        else if (flag == "--emit-ir-binary") output = Output::IRBinary;
+        else if (flag == "--emit-cfg-dot") output = Output::CFGDot;
+        else if (flag == "--cache-dir" && i + 1 < argc) cacheDir = argv[++i];
+        else if (flag == "-O0" || flag == "-O1" || flag == "-O2") optLevel = flag[2] - '0';
+        else if (flag == "--ssa") ssa = true;
+        else if (flag == "--stats") stats = true;
+        else if (flag == "--inline-size" && i + 1 < argc && limit(argv[i + 1], inlineLimits.calleeSize)) ++i;
+        else if (flag == "--inline-growth" && i + 1 < argc && limit(argv[i + 1], inlineLimits.callerGrowth)) ++i;
         else {
             std::cerr << "Unknown flag: " << flag << std::endl;
-            std::cerr << "Allowed: --naive, --greedy" << std::endl;
+            std::cerr << "Allowed: --naive, --greedy, --emit-ir, --emit-ir-binary, --emit-cfg-dot, --cache-dir <dir>, -O0, -O1, -O2, --ssa, --inline-size <n>, --inline-growth <n>, --stats" << std::endl;
             return 1;
         }
     }
@@ -36,15 +77,62 @@ int main(int argc, char* argv[]) {
         // 4. Generate assembly text
         // 5. Write to output file
         
-        // Parse IR file
         ircpp::IRReader reader;
-        ircpp::IRProgram program = reader.parseIRFile(inputFile);
+        ircpp::PassManager passes = ircpp::PassManager::forLevel(optLevel, inlineLimits);
+        if (ssa) passes.add(ircpp::createSSARoundTripPass());
+        std::function<void(ircpp::IRFunction&)> prepare;
+        if (!passes.empty()) prepare = [&](ircpp::IRFunction& fn) { passes.run(fn); };
+        ircpp::PeepholeOptimizer peephole;
+        ircpp::PeepholeOptimizer* peepholeIfOn = optLevel >= 1 ? &peephole : nullptr;
+
+        if (!cacheDir.empty() && output == Output::Assembly) {
+            std::ifstream in(inputFile, std::ios::in | std::ios::binary);
+            if (!in) throw ircpp::IRException("File not found: " + inputFile);
+            std::string text((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+            ircpp::IRToMIPSSelector selector(mode);
+            ircpp::CompileCache cache(cacheDir, ircpp::cacheConfigFor(selector) + ";" + passes.describe());
+            std::string assembly = ircpp::compileWithCache(text, reader, selector, cache, prepare, passes.inlining(), peepholeIfOn);
+            std::ofstream ofs(outputFile, std::ios::out | std::ios::trunc | std::ios::binary);
+            if (!ofs) throw std::runtime_error("Failed to open output file: " + outputFile);
+            ofs << assembly;
+            if (!ofs.good()) throw std::runtime_error("Failed to write assembly to: " + outputFile);
+            std::cerr << "cache: " << cache.hits() << " hits, " << cache.misses() << " misses" << std::endl;
+            if (stats && peepholeIfOn) peephole.printStats(std::cerr);
+            return 0;
+        }
+
+        // Parse IR file
+        ircpp::IRProgram program = reader.parseIRFileMapped(inputFile);
+        // Taken before the passes run, like the compile cache does.
+        const ircpp::CallGraph calls = ircpp::CallGraph::build(program);
+        passes.run(program);
+
+        if (output != Output::Assembly) {
+            std::ofstream ofs(outputFile, std::ios::out | std::ios::trunc | std::ios::binary);
+            if (!ofs) throw std::runtime_error("Failed to open output file: " + outputFile);
+            if (output == Output::IRBinary) ircpp::IRBinaryWriter(ofs).writeProgram(program);
+            else if (output == Output::CFGDot) {
+                for (const auto& fn : program.functions)
+                    if (fn) {
+                        ircpp::ControlFlowGraph cfg = ircpp::CFGBuilder::buildCFG(*fn);
+                        ircpp::LoopInfo loops = ircpp::LoopInfo::compute(*fn, cfg);
+                        ircpp::CFGBuilder::printCFGDot(cfg, ofs, &loops);
+                    }
+            }
+            else ircpp::IRPrinter(ofs).printProgram(program);
+            if (!ofs.good()) throw std::runtime_error("Failed to write to: " + outputFile);
+            return 0;
+        }
         
         // Create instruction selector with desired allocation mode
         ircpp::IRToMIPSSelector selector(mode);
         
         // Convert to MIPS
-        std::vector<ircpp::MIPSInstruction> mipsInstructions = selector.selectProgram(program);
+        std::vector<ircpp::MIPSInstruction> mipsInstructions = selector.selectProgram(program, &calls);
+        if (peepholeIfOn) {
+            peephole.run(mipsInstructions);
+            if (stats) peephole.printStats(std::cerr);
+        }
         
         // Generate and write assembly
         std::string assembly = selector.generateAssembly(mipsInstructions);
@@ -1,44 +1,63 @@
 #include "ir.hpp"
 
+#include <atomic>
+
 using namespace ircpp;
 
 namespace {
-struct TypePtrHash {
-    std::size_t operator()(const std::shared_ptr<IRType>& p) const noexcept {
-        return std::hash<const void*>()(p.get());
-    }
-};
-struct TypePtrEq {
-    bool operator()(const std::shared_ptr<IRType>& a, const std::shared_ptr<IRType>& b) const noexcept {
-        return a.get() == b.get();
-    }
+// Array types are interned in a fixed-size hash table whose buckets are
+// singly linked lists. A new node is published at the head of its bucket with
+// compare-and-swap and nodes are never removed, so lookups walk the chains
+// without taking a lock and always see fully constructed nodes. Interned types
+// live until process exit.
+struct ArrayNode {
+    const IRType* element;
+    int size;
+    std::shared_ptr<IRArrayType> type;
+    ArrayNode* next;
 };
+
+constexpr size_t kArrayBuckets = 1024;
+std::atomic<ArrayNode*> g_array_buckets[kArrayBuckets];
+
+size_t arrayBucket(const IRType* element, int size) {
+    size_t h = std::hash<const void*>()(element) ^ (static_cast<size_t>(size) * 0x9e3779b97f4a7c15ull);
+    return (h ^ (h >> 29)) % kArrayBuckets;
 }
 
-static std::shared_ptr<IRIntType> g_int_singleton;
-static std::shared_ptr<IRFloatType> g_float_singleton;
-// Cache: key = element type singleton, value = map from size to array type instance
-static std::unordered_map<std::shared_ptr<IRType>, std::unordered_map<int, std::shared_ptr<IRArrayType>>, TypePtrHash, TypePtrEq> g_array_cache;
+const ArrayNode* findArray(const ArrayNode* n, const ArrayNode* stop, const IRType* element, int size) {
+    for (; n != stop; n = n->next)
+        if (n->element == element && n->size == size) return n;
+    return nullptr;
+}
+}
 
 std::shared_ptr<IRIntType> IRIntType::get() {
-    if (!g_int_singleton) g_int_singleton = std::shared_ptr<IRIntType>(new IRIntType());
+    // Function-local static: initialization is thread-safe.
+    static const std::shared_ptr<IRIntType> g_int_singleton(new IRIntType());
     return g_int_singleton;
 }
 
 std::shared_ptr<IRFloatType> IRFloatType::get() {
-    if (!g_float_singleton) g_float_singleton = std::shared_ptr<IRFloatType>(new IRFloatType());
+    static const std::shared_ptr<IRFloatType> g_float_singleton(new IRFloatType());
     return g_float_singleton;
 }
 
-IRArrayType::IRArrayType(std::shared_ptr<IRType> t, int s) : elementType(std::move(t)), size(s) {}
+IRArrayType::IRArrayType(std::shared_ptr<IRType> t, int s) : IRType(Kind::Array), elementType(std::move(t)), size(s) {}
 
 std::shared_ptr<IRArrayType> IRArrayType::get(std::shared_ptr<IRType> elementType, int size) {
-    auto& perElem = g_array_cache[elementType];
-    auto it = perElem.find(size);
-    if (it != perElem.end()) return it->second;
-    auto created = std::shared_ptr<IRArrayType>(new IRArrayType(elementType, size));
-    perElem[size] = created;
-    return created;
+    std::atomic<ArrayNode*>& head = g_array_buckets[arrayBucket(elementType.get(), size)];
+    ArrayNode* first = head.load(std::memory_order_acquire);
+    if (auto n = findArray(first, nullptr, elementType.get(), size)) return n->type;
+
+    std::unique_ptr<ArrayNode> fresh(new ArrayNode{elementType.get(), size, nullptr, nullptr});
+    fresh->type = std::shared_ptr<IRArrayType>(new IRArrayType(elementType, size));
+    for (;;) {
+        ArrayNode* seen = first;
+        fresh->next = first;
+        if (head.compare_exchange_weak(first, fresh.get(), std::memory_order_release, std::memory_order_acquire))
+            return fresh.release()->type;
+        // Lost a race: only nodes pushed since `seen` can hold a duplicate.
+        if (auto n = findArray(first, seen, elementType.get(), size)) return n->type;
+    }
 }
-
-
@@ -0,0 +1,223 @@
+#include "pass_manager.hpp"
+
+#include <algorithm>
+#include <unordered_set>
+
+namespace ircpp {
+
+namespace {
+
+using Op = IRInstruction::OpCode;
+constexpr uint32_t kNone = ControlFlowGraph::kNone;
+
+// Instructions that only compute their result from their operands. A divide
+// by anything but a nonzero constant and an array load can fault, so they
+// may only move where they were going to run anyway.
+bool hoistable(const IRInstruction* ir) {
+    switch (ir->opCode) {
+        case Op::ADD: case Op::SUB: case Op::MULT: case Op::DIV: case Op::AND: case Op::OR:
+        case Op::ARRAY_LOAD:
+            return true;
+        case Op::ASSIGN:
+            return ir->operands.size() == 2;
+        default:
+            return false;
+    }
+}
+bool mayFault(const IRInstruction* ir) {
+    if (ir->opCode == Op::ARRAY_LOAD) return true;
+    if (ir->opCode != Op::DIV) return false;
+    auto c = ir->operands[2]->asConstant();
+    return !(c && c->type->isInt() && c->intValue != 0);
+}
+
+// Loop-invariant code motion on ordinary IR. `d = a op b` inside loop L
+// moves to L's preheader when a and b are constants or have no definition
+// in L (or only one that already moved), this is the only definition of d
+// in L, and it comes before every read of d in L, so those reads all see
+// this value. An instruction is sure to run if it dominates every
+// block the loop exits from (and there is one: in a loop that never exits,
+// a guarded instruction may never run), or every latch of a loop known to
+// take its back edge at least once. Unless it is, d must be dead where the loop exits (or
+// a run that skipped it would leave with the new value), and it must not be
+// able to fault. An array load additionally needs no store, bulk assign or
+// call in L that may write the array; array parameters may all be one
+// array.
+//
+// Each round moves instructions out of their innermost loop only, so a
+// value invariant in an outer loop too leaves one level per round.
+class LICMPass : public FunctionPass {
+public:
+    const char* name() const override { return "licm"; }
+
+    uint32_t run(IRFunction& F, FunctionAnalyses& analyses) override {
+        for (const IRInstruction* ir : F.instructions)
+            if (!ir || ir->opCode == Op::PHI) return Analysis::kAll;
+        bool changed = false;
+        while (hoist(F, analyses)) {
+            analyses.invalidate(Analysis::kNone);
+            changed = true;
+        }
+        return changed ? Analysis::kNone : Analysis::kAll;
+    }
+
+private:
+    static bool hoist(IRFunction& F, FunctionAnalyses& analyses) {
+        const ControlFlowGraph& cfg = analyses.cfg();
+        const LoopInfo& loops = analyses.loops();
+        if (loops.loops.empty()) return false;
+        const Liveness& live = analyses.liveness();
+        const DefUseIndex& du = analyses.defUse();
+        auto& ins = F.instructions;
+
+        std::vector<bool> isParam(F.variables.size(), false);
+        for (const IRVariableOperand* p : F.parameters) isParam[p->id] = true;
+        auto mayAlias = [&](const IRVariableOperand* a, const IRVariableOperand* b) {
+            return a == b || (isParam[a->id] && isParam[b->id]);
+        };
+        auto dominatesAll = [&](uint32_t b, const std::vector<uint32_t>& blocks) {
+            return std::all_of(blocks.begin(), blocks.end(), [&](uint32_t x) { return cfg.dominates(b, x); });
+        };
+
+        std::vector<bool> moved(ins.size(), false);
+        std::vector<std::vector<uint32_t>> hoisted(loops.loops.size());
+        bool any = false;
+        for (uint32_t l = 0; l < loops.loops.size(); ++l) {
+            const Loop& L = loops.loops[l];
+            std::vector<uint32_t> exiting;
+            std::vector<const IRVariableOperand*> written;
+            for (uint32_t b : L.blocks) {
+                auto succ = cfg.successors(b);
+                if (std::any_of(succ.begin(), succ.end(), [&](uint32_t s) { return !L.contains(s); })) exiting.push_back(b);
+                for (uint32_t i = cfg.blocks[b].first; i <= cfg.blocks[b].last; ++i) {
+                    const IRInstruction* ir = ins[i];
+                    if (ir->opCode == Op::ARRAY_STORE) written.push_back(ir->operands[1]->asVariable());
+                    else if (ir->opCode == Op::ASSIGN && ir->operands.size() == 3) written.push_back(ir->operands[0]->asVariable());
+                    else if (ir->opCode == Op::CALL || ir->opCode == Op::CALLR)
+                        for (IROperand* a : ir->operands)
+                            if (auto v = a->asVariable(); v && v->isArray()) written.push_back(v);
+                }
+            }
+            // The single definition of v inside L, kNone if there is none,
+            // and kNone - 1 if there are several.
+            auto defIn = [&](const IRVariableOperand* v) {
+                uint32_t found = kNone;
+                for (uint32_t e = du.begin[v->id]; e < du.begin[v->id + 1]; ++e) {
+                    if (!(du.flags[e] & DefUseIndex::Def) || !L.contains(cfg.blockOf(du.pos[e]))) continue;
+                    if (found != kNone) return kNone - 1;
+                    found = du.pos[e];
+                }
+                return found;
+            };
+            // Whether the write at i in block b comes before every read of v
+            // inside L.
+            auto dominatesUses = [&](const IRVariableOperand* v, uint32_t b, uint32_t i) {
+                for (uint32_t e = du.begin[v->id]; e < du.begin[v->id + 1]; ++e) {
+                    if (!(du.flags[e] & DefUseIndex::Use)) continue;
+                    const uint32_t u = du.pos[e], ub = cfg.blockOf(u);
+                    if (L.contains(ub) && (ub == b ? u <= i : !cfg.dominates(b, ub))) return false;
+                }
+                return true;
+            };
+            const bool runsOnce = L.tripCount != Loop::kNone && L.tripCount >= 1;
+
+            for (uint32_t b : cfg.rpo) {
+                if (loops.blockLoop[b] != l) continue;
+                const bool domExits = !exiting.empty() && dominatesAll(b, exiting);
+                const bool sureToRun = domExits || (runsOnce && dominatesAll(b, L.latches));
+                for (uint32_t i = cfg.blocks[b].first; i <= cfg.blocks[b].last; ++i) {
+                    const IRInstruction* ir = ins[i];
+                    const IRVariableOperand* d = ir->scalarDef();
+                    if (!d || !hoistable(ir) || defIn(d) != i || !dominatesUses(d, b, i)) continue;
+                    if (mayFault(ir) && !sureToRun) continue;
+                    if (!sureToRun && std::any_of(L.exits.begin(), L.exits.end(),
+                                                 [&](uint32_t e) { return live.liveIn[e].test(d->id); })) continue;
+                    bool invariant = true;
+                    ir->forEachScalarUse([&](const IRVariableOperand* v) {
+                        const uint32_t def = defIn(v);
+                        if (def != kNone && !(def < kNone - 1 && moved[def] && loops.blockLoop[cfg.blockOf(def)] == l)) invariant = false;
+                    });
+                    if (ir->opCode == Op::ARRAY_LOAD) {
+                        const IRVariableOperand* array = ir->operands[1]->asVariable();
+                        for (const IRVariableOperand* w : written) invariant &= !mayAlias(w, array);
+                    }
+                    if (!invariant) continue;
+                    moved[i] = true;
+                    hoisted[l].push_back(i);
+                    any = true;
+                }
+            }
+        }
+        if (!any) return false;
+
+        // Where each header's hoisted code goes: at the end of its only
+        // entering block, if that block leads nowhere else and does not end
+        // in a branch (which would read what is moved above it); otherwise a
+        // new preheader just above the header, which entering jumps now
+        // target. A loop block falling into the header jumps to it instead.
+        const uint32_t nblocks = static_cast<uint32_t>(cfg.size());
+        std::vector<uint32_t> appendTo(nblocks, kNone), preheaderOf(nblocks, kNone), gotoAfter(nblocks, kNone);
+        std::vector<IRLabelOperand*> newPreheader(nblocks, nullptr), newHeaderLabel(nblocks, nullptr);
+        for (uint32_t l = 0; l < loops.loops.size(); ++l) {
+            if (hoisted[l].empty()) continue;
+            const Loop& L = loops.loops[l];
+            const uint32_t h = L.header;
+            std::vector<uint32_t> entering;
+            for (uint32_t p : cfg.predecessors(h))
+                if (!L.contains(p)) entering.push_back(p);
+            if (entering.size() == 1 && cfg.successors(entering[0]).size() == 1 &&
+                !ins[cfg.blocks[entering[0]].last]->isConditionalBranch()) {
+                appendTo[entering[0]] = l;
+                continue;
+            }
+            IRInstruction* first = ins[cfg.blocks[h].first];
+            const IRLabelOperand* hl = first->opCode == Op::LABEL ? first->operands[0]->asLabel() : nullptr;
+            if (!hl) hl = newHeaderLabel[h] = F.addLabel("licm");
+            IRLabelOperand* ph = newPreheader[h] = F.addLabel("licm");
+            preheaderOf[h] = l;
+            for (uint32_t p : entering) {
+                IRInstruction* last = ins[cfg.blocks[p].last];
+                if (last->isJump() && last->operands[0]->asLabel()->id == hl->id)
+                    last->operands[0] = ph;
+            }
+            if (h > 0 && L.contains(h - 1)) {
+                const Op op = ins[cfg.blocks[h - 1].last]->opCode;
+                if (op != Op::GOTO && op != Op::RETURN) gotoAfter[h - 1] = h;
+            }
+        }
+
+        std::vector<IRInstruction*> out;
+        out.reserve(ins.size() + 4 * loops.loops.size());
+        auto emitHoisted = [&](uint32_t l) {
+            for (uint32_t i : hoisted[l]) out.push_back(ins[i]);
+        };
+        for (uint32_t b = 0; b < nblocks; ++b) {
+            const int line = ins[cfg.blocks[b].first]->irLineNumber;
+            if (preheaderOf[b] != kNone) {
+                out.push_back(F.makeInstruction(Op::LABEL, line, {newPreheader[b]}));
+                emitHoisted(preheaderOf[b]);
+                if (newHeaderLabel[b]) out.push_back(F.makeInstruction(Op::LABEL, line, {newHeaderLabel[b]}));
+            }
+            for (uint32_t i = cfg.blocks[b].first; i <= cfg.blocks[b].last; ++i) {
+                if (moved[i]) continue;
+                if (i == cfg.blocks[b].last && appendTo[b] != kNone && ins[i]->opCode == Op::GOTO) emitHoisted(appendTo[b]);
+                out.push_back(ins[i]);
+            }
+            if (appendTo[b] != kNone && ins[cfg.blocks[b].last]->opCode != Op::GOTO) emitHoisted(appendTo[b]);
+            if (gotoAfter[b] != kNone) {
+                const uint32_t h = gotoAfter[b];
+                IRInstruction* first = ins[cfg.blocks[h].first];
+                IROperand* target = newHeaderLabel[h] ? newHeaderLabel[h] : first->operands[0];
+                out.push_back(F.makeInstruction(Op::GOTO, ins[cfg.blocks[b].last]->irLineNumber, {target}));
+            }
+        }
+        ins = std::move(out);
+        return true;
+    }
+};
+
+} // namespace
+
+std::unique_ptr<FunctionPass> createLICMPass() { return std::make_unique<LICMPass>(); }
+
+} // namespace ircpp
@@ -0,0 +1,70 @@
+#include "liveness.hpp"
+
+#include <deque>
+
+namespace ircpp {
+
+void Liveness::transfer(const IRInstruction& ir, VarSet& live) {
+    if (auto d = ir.scalarDef()) live.reset(d->id);
+    if (ir.opCode == IRInstruction::OpCode::PHI) return;
+    ir.forEachScalarUse([&](const IRVariableOperand* v) { live.set(v->id); });
+}
+
+Liveness Liveness::compute(const IRFunction& function, const ControlFlowGraph& cfg) {
+    const size_t nblocks = cfg.size();
+    const size_t nvars = function.variables.size();
+    Liveness L;
+    L.liveIn.assign(nblocks, VarSet(nvars));
+    L.liveOut.assign(nblocks, VarSet(nvars));
+
+    // Per-block summary: gen = upward-exposed uses, kill = defs. A phi's
+    // incoming values go straight into its predecessors' live-out sets.
+    std::vector<VarSet> gen(nblocks, VarSet(nvars)), kill(nblocks, VarSet(nvars));
+    for (uint32_t b : cfg.rpo) {
+        for (uint32_t i = cfg.blocks[b].last + 1; i-- > cfg.blocks[b].first; ) {
+            const IRInstruction* ir = function.instructions[i];
+            if (!ir) continue;
+            if (auto d = ir->scalarDef()) { gen[b].reset(d->id); kill[b].set(d->id); }
+            if (ir->opCode == IRInstruction::OpCode::PHI) {
+                for (size_t k = 1; k + 1 < ir->operands.size(); k += 2) {
+                    auto v = ir->operands[k]->asVariable();
+                    uint32_t p = cfg.labelBlock[ir->operands[k + 1]->asLabel()->id];
+                    if (v && p != ControlFlowGraph::kNone) L.liveOut[p].set(v->id);
+                }
+                continue;
+            }
+            ir->forEachScalarUse([&](const IRVariableOperand* v) { gen[b].set(v->id); });
+        }
+    }
+
+    // Backward problem, so seed the worklist in postorder (reverse postorder
+    // of the reversed graph): most blocks then see their successors' final
+    // sets on the first visit.
+    std::deque<uint32_t> work(cfg.rpo.rbegin(), cfg.rpo.rend());
+    std::vector<bool> queued(nblocks, false);
+    for (uint32_t b : work) queued[b] = true;
+    const size_t nwords = nblocks ? L.liveIn[0].words.size() : 0;
+    while (!work.empty()) {
+        const uint32_t b = work.front();
+        work.pop_front();
+        queued[b] = false;
+
+        auto& out = L.liveOut[b].words;
+        for (uint32_t s : cfg.successors(b)) {
+            const auto& in = L.liveIn[s].words;
+            for (size_t w = 0; w < nwords; ++w) out[w] |= in[w];
+        }
+        bool changed = false;
+        auto& in = L.liveIn[b].words;
+        for (size_t w = 0; w < nwords; ++w) {
+            uint64_t v = gen[b].words[w] | (out[w] & ~kill[b].words[w]);
+            if (v != in[w]) { in[w] = v; changed = true; }
+        }
+        if (!changed) continue;
+        for (uint32_t p : cfg.predecessors(b))
+            if (cfg.reachable(p) && !queued[p]) { queued[p] = true; work.push_back(p); }
+    }
+    return L;
+}
+
+} // namespace ircpp
@@ -0,0 +1,260 @@
+#include "loops.hpp"
+
+#include <algorithm>
+#include <limits>
+
+namespace ircpp {
+
+namespace {
+
+using Op = IRInstruction::OpCode;
+
+enum class Cmp { Eq, Ne, Lt, Gt, Ge, Le };
+
+Cmp swapped(Cmp c) {
+    switch (c) {
+        case Cmp::Lt: return Cmp::Gt;
+        case Cmp::Gt: return Cmp::Lt;
+        case Cmp::Ge: return Cmp::Le;
+        case Cmp::Le: return Cmp::Ge;
+        default: return c;
+    }
+}
+
+Cmp negated(Cmp c) {
+    switch (c) {
+        case Cmp::Eq: return Cmp::Ne;
+        case Cmp::Ne: return Cmp::Eq;
+        case Cmp::Lt: return Cmp::Ge;
+        case Cmp::Ge: return Cmp::Lt;
+        case Cmp::Gt: return Cmp::Le;
+        case Cmp::Le: return Cmp::Gt;
+    }
+    return c;
+}
+
+bool holds(Cmp c, int64_t a, int64_t b) {
+    switch (c) {
+        case Cmp::Eq: return a == b;
+        case Cmp::Ne: return a != b;
+        case Cmp::Lt: return a < b;
+        case Cmp::Gt: return a > b;
+        case Cmp::Ge: return a >= b;
+        case Cmp::Le: return a <= b;
+    }
+    return false;
+}
+
+const IRConstantOperand* intConstant(const IROperand* op) {
+    auto c = op->asConstant();
+    return c && c->type->isInt() ? c : nullptr;
+}
+
+// First k >= 0 at which `exit(base + step * k, bound)` holds, for values
+// that stay inside int32 (the IR wraps, and a count past the wrap is not a
+// hint anyone can use). Every compare but Eq is monotone along a linear
+// sequence, so a binary search finds the first k; Eq is solved directly.
+uint32_t firstExit(Cmp exit, int64_t base, int64_t step, int64_t bound) {
+    const int64_t lo = std::numeric_limits<int32_t>::min(), hi = std::numeric_limits<int32_t>::max();
+    if (base < lo || base > hi) return Loop::kNone;
+    const int64_t kmax = step > 0 ? (hi - base) / step : (base - lo) / -step;
+    auto at = [&](int64_t k) { return holds(exit, base + step * k, bound); };
+    if (at(0)) return 0;
+    if (exit == Cmp::Eq) {
+        if ((bound - base) % step) return Loop::kNone;
+        const int64_t k = (bound - base) / step;
+        return k > 0 && k <= kmax ? static_cast<uint32_t>(k) : Loop::kNone;
+    }
+    if (!at(kmax)) return Loop::kNone;
+    int64_t a = 0, b = kmax; // exit fails at a, holds at b
+    while (b - a > 1) {
+        const int64_t m = a + (b - a) / 2;
+        (at(m) ? b : a) = m;
+    }
+    return static_cast<uint32_t>(b);
+}
+
+void findInductionVariables(const IRFunction& F, const ControlFlowGraph& cfg, LoopInfo& LI,
+                            uint32_t idx, std::vector<uint32_t>& defs, std::vector<uint32_t>& defAt) {
+    Loop& L = LI.loops[idx];
+    std::vector<uint32_t> touched;
+    for (uint32_t b : L.blocks)
+        for (uint32_t i = cfg.blocks[b].first; i <= cfg.blocks[b].last; ++i) {
+            const IRInstruction* ir = F.instructions[i];
+            auto d = ir ? ir->scalarDef() : nullptr;
+            if (!d) continue;
+            if (defs[d->id]++ == 0) touched.push_back(d->id);
+            defAt[d->id] = i;
+        }
+
+    // The single block entering the loop, if there is one: where the start
+    // value of an induction variable is looked for.
+    uint32_t entering = Loop::kNone, enteringCount = 0;
+    for (uint32_t p : cfg.predecessors(L.header))
+        if (cfg.reachable(p) && !L.contains(p)) { entering = p; ++enteringCount; }
+    if (enteringCount != 1) entering = Loop::kNone;
+
+    std::sort(touched.begin(), touched.end());
+    for (uint32_t v : touched) {
+        if (defs[v] != 1) continue;
+        const uint32_t i = defAt[v];
+        const IRInstruction* ir = F.instructions[i];
+        const IRVariableOperand* var = ir->scalarDef();
+        if (!var->type->isInt() || ir->operands.size() != 3) continue;
+        const IRConstantOperand* c = nullptr;
+        if (ir->opCode == Op::ADD || ir->opCode == Op::SUB) {
+            if (ir->operands[1] == ir->operands[0]) c = intConstant(ir->operands[2]);
+            else if (ir->opCode == Op::ADD && ir->operands[2] == ir->operands[0]) c = intConstant(ir->operands[1]);
+        }
+        if (!c || c->intValue == 0 || (ir->opCode == Op::SUB && c->intValue == std::numeric_limits<int32_t>::min())) continue;
+        // Once per iteration: not inside a nested loop, and on every path
+        // round the loop.
+        const uint32_t u = cfg.blockOf(i);
+        if (LI.blockLoop[u] != idx) continue;
+        if (!std::all_of(L.latches.begin(), L.latches.end(), [&](uint32_t l) { return cfg.dominates(u, l); })) continue;
+
+        InductionVariable iv;
+        iv.var = var;
+        iv.update = i;
+        iv.step = ir->opCode == Op::SUB ? -c->intValue : c->intValue;
+        // Walk back through blocks with a single predecessor to the write
+        // that reaches the loop.
+        uint32_t b = entering;
+        for (uint32_t steps = 0; b != Loop::kNone && steps < cfg.size(); ++steps) {
+            const IRInstruction* def = nullptr;
+            for (uint32_t k = cfg.blocks[b].last + 1; k-- > cfg.blocks[b].first; )
+                if (F.instructions[k] && F.instructions[k]->scalarDef() == var) { def = F.instructions[k]; break; }
+            if (def) {
+                if (def->opCode == Op::ASSIGN && def->operands.size() == 2) iv.init = intConstant(def->operands[1]);
+                break;
+            }
+            auto preds = cfg.predecessors(b);
+            b = preds.size() == 1 ? *preds.begin() : Loop::kNone;
+        }
+        L.inductionVariables.push_back(iv);
+    }
+    for (uint32_t v : touched) defs[v] = 0;
+}
+
+void findTripCount(const IRFunction& F, const ControlFlowGraph& cfg, LoopInfo& LI, uint32_t idx) {
+    Loop& L = LI.loops[idx];
+    // Exactly one way out: a single exiting block, and no block that returns
+    // or runs off the end of the function.
+    uint32_t exiting = Loop::kNone;
+    for (uint32_t b : L.blocks) {
+        auto succ = cfg.successors(b);
+        if (succ.empty()) return;
+        if (std::any_of(succ.begin(), succ.end(), [&](uint32_t s) { return !L.contains(s); })) {
+            if (exiting != Loop::kNone) return;
+            exiting = b;
+        }
+    }
+    if (exiting == Loop::kNone || LI.blockLoop[exiting] != idx) return;
+    if (!std::all_of(L.latches.begin(), L.latches.end(), [&](uint32_t l) { return cfg.dominates(exiting, l); })) return;
+
+    const IRInstruction* term = F.instructions[cfg.blocks[exiting].last];
+    Cmp cmp;
+    switch (term->opCode) {
+        case Op::BREQ: cmp = Cmp::Eq; break;
+        case Op::BRNEQ: cmp = Cmp::Ne; break;
+        case Op::BRLT: cmp = Cmp::Lt; break;
+        case Op::BRGT: cmp = Cmp::Gt; break;
+        case Op::BRGEQ: cmp = Cmp::Ge; break;
+        default: return;
+    }
+    auto succ = cfg.successors(exiting);
+    const uint32_t target = cfg.labelBlock[term->operands[0]->asLabel()->id];
+    if (succ.size() != 2 || L.contains(target) == L.contains(succ.begin()[1])) return;
+    if (L.contains(target)) cmp = negated(cmp); // leaves on the fallthrough
+
+    const InductionVariable* iv = nullptr;
+    const IRConstantOperand* bound = nullptr;
+    for (const auto& cand : L.inductionVariables) {
+        if (term->operands[1] == cand.var) { iv = &cand; bound = intConstant(term->operands[2]); break; }
+        if (term->operands[2] == cand.var) { iv = &cand; bound = intConstant(term->operands[1]); cmp = swapped(cmp); break; }
+    }
+    if (!iv || !iv->init || !bound) return;
+
+    // The compare sees the variable after this iteration's update if the
+    // update comes first on every path through the iteration.
+    const uint32_t u = cfg.blockOf(iv->update);
+    int64_t base = iv->init->intValue;
+    if (u == exiting || cfg.dominates(u, exiting)) base += iv->step;
+    else if (!cfg.dominates(exiting, u)) return;
+    L.tripCount = firstExit(cmp, base, iv->step, bound->intValue);
+}
+
+} // namespace
+
+bool Loop::contains(uint32_t block) const {
+    return std::binary_search(blocks.begin(), blocks.end(), block);
+}
+
+LoopInfo LoopInfo::compute(const IRFunction& F, const ControlFlowGraph& cfg) {
+    const uint32_t n = static_cast<uint32_t>(cfg.size());
+    LoopInfo LI;
+    LI.blockLoop.assign(n, kNone);
+
+    // An edge into a block that dominates its source is a back edge; each
+    // such target heads one loop.
+    std::vector<Loop> found;
+    std::vector<uint32_t> headerLoop(n, kNone);
+    for (uint32_t b = 0; b < n; ++b) {
+        if (!cfg.reachable(b)) continue;
+        for (uint32_t s : cfg.successors(b)) {
+            if (!cfg.dominates(s, b)) continue;
+            if (headerLoop[s] == kNone) {
+                headerLoop[s] = static_cast<uint32_t>(found.size());
+                found.emplace_back();
+                found.back().header = s;
+            }
+            found[headerLoop[s]].latches.push_back(b);
+        }
+    }
+
+    // Bodies: everything that reaches a latch backwards without crossing
+    // the header.
+    std::vector<uint32_t> mark(n, kNone), work;
+    for (uint32_t l = 0; l < found.size(); ++l) {
+        Loop& L = found[l];
+        mark[L.header] = l;
+        L.blocks.push_back(L.header);
+        for (uint32_t latch : L.latches)
+            if (mark[latch] != l) { mark[latch] = l; L.blocks.push_back(latch); work.push_back(latch); }
+        while (!work.empty()) {
+            const uint32_t b = work.back();
+            work.pop_back();
+            for (uint32_t p : cfg.predecessors(b))
+                if (cfg.reachable(p) && mark[p] != l) { mark[p] = l; L.blocks.push_back(p); work.push_back(p); }
+        }
+        std::sort(L.blocks.begin(), L.blocks.end());
+    }
+
+    // Natural loops with different headers are disjoint or nested, so in
+    // order of decreasing size each loop's parent is the innermost loop
+    // already holding its header.
+    std::stable_sort(found.begin(), found.end(),
+                     [](const Loop& a, const Loop& b) { return a.blocks.size() > b.blocks.size(); });
+    LI.loops = std::move(found);
+    for (uint32_t l = 0; l < LI.loops.size(); ++l) {
+        Loop& L = LI.loops[l];
+        L.parent = LI.blockLoop[L.header];
+        L.depth = L.parent == kNone ? 1 : LI.loops[L.parent].depth + 1;
+        for (uint32_t b : L.blocks) LI.blockLoop[b] = l;
+    }
+
+    std::vector<uint32_t> defs(F.variables.size(), 0), defAt(F.variables.size(), 0);
+    for (uint32_t l = 0; l < LI.loops.size(); ++l) {
+        Loop& L = LI.loops[l];
+        for (uint32_t b : L.blocks)
+            for (uint32_t s : cfg.successors(b))
+                if (!L.contains(s)) L.exits.push_back(s);
+        std::sort(L.exits.begin(), L.exits.end());
+        L.exits.erase(std::unique(L.exits.begin(), L.exits.end()), L.exits.end());
+        findInductionVariables(F, cfg, LI, l, defs, defAt);
+        findTripCount(F, cfg, LI, l);
+    }
+    return LI;
+}
+
+} // namespace ircpp
@@ -52,6 +52,18 @@ std::string opToString(MIPSOp op) {
     }
 }
 
+int gprNumber(const std::string& name) {
+    static const char* const names[32] = {
+        "zero", "at", "v0", "v1", "a0", "a1", "a2", "a3",
+        "t0", "t1", "t2", "t3", "t4", "t5", "t6", "t7",
+        "s0", "s1", "s2", "s3", "s4", "s5", "s6", "s7",
+        "t8", "t9", "k0", "k1", "gp", "sp", "fp", "ra",
+    };
+    for (int n = 0; n < 32; ++n)
+        if (name == names[n]) return n;
+    return -1;
+}
+
 std::string MIPSInstruction::toString() const {
     string ans = "";
     
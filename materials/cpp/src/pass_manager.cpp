@@ -0,0 +1,94 @@
+#include "pass_manager.hpp"
+
+#include "ssa.hpp"
+
+namespace ircpp {
+
+const ControlFlowGraph& FunctionAnalyses::cfg() {
+    if (!cfg_) { cfg_ = CFGBuilder::buildCFG(function_); ++computed_; }
+    return *cfg_;
+}
+
+const Liveness& FunctionAnalyses::liveness() {
+    if (!liveness_) { liveness_ = Liveness::compute(function_, cfg()); ++computed_; }
+    return *liveness_;
+}
+
+const LoopInfo& FunctionAnalyses::loops() {
+    if (!loops_) { loops_ = LoopInfo::compute(function_, cfg()); ++computed_; }
+    return *loops_;
+}
+
+const DefUseIndex& FunctionAnalyses::defUse() {
+    if (!defUse_) { defUse_ = DefUseIndex::build(function_); ++computed_; }
+    return *defUse_;
+}
+
+void FunctionAnalyses::invalidate(uint32_t preserved) {
+    if (!(preserved & Analysis::CFG)) preserved &= ~(Analysis::Liveness | Analysis::Loops);
+    if (!(preserved & Analysis::CFG)) cfg_.reset();
+    if (!(preserved & Analysis::Liveness)) liveness_.reset();
+    if (!(preserved & Analysis::Loops)) loops_.reset();
+    if (!(preserved & Analysis::DefUse)) defUse_.reset();
+}
+
+void PassManager::run(IRFunction& function) const {
+    FunctionAnalyses analyses(function);
+    for (const auto& pass : passes_) analyses.invalidate(pass->run(function, analyses));
+}
+
+void PassManager::run(IRProgram& program) const {
+    if (inlining_) inlineLeafCalls(program, *inlining_);
+    if (passes_.empty()) return;
+    for (const auto& fn : program.functions)
+        if (fn) run(*fn);
+}
+
+std::string PassManager::describe() const {
+    std::string out = inlining_ ? inlining_->describe() : std::string();
+    for (const auto& pass : passes_) {
+        if (!out.empty()) out.push_back(',');
+        out += pass->name();
+    }
+    return out;
+}
+
+namespace {
+
+class SSARoundTripPass : public FunctionPass {
+public:
+    const char* name() const override { return "ssa"; }
+    uint32_t run(IRFunction& function, FunctionAnalyses&) override {
+        constructSSA(function);
+        destructSSA(function);
+        return Analysis::kNone;
+    }
+};
+
+} // namespace
+
+std::unique_ptr<FunctionPass> createSSARoundTripPass() { return std::make_unique<SSARoundTripPass>(); }
+
+PassManager PassManager::forLevel(int level, const InlineLimits& limits) {
+    PassManager pm;
+    switch (level) {
+        case 0: break;
+        case 2:
+            pm.setInlining(limits);
+            [[fallthrough]];
+        case 1:
+            pm.add(createTailRecursionPass());
+            pm.add(createSCCPPass());
+            pm.add(createCopyPropagationPass());
+            pm.add(createGVNPass());
+            pm.add(createLICMPass());
+            pm.add(createDeadCodeEliminationPass());
+            pm.add(createSimplifyCFGPass());
+            break;
+        default:
+            throw IRException("Unknown optimization level: " + std::to_string(level));
+    }
+    return pm;
+}
+
+} // namespace ircpp
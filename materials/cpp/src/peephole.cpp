@@ -0,0 +1,179 @@
+#include "peephole.hpp"
+
+#include <ostream>
+
+namespace ircpp {
+
+namespace {
+
+using Operands = std::vector<std::shared_ptr<MIPSOperand>>;
+
+const Register* reg(const MIPSInstruction& ins, size_t k) {
+    return k < ins.operands.size() ? dynamic_cast<const Register*>(ins.operands[k].get()) : nullptr;
+}
+
+const Address* addr(const MIPSInstruction& ins, size_t k) {
+    return k < ins.operands.size() ? dynamic_cast<const Address*>(ins.operands[k].get()) : nullptr;
+}
+
+bool sameReg(const Register* a, const Register* b) {
+    return a && b && a->name == b->name;
+}
+
+// The nop a label is emitted on: sll $zero, $zero, 0.
+bool isLabelNop(const MIPSInstruction& ins) {
+    const Register* r = reg(ins, 0);
+    return ins.op == MIPSOp::SLL && !ins.label.empty() && r && r->name == "zero" && sameReg(r, reg(ins, 1));
+}
+
+bool isBranch(MIPSOp op) {
+    switch (op) {
+        case MIPSOp::BEQ: case MIPSOp::BNE: case MIPSOp::BLT: case MIPSOp::BGT: case MIPSOp::BGE:
+        case MIPSOp::BC1T: case MIPSOp::BC1F:
+        case MIPSOp::J: case MIPSOp::JAL: case MIPSOp::JR:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Whether operand 0 is written rather than read (as in clobberedRegisters).
+bool writesFirst(MIPSOp op) {
+    switch (op) {
+        case MIPSOp::SW: case MIPSOp::S_S: case MIPSOp::SYSCALL:
+        case MIPSOp::C_EQ_S: case MIPSOp::C_NE_S: case MIPSOp::C_LT_S: case MIPSOp::C_GT_S: case MIPSOp::C_GE_S:
+            return false;
+        default:
+            return !isBranch(op);
+    }
+}
+
+bool reads(const MIPSInstruction& ins, const std::string& name) {
+    if (ins.op == MIPSOp::SYSCALL) return name == "v0" || name == "a0" || name == "a1";
+    for (size_t k = writesFirst(ins.op) ? 1 : 0; k < ins.operands.size(); ++k) {
+        const Register* r = reg(ins, k);
+        if (r && r->name == name) return true;
+    }
+    for (size_t k = 0; k < ins.operands.size(); ++k) {
+        const Address* a = addr(ins, k);
+        if (a && a->base->name == name) return true;
+    }
+    return false;
+}
+
+// Whether the value in `name` is dead after the instructions before `next`:
+// written again before any read on the fall-through path, or the function
+// returns first. Other control flow ends the scan as live.
+bool deadAfter(const std::string& name, const MIPSInstruction* next, const MIPSInstruction* end) {
+    for (; next != end; ++next) {
+        if (reads(*next, name)) return false;
+        if (next->op == MIPSOp::JR) return true;
+        if (isBranch(next->op)) return false;
+        const Register* r = writesFirst(next->op) ? reg(*next, 0) : nullptr;
+        if (r && r->name == name) return true;
+    }
+    return false;
+}
+
+bool fitsImm16(long long v) { return v >= -32768 && v <= 32767; }
+
+// sw r, X; lw r2, X: the load reads back what was just stored.
+bool storeLoad(std::vector<MIPSInstruction>& out, const MIPSInstruction*, const MIPSInstruction*) {
+    const MIPSInstruction& sw = out[out.size() - 2];
+    const MIPSInstruction& lw = out.back();
+    if (sw.op != MIPSOp::SW || lw.op != MIPSOp::LW || !lw.label.empty()) return false;
+    const Register* from = reg(sw, 0);
+    const Register* to = reg(lw, 0);
+    const Address* a = addr(sw, 1);
+    const Address* b = addr(lw, 1);
+    if (!from || !to || !a || !b || a->offset != b->offset || !sameReg(a->base.get(), b->base.get())) return false;
+    if (sameReg(from, to)) out.pop_back();
+    else out.back() = MIPSInstruction(MIPSOp::MOVE, "", Operands{lw.operands[0], sw.operands[0]});
+    return true;
+}
+
+bool moveSelf(std::vector<MIPSInstruction>& out, const MIPSInstruction*, const MIPSInstruction*) {
+    const MIPSInstruction& mv = out.back();
+    if (mv.op != MIPSOp::MOVE || !mv.label.empty() || !sameReg(reg(mv, 0), reg(mv, 1))) return false;
+    out.pop_back();
+    return true;
+}
+
+bool jumpNext(std::vector<MIPSInstruction>& out, const MIPSInstruction* next, const MIPSInstruction* end) {
+    const MIPSInstruction& j = out.back();
+    if (j.op != MIPSOp::J || !j.label.empty() || j.operands.empty()) return false;
+    const std::string target = j.operands[0]->toString();
+    for (; next != end && !next->label.empty(); ++next) {
+        if (next->label == target) {
+            out.pop_back();
+            return true;
+        }
+        if (!isLabelNop(*next)) break;
+    }
+    return false;
+}
+
+// li t, k; add d, a, t (or add d, t, a; sub d, a, t with -k) -> addi d, a, k.
+bool loadImmAdd(std::vector<MIPSInstruction>& out, const MIPSInstruction* next, const MIPSInstruction* end) {
+    const MIPSInstruction& li = out[out.size() - 2];
+    const MIPSInstruction& add = out.back();
+    if (li.op != MIPSOp::LI || (add.op != MIPSOp::ADD && add.op != MIPSOp::SUB) || !add.label.empty()) return false;
+    const Register* t = reg(li, 0);
+    const Immediate* k = li.operands.size() > 1 ? dynamic_cast<const Immediate*>(li.operands[1].get()) : nullptr;
+    const Register* d = reg(add, 0);
+    const Register* x = reg(add, 1);
+    const Register* y = reg(add, 2);
+    if (!t || !k || !d || !x || !y || sameReg(x, y)) return false;
+    size_t other;
+    if (sameReg(y, t)) other = 1;
+    else if (sameReg(x, t) && add.op == MIPSOp::ADD) other = 2;
+    else return false;
+    const long long imm = add.op == MIPSOp::SUB ? -static_cast<long long>(k->value) : k->value;
+    if (!fitsImm16(imm)) return false;
+    if (!sameReg(d, t) && !deadAfter(t->name, next, end)) return false;
+    MIPSInstruction addi(MIPSOp::ADDI, li.label,
+                         Operands{add.operands[0], add.operands[other], std::make_shared<Immediate>(static_cast<int>(imm))});
+    out.pop_back();
+    out.back() = std::move(addi);
+    return true;
+}
+
+} // namespace
+
+PeepholeOptimizer::PeepholeOptimizer() {
+    addRule({"sw-lw", 2, storeLoad});
+    addRule({"move-self", 1, moveSelf});
+    addRule({"jump-next", 1, jumpNext});
+    addRule({"li-add", 2, loadImmAdd});
+}
+
+void PeepholeOptimizer::addRule(PeepholeRule rule) {
+    rules_.push_back(std::move(rule));
+    hits_.push_back(0);
+}
+
+void PeepholeOptimizer::run(std::vector<MIPSInstruction>& code) {
+    std::vector<MIPSInstruction> out;
+    out.reserve(code.size());
+    const MIPSInstruction* end = code.data() + code.size();
+    for (MIPSInstruction* in = code.data(); in != end; ++in) {
+        out.push_back(std::move(*in));
+        for (bool changed = true; changed && !out.empty();) {
+            changed = false;
+            for (size_t r = 0; r < rules_.size() && !changed; ++r) {
+                if (rules_[r].window > out.size() || !rules_[r].apply(out, in + 1, end)) continue;
+                ++hits_[r];
+                changed = true;
+            }
+        }
+    }
+    code = std::move(out);
+}
+
+void PeepholeOptimizer::printStats(std::ostream& os) const {
+    os << "peephole:";
+    for (size_t r = 0; r < rules_.size(); ++r) os << ' ' << rules_[r].name << '=' << hits_[r];
+    os << '\n';
+}
+
+} // namespace ircpp
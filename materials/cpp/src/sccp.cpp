@@ -0,0 +1,238 @@
+#include "pass_manager.hpp"
+
+#include <limits>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "ssa.hpp"
+
+namespace ircpp {
+
+namespace {
+
+using Op = IRInstruction::OpCode;
+constexpr uint32_t kNone = ControlFlowGraph::kNone;
+
+bool isArithmetic(Op op) {
+    return op == Op::ADD || op == Op::SUB || op == Op::MULT || op == Op::DIV || op == Op::AND || op == Op::OR;
+}
+
+// Lattice value of one SSA variable: not yet known to be computed (Top), one
+// int constant, or anything (Bottom). Floats are always Bottom: the emitters
+// only materialize int constants.
+struct Value {
+    enum Kind : uint8_t { Top, Const, Bottom } kind = Top;
+    int32_t c = 0;
+
+    static Value constant(int32_t v) { return {Const, v}; }
+    static Value bottom() { return {Bottom, 0}; }
+    bool operator==(const Value& o) const { return kind == o.kind && (kind != Const || c == o.c); }
+    bool operator!=(const Value& o) const { return !(*this == o); }
+};
+
+Value meet(Value a, Value b) {
+    if (a.kind == Value::Top) return b;
+    if (b.kind == Value::Top) return a;
+    return a == b ? a : Value::bottom();
+}
+
+// a op b as the target computes it: add, sub and mult wrap. A zero divisor
+// faults at run time, and INT_MIN / -1 has no int32 result, so those divides
+// are left alone.
+bool fold(Op op, int32_t a, int32_t b, int32_t& out) {
+    const uint32_t ua = static_cast<uint32_t>(a), ub = static_cast<uint32_t>(b);
+    switch (op) {
+        case Op::ADD: out = static_cast<int32_t>(ua + ub); return true;
+        case Op::SUB: out = static_cast<int32_t>(ua - ub); return true;
+        case Op::MULT: out = static_cast<int32_t>(ua * ub); return true;
+        case Op::DIV:
+            if (b == 0 || (a == std::numeric_limits<int32_t>::min() && b == -1)) return false;
+            out = a / b;
+            return true;
+        case Op::AND: out = a & b; return true;
+        case Op::OR: out = a | b; return true;
+        default: return false;
+    }
+}
+
+bool taken(Op op, int32_t a, int32_t b) {
+    switch (op) {
+        case Op::BREQ: return a == b;
+        case Op::BRNEQ: return a != b;
+        case Op::BRLT: return a < b;
+        case Op::BRGT: return a > b;
+        case Op::BRGEQ: return a >= b;
+        default: return false;
+    }
+}
+
+// Sparse conditional constant propagation (Wegman and Zadeck) on SSA form:
+// values and reachable CFG edges are discovered together, so a constant
+// branch keeps its dead side from lowering the phis it feeds.
+class SCCPPass : public FunctionPass {
+public:
+    const char* name() const override { return "sccp"; }
+
+    uint32_t run(IRFunction& F, FunctionAnalyses&) override {
+        if (F.instructions.empty()) return Analysis::kAll;
+        for (const IRInstruction* ir : F.instructions)
+            if (!ir || ir->opCode == Op::PHI) return Analysis::kAll;
+        // Even with nothing to fold, the trip through SSA relays the code.
+        constructSSA(F);
+        propagate(F);
+        destructSSA(F);
+        return Analysis::kNone;
+    }
+
+private:
+    static void propagate(IRFunction& F) {
+        const ControlFlowGraph cfg = CFGBuilder::buildCFG(F);
+        const uint32_t nblocks = static_cast<uint32_t>(cfg.size());
+        const uint32_t nvars = static_cast<uint32_t>(F.variables.size());
+        auto& ins = F.instructions;
+
+        // Variables nothing defines hold their value on entry; floats are
+        // never tracked.
+        std::vector<Value> value(nvars);
+        std::vector<bool> defined(nvars, false);
+        std::vector<std::vector<uint32_t>> users(nvars);
+        for (uint32_t i = 0; i < ins.size(); ++i) {
+            if (auto d = ins[i]->scalarDef()) defined[d->id] = true;
+            ins[i]->forEachScalarUse([&](const IRVariableOperand* v) {
+                if (users[v->id].empty() || users[v->id].back() != i) users[v->id].push_back(i);
+            });
+        }
+        for (uint32_t v = 0; v < nvars; ++v)
+            if (!defined[v] || !F.variables[v]->type->isInt()) value[v] = Value::bottom();
+
+        auto valueOf = [&](const IROperand* op) {
+            if (auto c = op->asConstant()) return c->type->isInt() ? Value::constant(c->intValue) : Value::bottom();
+            if (auto v = op->asVariable()) return v->isArray() ? Value::bottom() : value[v->id];
+            return Value::bottom();
+        };
+
+        std::vector<bool> executable(nblocks, false);
+        std::unordered_set<uint64_t> edges;
+        std::vector<std::pair<uint32_t, uint32_t>> flowWork;
+        std::vector<uint32_t> ssaWork;
+        auto edgeKey = [](uint32_t from, uint32_t to) { return uint64_t(from) << 32 | to; };
+        auto markEdge = [&](uint32_t from, uint32_t to) {
+            if (to != kNone && edges.insert(edgeKey(from, to)).second) flowWork.push_back({from, to});
+        };
+
+        auto lower = [&](const IRVariableOperand* d, Value v) {
+            if (value[d->id] == v) return;
+            value[d->id] = v;
+            ssaWork.insert(ssaWork.end(), users[d->id].begin(), users[d->id].end());
+        };
+
+        auto visit = [&](uint32_t i) {
+            const uint32_t b = cfg.blockOf(i);
+            if (!executable[b]) return;
+            const IRInstruction* ir = ins[i];
+            const IRVariableOperand* d = ir->scalarDef();
+            if (d && value[d->id].kind == Value::Bottom) {
+                // Nothing can change for this definition.
+            } else if (ir->opCode == Op::PHI) {
+                Value v;
+                for (size_t k = 2; k < ir->operands.size(); k += 2) {
+                    const uint32_t p = cfg.labelBlock[ir->operands[k]->asLabel()->id];
+                    if (edges.count(edgeKey(p, b))) v = meet(v, valueOf(ir->operands[k - 1]));
+                }
+                lower(d, v);
+            } else if (d && ir->opCode == Op::ASSIGN && ir->operands.size() == 2) {
+                lower(d, valueOf(ir->operands[1]));
+            } else if (d && isArithmetic(ir->opCode)) {
+                const Value a = valueOf(ir->operands[1]), c = valueOf(ir->operands[2]);
+                int32_t r;
+                if (a.kind == Value::Bottom || c.kind == Value::Bottom) lower(d, Value::bottom());
+                else if (a.kind == Value::Const && c.kind == Value::Const)
+                    lower(d, fold(ir->opCode, a.c, c.c, r) ? Value::constant(r) : Value::bottom());
+            } else if (d) {
+                lower(d, Value::bottom());
+            }
+            if (i != cfg.blocks[b].last) return;
+
+            const uint32_t next = b + 1 < nblocks ? b + 1 : kNone;
+            if (ir->opCode == Op::RETURN) return;
+            if (ir->opCode == Op::GOTO) { markEdge(b, cfg.labelBlock[ir->operands[0]->asLabel()->id]); return; }
+            if (!ir->isConditionalBranch()) { markEdge(b, next); return; }
+            const uint32_t target = cfg.labelBlock[ir->operands[0]->asLabel()->id];
+            const Value a = valueOf(ir->operands[1]), c = valueOf(ir->operands[2]);
+            if (a.kind == Value::Const && c.kind == Value::Const) {
+                markEdge(b, taken(ir->opCode, a.c, c.c) ? target : next);
+            } else if (a.kind == Value::Bottom || c.kind == Value::Bottom) {
+                markEdge(b, target);
+                markEdge(b, next);
+            }
+        };
+
+        flowWork.push_back({kNone, 0});
+        while (!flowWork.empty() || !ssaWork.empty()) {
+            while (!flowWork.empty()) {
+                const uint32_t b = flowWork.back().second;
+                flowWork.pop_back();
+                const bool first = !executable[b];
+                executable[b] = true;
+                for (uint32_t i = cfg.blocks[b].first; i <= cfg.blocks[b].last; ++i)
+                    if (first || ins[i]->opCode == Op::PHI) visit(i);
+            }
+            while (!ssaWork.empty()) {
+                const uint32_t i = ssaWork.back();
+                ssaWork.pop_back();
+                visit(i);
+            }
+        }
+
+        // Rewrite: constants replace reads, their definitions go, branches
+        // that always go one way become a goto or nothing, and blocks never
+        // reached go, along with the phi inputs that came from them.
+        std::unordered_map<int32_t, IRConstantOperand*> constants;
+        auto constantFor = [&](int32_t v) {
+            IRConstantOperand*& c = constants[v];
+            if (!c) c = F.arena.make<IRConstantOperand>(IRIntType::get().get(), F.arena.copyString(std::to_string(v)), v);
+            return c;
+        };
+        std::vector<IRInstruction*> out;
+        out.reserve(ins.size());
+        for (uint32_t b = 0; b < nblocks; ++b) {
+            if (!executable[b]) continue;
+            for (uint32_t i = cfg.blocks[b].first; i <= cfg.blocks[b].last; ++i) {
+                IRInstruction* ir = ins[i];
+                if (ir->opCode == Op::PHI) {
+                    size_t kept = 1;
+                    for (size_t k = 2; k < ir->operands.size(); k += 2) {
+                        if (!edges.count(edgeKey(cfg.labelBlock[ir->operands[k]->asLabel()->id], b))) continue;
+                        ir->operands[kept++] = ir->operands[k - 1];
+                        ir->operands[kept++] = ir->operands[k];
+                    }
+                    ir->operands.truncate(kept);
+                }
+                const IRVariableOperand* d = ir->scalarDef();
+                if (d && value[d->id].kind == Value::Const) continue;
+                ir->forEachScalarUseIndex([&](size_t k) {
+                    const Value v = value[ir->operands[k]->asVariable()->id];
+                    if (v.kind != Value::Const) return;
+                    ir->operands[k] = constantFor(v.c);
+                });
+                if (ir->isConditionalBranch()) {
+                    const Value a = valueOf(ir->operands[1]), c = valueOf(ir->operands[2]);
+                    if (a.kind == Value::Const && c.kind == Value::Const) {
+                        if (!taken(ir->opCode, a.c, c.c)) continue;
+                        auto jump = F.arena.make<IRInstruction>(Op::GOTO, ir->irLineNumber);
+                        jump->operands.push_back(F.arena, ir->operands[0]);
+                        ir = jump;
+                    }
+                }
+                out.push_back(ir);
+            }
+        }
+        ins = std::move(out);
+    }
+};
+
+} // namespace
+
+std::unique_ptr<FunctionPass> createSCCPPass() { return std::make_unique<SCCPPass>(); }
+
+} // namespace ircpp
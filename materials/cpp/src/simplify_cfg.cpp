@@ -0,0 +1,160 @@
+#include "pass_manager.hpp"
+
+#include <algorithm>
+
+namespace ircpp {
+
+namespace {
+
+using Op = IRInstruction::OpCode;
+
+class SimplifyCFGPass : public FunctionPass {
+public:
+    const char* name() const override { return "simplifycfg"; }
+
+    uint32_t run(IRFunction& F, FunctionAnalyses& analyses) override {
+        for (const IRInstruction* ir : F.instructions)
+            if (!ir || ir->opCode == Op::PHI) return Analysis::kAll; // phis name their predecessors' labels
+        bool changed = false;
+        // Each step can expose work for the others (a threaded jump leaves
+        // a block unreachable, a dropped label lets a goto fall through), so
+        // repeat until nothing moves. Every round strictly shrinks the code
+        // or retargets a jump to a later link of its chain.
+        for (bool again = true; again; ) {
+            if (changed) analyses.invalidate(Analysis::kNone);
+            again = removeUnreachable(F, analyses.cfg());
+            again |= threadJumps(F);
+            again |= invertBranchesOverGotos(F);
+            again |= removeJumpsToNext(F);
+            again |= removeUnusedLabels(F);
+            changed |= again;
+        }
+        return changed ? Analysis::kNone : Analysis::kAll;
+    }
+
+private:
+    static bool removeUnreachable(IRFunction& F, const ControlFlowGraph& cfg) {
+        if (cfg.rpo.size() == cfg.size()) return false;
+        std::vector<IRInstruction*> out;
+        out.reserve(F.instructions.size());
+        for (uint32_t b = 0; b < cfg.size(); ++b)
+            if (cfg.reachable(b))
+                out.insert(out.end(), F.instructions.begin() + cfg.blocks[b].first,
+                           F.instructions.begin() + cfg.blocks[b].last + 1);
+        F.instructions = std::move(out);
+        return true;
+    }
+
+    // Position of each placed label, kNone for labels never placed.
+    static std::vector<uint32_t> labelPositions(const IRFunction& F) {
+        std::vector<uint32_t> at(F.labels.size(), ControlFlowGraph::kNone);
+        for (uint32_t i = 0; i < F.instructions.size(); ++i)
+            if (F.instructions[i]->opCode == Op::LABEL) at[F.instructions[i]->operands[0]->asLabel()->id] = i;
+        return at;
+    }
+
+    // A jump to a label whose first instruction is `goto M` goes straight to
+    // M, and on down the chain. Every label's final target is resolved once;
+    // a chain that runs into a cycle stops at the first repeated label.
+    static bool threadJumps(IRFunction& F) {
+        const auto at = labelPositions(F);
+        const auto& ins = F.instructions;
+        constexpr uint32_t kUnset = ControlFlowGraph::kNone, kBusy = ControlFlowGraph::kNone - 1;
+        std::vector<uint32_t> final(F.labels.size(), kUnset), path;
+        std::vector<IROperand*> operand(F.labels.size(), nullptr);
+        for (IRInstruction* ir : ins)
+            if (ir->opCode == Op::LABEL || ir->isJump()) operand[ir->operands[0]->asLabel()->id] = ir->operands[0];
+        auto resolve = [&](uint32_t label) {
+            uint32_t cur = label, result;
+            path.clear();
+            for (;;) {
+                if (final[cur] == kBusy) { result = cur; break; }
+                if (final[cur] != kUnset) { result = final[cur]; break; }
+                uint32_t i = at[cur];
+                while (i < ins.size() && ins[i]->opCode == Op::LABEL) ++i;
+                if (i >= ins.size() || ins[i]->opCode != Op::GOTO) { result = cur; break; }
+                final[cur] = kBusy;
+                path.push_back(cur);
+                cur = ins[i]->operands[0]->asLabel()->id;
+            }
+            if (final[cur] == kUnset) final[cur] = result;
+            for (uint32_t l : path) final[l] = result;
+            return result;
+        };
+        bool changed = false;
+        for (IRInstruction* ir : ins) {
+            if (!ir->isJump()) continue;
+            const uint32_t target = resolve(ir->operands[0]->asLabel()->id);
+            if (target == ir->operands[0]->asLabel()->id) continue;
+            ir->operands[0] = operand[target];
+            changed = true;
+        }
+        return changed;
+    }
+
+    // True if only labels lie between instruction i and the label `label`.
+    static bool fallsInto(const IRFunction& F, uint32_t i, uint32_t label) {
+        for (uint32_t k = i + 1; k < F.instructions.size() && F.instructions[k]->opCode == Op::LABEL; ++k)
+            if (F.instructions[k]->operands[0]->asLabel()->id == label) return true;
+        return false;
+    }
+
+    // `brlt L1, a, b; goto L2; L1:` becomes `brgeq L2, a, b; L1:`. There is
+    // no brle, so brgt inverts to brgeq with the operands swapped.
+    static bool invertBranchesOverGotos(IRFunction& F) {
+        auto& ins = F.instructions;
+        size_t kept = 0;
+        for (uint32_t i = 0; i < ins.size(); ++i) {
+            IRInstruction* br = ins[i];
+            ins[kept++] = br;
+            if (i + 1 == ins.size() || !br->isConditionalBranch() || ins[i + 1]->opCode != Op::GOTO) continue;
+            if (!fallsInto(F, i + 1, br->operands[0]->asLabel()->id)) continue;
+            switch (br->opCode) {
+                case Op::BREQ: br->opCode = Op::BRNEQ; break;
+                case Op::BRNEQ: br->opCode = Op::BREQ; break;
+                case Op::BRLT: br->opCode = Op::BRGEQ; break;
+                case Op::BRGEQ: br->opCode = Op::BRLT; break;
+                case Op::BRGT:
+                    br->opCode = Op::BRGEQ;
+                    std::swap(br->operands[1], br->operands[2]);
+                    break;
+                default: break;
+            }
+            br->operands[0] = ins[++i]->operands[0];
+        }
+        if (kept == ins.size()) return false;
+        ins.resize(kept);
+        return true;
+    }
+
+    static bool removeJumpsToNext(IRFunction& F) {
+        auto& ins = F.instructions;
+        size_t kept = 0;
+        for (uint32_t i = 0; i < ins.size(); ++i) {
+            IRInstruction* ir = ins[i];
+            if (ir->isJump() && fallsInto(F, i, ir->operands[0]->asLabel()->id)) continue;
+            ins[kept++] = ir;
+        }
+        if (kept == ins.size()) return false;
+        ins.resize(kept);
+        return true;
+    }
+
+    static bool removeUnusedLabels(IRFunction& F) {
+        std::vector<bool> used(F.labels.size(), false);
+        for (const IRInstruction* ir : F.instructions)
+            if (ir->isJump()) used[ir->operands[0]->asLabel()->id] = true;
+        auto& ins = F.instructions;
+        const size_t before = ins.size();
+        ins.erase(std::remove_if(ins.begin(), ins.end(), [&](const IRInstruction* ir) {
+            return ir->opCode == Op::LABEL && !used[ir->operands[0]->asLabel()->id];
+        }), ins.end());
+        return ins.size() != before;
+    }
+};
+
+} // namespace
+
+std::unique_ptr<FunctionPass> createSimplifyCFGPass() { return std::make_unique<SimplifyCFGPass>(); }
+
+} // namespace ircpp
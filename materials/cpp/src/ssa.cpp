@@ -0,0 +1,406 @@
+#include "ssa.hpp"
+
+#include <algorithm>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "liveness.hpp"
+
+namespace ircpp {
+
+namespace {
+
+using Op = IRInstruction::OpCode;
+constexpr uint32_t kNone = ControlFlowGraph::kNone;
+
+// Creates the labels, variables and instructions the SSA passes add, with
+// names that collide with nothing already in the function.
+struct Builder {
+    IRFunction& F;
+    std::unordered_set<std::string> varNames;
+
+    explicit Builder(IRFunction& f) : F(f) {
+        for (auto v : F.variables) varNames.insert(std::string(v->value));
+    }
+
+    IRLabelOperand* label() { return F.addLabel("ssa"); }
+
+    // A new scalar of `like`'s type, named base_N.
+    IRVariableOperand* variable(const IRVariableOperand* like, std::string_view base, uint32_t& suffix) {
+        std::string name;
+        do name = std::string(base) + "_" + std::to_string(suffix++); while (!varNames.insert(name).second);
+        auto v = F.arena.make<IRVariableOperand>(like->type, F.arena.copyString(name),
+                                                 static_cast<uint32_t>(F.variables.size()));
+        F.variables.push_back(v);
+        return v;
+    }
+
+    IRInstruction* instr(Op op, int line, std::initializer_list<IROperand*> ops) {
+        return F.makeInstruction(op, line, ops);
+    }
+};
+
+const IRLabelOperand* blockLabel(const IRFunction& F, const ControlFlowGraph& cfg, uint32_t b) {
+    const IRInstruction* first = F.instructions[cfg.blocks[b].first];
+    return first->opCode == Op::LABEL ? first->operands[0]->asLabel() : nullptr;
+}
+
+// Sequentialize the parallel copy `copies` (distinct destinations, all
+// sources read before any destination is written) into plain assigns. A copy
+// is safe to emit once no other pending copy still reads its destination;
+// when only cycles are left, one destination is saved to a temporary first.
+void sequentialize(std::vector<std::pair<IRVariableOperand*, IROperand*>> copies, Builder& B,
+                   std::unordered_map<const IRType*, IRVariableOperand*>& temps, uint32_t& tempSuffix,
+                   int line, std::vector<IRInstruction*>& out) {
+    auto readByOther = [&](size_t c) {
+        for (size_t o = 0; o < copies.size(); ++o)
+            if (o != c && copies[o].second == copies[c].first) return true;
+        return false;
+    };
+    while (!copies.empty()) {
+        size_t c = 0;
+        while (c < copies.size() && readByOther(c)) ++c;
+        if (c == copies.size()) {
+            c = 0;
+            IRVariableOperand* d = copies[c].first;
+            IRVariableOperand*& t = temps[d->type];
+            if (!t) t = B.variable(d, "ssa_tmp", tempSuffix);
+            out.push_back(B.instr(Op::ASSIGN, line, {t, d}));
+            for (auto& cp : copies)
+                if (cp.second == d) cp.second = t;
+        }
+        out.push_back(B.instr(Op::ASSIGN, line, {copies[c].first, copies[c].second}));
+        copies.erase(copies.begin() + c);
+    }
+}
+
+} // namespace
+
+void constructSSA(IRFunction& F) {
+    if (F.instructions.empty()) return;
+    Builder B(F);
+
+    // Lay the body out again without unreachable blocks (nothing reachable
+    // falls into one), with a label on every block and an entry block that
+    // nothing jumps to.
+    {
+        ControlFlowGraph cfg = CFGBuilder::buildCFG(F);
+        std::vector<IRInstruction*> out;
+        out.reserve(F.instructions.size() + cfg.size() + 1);
+        if (!cfg.predecessors(0).empty()) out.push_back(B.instr(Op::LABEL, 0, {B.label()}));
+        for (uint32_t b = 0; b < cfg.size(); ++b) {
+            if (!cfg.reachable(b)) continue;
+            const BasicBlock& bb = cfg.blocks[b];
+            IRInstruction* first = F.instructions[bb.first];
+            if (!first || first->opCode != Op::LABEL)
+                out.push_back(B.instr(Op::LABEL, first ? first->irLineNumber : 0, {B.label()}));
+            for (uint32_t i = bb.first; i <= bb.last; ++i)
+                if (F.instructions[i]) out.push_back(F.instructions[i]);
+        }
+        F.instructions = std::move(out);
+    }
+
+    const ControlFlowGraph cfg = CFGBuilder::buildCFG(F);
+    const uint32_t nblocks = static_cast<uint32_t>(cfg.size());
+    const uint32_t nvars = static_cast<uint32_t>(F.variables.size());
+    const Liveness live = Liveness::compute(F, cfg);
+
+    // Dominance frontiers (Cooper, Harvey and Kennedy): walk up from each
+    // predecessor of a join until reaching the join's idom. Joins are visited
+    // in order, so a repeat is always at the back of the list.
+    std::vector<std::vector<uint32_t>> frontier(nblocks);
+    for (uint32_t b = 0; b < nblocks; ++b) {
+        if (cfg.predecessors(b).size() < 2) continue;
+        for (uint32_t p : cfg.predecessors(b))
+            for (uint32_t r = p; r != cfg.idom[b]; r = cfg.idom[r])
+                if (frontier[r].empty() || frontier[r].back() != b) frontier[r].push_back(b);
+    }
+
+    std::vector<std::vector<uint32_t>> defBlocks(nvars);
+    for (uint32_t b = 0; b < nblocks; ++b)
+        for (uint32_t i = cfg.blocks[b].first; i <= cfg.blocks[b].last; ++i)
+            if (auto d = F.instructions[i]->scalarDef())
+                if (defBlocks[d->id].empty() || defBlocks[d->id].back() != b) defBlocks[d->id].push_back(b);
+
+    // Phis at the iterated frontier, pruned by liveness: a block where the
+    // variable is dead neither gets a phi nor propagates one.
+    std::vector<std::vector<IRInstruction*>> phis(nblocks);
+    std::vector<uint32_t> visited(nblocks, kNone), queued(nblocks, kNone);
+    std::vector<uint32_t> work;
+    for (uint32_t v = 0; v < nvars; ++v) {
+        if (defBlocks[v].empty()) continue;
+        work = defBlocks[v];
+        for (uint32_t b : work) queued[b] = v;
+        while (!work.empty()) {
+            const uint32_t b = work.back();
+            work.pop_back();
+            for (uint32_t d : frontier[b]) {
+                if (visited[d] == v) continue;
+                visited[d] = v;
+                if (!live.liveIn[d].test(v)) continue;
+                IRInstruction* phi = B.instr(Op::PHI, F.instructions[cfg.blocks[d].first]->irLineNumber, {F.variables[v]});
+                for (uint32_t p : cfg.predecessors(d)) {
+                    phi->operands.push_back(F.arena, F.variables[v]);
+                    phi->operands.push_back(F.arena, F.instructions[cfg.blocks[p].first]->operands[0]);
+                }
+                phis[d].push_back(phi);
+                if (queued[d] != v) { queued[d] = v; work.push_back(d); }
+            }
+        }
+    }
+
+    // Rename over the dominator tree. cur[v] is the version of v that
+    // reaches the current point; `undo` restores it on leaving a subtree.
+    std::vector<IRVariableOperand*> cur(F.variables.begin(), F.variables.end());
+    std::vector<uint32_t> suffix(nvars, 1);
+    std::vector<std::pair<uint32_t, IRVariableOperand*>> undo;
+    auto define = [&](IROperand*& slot) {
+        const IRVariableOperand* src = slot->asVariable();
+        IRVariableOperand* v = B.variable(src, src->value, suffix[src->id]);
+        v->origin = src->id;
+        undo.push_back({src->id, cur[src->id]});
+        cur[src->id] = v;
+        slot = v;
+    };
+    struct Frame { uint32_t block, child; size_t undoMark; };
+    std::vector<Frame> stack;
+    auto enter = [&](uint32_t b) {
+        stack.push_back({b, 0, undo.size()});
+        for (IRInstruction* phi : phis[b]) define(phi->operands[0]);
+        for (uint32_t i = cfg.blocks[b].first; i <= cfg.blocks[b].last; ++i) {
+            IRInstruction* ir = F.instructions[i];
+            ir->forEachScalarUseIndex([&](size_t k) { ir->operands[k] = cur[ir->operands[k]->asVariable()->id]; });
+            if (ir->scalarDef()) define(ir->operands[0]);
+        }
+        const uint32_t self = blockLabel(F, cfg, b)->id;
+        for (uint32_t s : cfg.successors(b))
+            for (IRInstruction* phi : phis[s])
+                for (size_t k = 2; k < phi->operands.size(); k += 2)
+                    if (phi->operands[k]->asLabel()->id == self)
+                        phi->operands[k - 1] = cur[phi->operands[k - 1]->asVariable()->id];
+    };
+    enter(cfg.rpo[0]);
+    while (!stack.empty()) {
+        Frame& top = stack.back();
+        auto kids = cfg.domTreeChildren(top.block);
+        if (top.child < kids.size()) {
+            enter(kids.begin()[top.child++]);
+            continue;
+        }
+        for (size_t k = undo.size(); k-- > top.undoMark; ) cur[undo[k].first] = undo[k].second;
+        undo.resize(top.undoMark);
+        stack.pop_back();
+    }
+
+    std::vector<IRInstruction*> out;
+    out.reserve(F.instructions.size());
+    for (uint32_t b = 0; b < nblocks; ++b) {
+        out.push_back(F.instructions[cfg.blocks[b].first]);
+        out.insert(out.end(), phis[b].begin(), phis[b].end());
+        out.insert(out.end(), F.instructions.begin() + cfg.blocks[b].first + 1,
+                   F.instructions.begin() + cfg.blocks[b].last + 1);
+    }
+    F.instructions = std::move(out);
+}
+
+void destructSSA(IRFunction& F) {
+    if (F.instructions.empty()) return;
+    Builder B(F);
+    const ControlFlowGraph cfg = CFGBuilder::buildCFG(F);
+    const uint32_t nblocks = static_cast<uint32_t>(cfg.size());
+    const uint32_t nvars = static_cast<uint32_t>(F.variables.size());
+    const Liveness live = Liveness::compute(F, cfg);
+
+    // Versions are only ever merged with other versions of the same source
+    // variable, so interference is only recorded within those families.
+    std::vector<std::vector<uint32_t>> family(nvars);
+    for (uint32_t v = 0; v < nvars; ++v) family[F.variables[v]->origin].push_back(v);
+    auto famOf = [&](uint32_t v) { return F.variables[v]->origin; };
+
+    // Two versions interfere if one is live where the other is written
+    // (Chaitin), except across the copy that writes one from the other. Phi
+    // results of one block are all written at its top, so they interfere
+    // with each other too. famLive keeps each family's live members while
+    // walking a block backwards, so a write only looks at its own family.
+    std::unordered_set<uint64_t> interferes;
+    auto addInterference = [&](uint32_t a, uint32_t b) {
+        if (a > b) std::swap(a, b);
+        interferes.insert(uint64_t(a) << 32 | b);
+    };
+    auto interfere = [&](uint32_t a, uint32_t b) {
+        if (a > b) std::swap(a, b);
+        return interferes.count(uint64_t(a) << 32 | b) != 0;
+    };
+    std::vector<std::vector<uint32_t>> famLive(nvars);
+    std::vector<uint32_t> famPos(nvars, kNone);
+    VarSet liveNow(nvars);
+    auto setLive = [&](uint32_t v) {
+        if (liveNow.test(v)) return;
+        liveNow.set(v);
+        if (family[famOf(v)].size() < 2) return;
+        famPos[v] = static_cast<uint32_t>(famLive[famOf(v)].size());
+        famLive[famOf(v)].push_back(v);
+    };
+    auto resetLive = [&](uint32_t v) {
+        if (!liveNow.test(v)) return;
+        liveNow.reset(v);
+        if (family[famOf(v)].size() < 2) return;
+        auto& l = famLive[famOf(v)];
+        famPos[l.back()] = famPos[v];
+        l[famPos[v]] = l.back();
+        l.pop_back();
+    };
+    for (uint32_t b = 0; b < nblocks; ++b) {
+        if (!cfg.reachable(b)) continue;
+        for (size_t w = 0; w < liveNow.words.size(); ++w)
+            for (uint64_t bits = liveNow.words[w]; bits; bits &= bits - 1) resetLive(uint32_t(w * 64 + __builtin_ctzll(bits)));
+        for (size_t w = 0; w < liveNow.words.size(); ++w)
+            for (uint64_t bits = live.liveOut[b].words[w]; bits; bits &= bits - 1) setLive(uint32_t(w * 64 + __builtin_ctzll(bits)));
+        std::vector<uint32_t> phiDefs;
+        for (uint32_t i = cfg.blocks[b].last + 1; i-- > cfg.blocks[b].first; ) {
+            const IRInstruction* ir = F.instructions[i];
+            if (ir->opCode == Op::PHI) { phiDefs.push_back(ir->scalarDef()->id); continue; }
+            if (auto d = ir->scalarDef()) {
+                const IRVariableOperand* copied = ir->opCode == Op::ASSIGN && ir->operands.size() == 2
+                                                      ? ir->operands[1]->asVariable() : nullptr;
+                if (family[famOf(d->id)].size() > 1)
+                    for (uint32_t w : famLive[famOf(d->id)])
+                        if (w != d->id && !(copied && copied->id == w)) addInterference(d->id, w);
+                resetLive(d->id);
+            }
+            ir->forEachScalarUse([&](const IRVariableOperand* v) { setLive(v->id); });
+        }
+        for (size_t x = 0; x < phiDefs.size(); ++x) {
+            const uint32_t d = phiDefs[x];
+            if (family[famOf(d)].size() < 2) continue;
+            for (uint32_t w : famLive[famOf(d)])
+                if (w != d) addInterference(d, w);
+            for (size_t y = x + 1; y < phiDefs.size(); ++y)
+                if (famOf(phiDefs[y]) == famOf(d)) addInterference(d, phiDefs[y]);
+        }
+    }
+
+    // Greedily merge each family into groups of pairwise non-interfering
+    // members. The source variable comes first, so its group keeps its name.
+    std::vector<IRVariableOperand*> rep(F.variables.begin(), F.variables.end());
+    for (uint32_t f = 0; f < nvars; ++f) {
+        if (family[f].size() < 2) continue;
+        std::vector<std::vector<uint32_t>> groups;
+        for (uint32_t m : family[f]) {
+            auto fits = [&](const std::vector<uint32_t>& g) {
+                return std::none_of(g.begin(), g.end(), [&](uint32_t o) { return interfere(m, o); });
+            };
+            auto g = std::find_if(groups.begin(), groups.end(), fits);
+            if (g == groups.end()) g = groups.insert(g, std::vector<uint32_t>());
+            g->push_back(m);
+            rep[m] = F.variables[g->front()];
+        }
+    }
+    for (IRInstruction* ir : F.instructions)
+        for (size_t k = 0; k < ir->operands.size(); ++k)
+            if (auto v = ir->operands[k]->asVariable()) ir->operands[k] = rep[v->id];
+
+    // Turn the phis of each block into one parallel copy per incoming edge.
+    // A predecessor with a single successor and no branch takes the copies at
+    // its end, before any goto. Otherwise the edge is split: a fallthrough
+    // edge gets a block right after the predecessor, a jump gets a block at
+    // the end of the function that jumps on to the phi's block.
+    std::vector<std::vector<IRInstruction*>> atEnd(nblocks), after(nblocks);
+    std::vector<IRInstruction*> tail;
+    std::unordered_map<const IRType*, IRVariableOperand*> temps;
+    uint32_t tempSuffix = 1;
+    for (uint32_t b = 0; b < nblocks; ++b) {
+        std::vector<IRInstruction*> blockPhis;
+        for (uint32_t i = cfg.blocks[b].first; i <= cfg.blocks[b].last; ++i)
+            if (F.instructions[i]->opCode == Op::PHI) blockPhis.push_back(F.instructions[i]);
+        if (blockPhis.empty()) continue;
+        IROperand* selfLabel = F.instructions[cfg.blocks[b].first]->operands[0];
+        const int line = blockPhis[0]->irLineNumber;
+        for (size_t k = 2; k < blockPhis[0]->operands.size(); k += 2) {
+            IROperand* predLabel = blockPhis[0]->operands[k];
+            const uint32_t p = cfg.labelBlock[predLabel->asLabel()->id];
+            std::vector<std::pair<IRVariableOperand*, IROperand*>> copies;
+            for (IRInstruction* phi : blockPhis) {
+                auto dst = static_cast<IRVariableOperand*>(phi->operands[0]);
+                for (size_t j = 2; j < phi->operands.size(); j += 2) {
+                    if (phi->operands[j]->asLabel()->id != predLabel->asLabel()->id) continue;
+                    if (phi->operands[j - 1] != dst) copies.push_back({dst, phi->operands[j - 1]});
+                    break;
+                }
+            }
+            if (copies.empty()) continue;
+            IRInstruction* term = F.instructions[cfg.blocks[p].last];
+            if (cfg.successors(p).size() == 1 && !term->isConditionalBranch()) {
+                sequentialize(std::move(copies), B, temps, tempSuffix, line, atEnd[p]);
+                continue;
+            }
+            IRLabelOperand* split = B.label();
+            const bool jumps = term->operands[0]->asLabel()->id == selfLabel->asLabel()->id;
+            if (jumps) term->operands[0] = split;
+            if (p + 1 == b) {
+                // Both edges of a branch whose target is also the next block
+                // share this one split block.
+                after[p].push_back(B.instr(Op::LABEL, line, {split}));
+                sequentialize(std::move(copies), B, temps, tempSuffix, line, after[p]);
+            } else {
+                tail.push_back(B.instr(Op::LABEL, line, {split}));
+                sequentialize(std::move(copies), B, temps, tempSuffix, line, tail);
+                tail.push_back(B.instr(Op::GOTO, line, {selfLabel}));
+            }
+        }
+    }
+
+    std::vector<IRInstruction*> out;
+    out.reserve(F.instructions.size() + tail.size() + 2);
+    for (uint32_t b = 0; b < nblocks; ++b) {
+        const BasicBlock& bb = cfg.blocks[b];
+        IRInstruction* term = F.instructions[bb.last];
+        const bool beforeTerm = term->opCode == Op::GOTO;
+        for (uint32_t i = bb.first; i <= bb.last; ++i) {
+            if (i == bb.last && beforeTerm) out.insert(out.end(), atEnd[b].begin(), atEnd[b].end());
+            const IRInstruction* ir = F.instructions[i];
+            // Copies between versions that now share a variable vanish.
+            const bool selfCopy = ir->opCode == Op::ASSIGN && ir->operands.size() == 2 && ir->operands[0] == ir->operands[1];
+            if (ir->opCode != Op::PHI && !selfCopy) out.push_back(F.instructions[i]);
+        }
+        if (!beforeTerm) out.insert(out.end(), atEnd[b].begin(), atEnd[b].end());
+        out.insert(out.end(), after[b].begin(), after[b].end());
+    }
+    if (!tail.empty()) {
+        // Falling off the end of the body must still reach the epilogue.
+        const Op last = out.back()->opCode;
+        IRLabelOperand* exit = nullptr;
+        if (last != Op::GOTO && last != Op::RETURN) {
+            exit = B.label();
+            out.push_back(B.instr(Op::GOTO, out.back()->irLineNumber, {exit}));
+        }
+        out.insert(out.end(), tail.begin(), tail.end());
+        if (exit) out.push_back(B.instr(Op::LABEL, out.back()->irLineNumber, {exit}));
+    }
+
+    std::vector<bool> jumpedTo(F.labels.size(), false);
+    for (const IRInstruction* ir : out)
+        if (ir->isJump()) jumpedTo[ir->operands[0]->asLabel()->id] = true;
+    out.erase(std::remove_if(out.begin(), out.end(), [&](const IRInstruction* ir) {
+        return ir->opCode == Op::LABEL && !jumpedTo[ir->operands[0]->asLabel()->id];
+    }), out.end());
+    F.instructions = std::move(out);
+
+    // Drop versions nothing refers to any more and renumber the rest, which
+    // keeps the source variables (and so the frame layout) where they were.
+    std::vector<bool> used(F.variables.size(), false);
+    for (const IRInstruction* ir : F.instructions)
+        for (const IROperand* op : ir->operands)
+            if (auto v = op->asVariable()) used[v->id] = true;
+    std::vector<IRVariableOperand*> kept;
+    kept.reserve(F.variables.size());
+    for (IRVariableOperand* v : F.variables) {
+        if (v->origin != v->id && !used[v->id]) continue;
+        v->id = v->origin = static_cast<uint32_t>(kept.size());
+        kept.push_back(v);
+    }
+    F.variables = std::move(kept);
+}
+
+} // namespace ircpp
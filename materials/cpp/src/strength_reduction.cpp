@@ -0,0 +1,90 @@
+#include "strength_reduction.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <map>
+#include <string>
+#include <tuple>
+
+#include "loops.hpp"
+
+namespace ircpp {
+
+StrengthReduction StrengthReduction::plan(const IRFunction& F, const ControlFlowGraph& cfg) {
+    using Op = IRInstruction::OpCode;
+    const auto& ins = F.instructions;
+    StrengthReduction sr;
+    sr.access.assign(ins.size(), kNone);
+    sr.advance.resize(ins.size());
+    sr.init.resize(cfg.size());
+    sr.fallInit.resize(cfg.size());
+    sr.active.resize(cfg.size());
+
+    bool anyAccess = false;
+    for (const IRInstruction* ir : ins)
+        anyAccess |= ir && (ir->opCode == Op::ARRAY_LOAD || ir->opCode == Op::ARRAY_STORE) &&
+                     ir->operands[2]->asVariable();
+    if (!anyAccess) return sr;
+    const LoopInfo loops = LoopInfo::compute(F, cfg);
+    if (loops.loops.empty()) return sr;
+
+    // Candidates by (loop, array, index), each with the accesses it covers.
+    struct Candidate { PointerIV iv; uint32_t depth; std::vector<uint32_t> uses; uint32_t update; };
+    std::map<std::tuple<uint32_t, uint32_t, uint32_t>, Candidate> found;
+    for (uint32_t b = 0; b < cfg.size(); ++b) {
+        if (!cfg.reachable(b)) continue;
+        for (uint32_t i = cfg.blocks[b].first; i <= cfg.blocks[b].last; ++i) {
+            const IRInstruction* ir = ins[i];
+            if (!ir || (ir->opCode != Op::ARRAY_LOAD && ir->opCode != Op::ARRAY_STORE)) continue;
+            const IRVariableOperand* index = ir->operands[2]->asVariable();
+            if (!index) continue;
+            // The loop, among those holding b, where index is an induction
+            // variable; at most one can be, as its update is its only write.
+            for (uint32_t l = loops.blockLoop[b]; l != LoopInfo::kNone; l = loops.loops[l].parent) {
+                const Loop& L = loops.loops[l];
+                auto iv = std::find_if(L.inductionVariables.begin(), L.inductionVariables.end(),
+                                       [&](const InductionVariable& v) { return v.var == index; });
+                if (iv == L.inductionVariables.end()) continue;
+                const int64_t stride = 4 * int64_t(iv->step);
+                if (L.header == 0 || stride < std::numeric_limits<int16_t>::min() ||
+                    stride > std::numeric_limits<int16_t>::max()) break;
+                const IRVariableOperand* array = ir->operands[1]->asVariable();
+                Candidate& c = found[{l, array->id, index->id}];
+                c.iv.array = array;
+                c.iv.index = index;
+                c.iv.loop = l;
+                c.iv.stride = static_cast<int32_t>(stride);
+                c.depth = L.depth;
+                c.update = iv->update;
+                c.uses.push_back(i);
+                break;
+            }
+        }
+    }
+
+    std::vector<Candidate*> order;
+    for (auto& [key, c] : found) order.push_back(&c);
+    std::stable_sort(order.begin(), order.end(), [](const Candidate* a, const Candidate* b) {
+        return a->depth != b->depth ? a->depth > b->depth : a->uses.size() > b->uses.size();
+    });
+    if (order.size() > kMaxPointers) order.resize(kMaxPointers);
+    for (Candidate* c : order) {
+        const uint32_t k = static_cast<uint32_t>(sr.pointers.size());
+        c->iv.reg = std::make_shared<Register>("s" + std::to_string(k));
+        sr.pointers.push_back(c->iv);
+        for (uint32_t i : c->uses) sr.access[i] = k;
+        sr.advance[c->update].push_back(k);
+        const Loop& L = loops.loops[c->iv.loop];
+        for (uint32_t b : L.blocks) sr.active[b].push_back(k);
+        for (uint32_t p : cfg.predecessors(L.header)) {
+            if (!cfg.reachable(p) || L.contains(p)) continue;
+            const IRInstruction* last = ins[cfg.blocks[p].last];
+            const bool branch = last && last->isConditionalBranch();
+            auto& list = branch && cfg.labelBlock[last->operands[0]->asLabel()->id] != L.header ? sr.fallInit[p] : sr.init[p];
+            if (list.empty() || list.back() != k) list.push_back(k);
+        }
+    }
+    return sr;
+}
+
+} // namespace ircpp
@@ -0,0 +1,108 @@
+#include "pass_manager.hpp"
+
+#include <algorithm>
+#include <string>
+#include <unordered_set>
+
+#include "call_graph.hpp"
+
+namespace ircpp {
+
+namespace {
+
+using Op = IRInstruction::OpCode;
+
+bool sameKind(const IRType* a, const IRType* b) {
+    return a && b && a->kind == b->kind;
+}
+
+// Self tail recursion to a loop. A tail call (isTailCall) of the function
+// itself becomes copies of its arguments into the parameters and a jump to a
+// label at the top of the body, so the recursion runs in one frame.
+// Arguments that read a parameter the same call overwrites go through a
+// temporary first. An array argument must be the parameter it would bind
+// to, as an array parameter cannot be reassigned; calls passing anything
+// else, or arguments of another type, stay calls.
+class TailRecursionPass : public FunctionPass {
+public:
+    const char* name() const override { return "tailrec"; }
+
+    uint32_t run(IRFunction& F, FunctionAnalyses&) override {
+        auto& ins = F.instructions;
+        std::vector<bool> rewrite(ins.size(), false);
+        bool any = false;
+        for (size_t i = 0; i < ins.size(); ++i) {
+            const IRInstruction* ir = ins[i];
+            if (!ir || ir->opCode == Op::PHI) return Analysis::kAll;
+            if (!isTailCall(F, i)) continue;
+            const size_t first = ir->opCode == Op::CALLR ? 2 : 1;
+            auto target = ir->operands[first - 1]->asFunction();
+            if (!target || target->value != F.name || ir->operands.size() - first != F.parameters.size()) continue;
+            bool ok = true;
+            for (size_t k = 0; k < F.parameters.size() && ok; ++k) {
+                const IRVariableOperand* p = F.parameters[k];
+                const IROperand* arg = ir->operands[first + k];
+                auto v = arg->asVariable();
+                if (p->isArray()) ok = v && v->id == p->id;
+                else ok = sameKind(v ? v->type : arg->asConstant()->type, p->type);
+            }
+            rewrite[i] = ok;
+            any |= ok;
+        }
+        if (!any) return Analysis::kAll;
+
+        std::unordered_set<std::string> varNames;
+        for (const IRVariableOperand* v : F.variables) varNames.insert(std::string(v->value));
+        IRLabelOperand* top = F.addLabel("tailrec");
+        // One temporary per parameter, shared by every rewritten call.
+        std::vector<IRVariableOperand*> temp(F.variables.size(), nullptr);
+        auto tempFor = [&](const IRVariableOperand* p) {
+            if (!temp[p->id]) {
+                std::string t;
+                for (uint32_t n = 0; !varNames.insert(t = std::string(p->value) + "_" + std::to_string(n)).second; ++n) {}
+                temp[p->id] = F.arena.make<IRVariableOperand>(p->type, F.arena.copyString(t),
+                                                              static_cast<uint32_t>(F.variables.size()));
+                F.variables.push_back(temp[p->id]);
+            }
+            return temp[p->id];
+        };
+
+        std::vector<IRInstruction*> out;
+        out.reserve(ins.size() + 1 + 2 * F.parameters.size());
+        out.push_back(F.makeInstruction(Op::LABEL, ins.empty() ? 0 : ins[0]->irLineNumber, {top}));
+        std::vector<bool> written(temp.size(), false);
+        for (size_t i = 0; i < ins.size(); ++i) {
+            IRInstruction* ir = ins[i];
+            if (!rewrite[i]) { out.push_back(ir); continue; }
+            const size_t first = ir->opCode == Op::CALLR ? 2 : 1;
+            const int line = ir->irLineNumber;
+            std::fill(written.begin(), written.end(), false);
+            for (size_t k = 0; k < F.parameters.size(); ++k) {
+                auto v = ir->operands[first + k]->asVariable();
+                if (!v || v->id != F.parameters[k]->id) written[F.parameters[k]->id] = true;
+            }
+            std::vector<IROperand*> value(F.parameters.size(), nullptr);
+            for (size_t k = 0; k < F.parameters.size(); ++k) {
+                IRVariableOperand* p = F.parameters[k];
+                IROperand* arg = ir->operands[first + k];
+                if (!written[p->id]) continue;
+                value[k] = arg;
+                if (auto v = arg->asVariable(); v && written[v->id]) {
+                    value[k] = tempFor(p);
+                    out.push_back(F.makeInstruction(Op::ASSIGN, line, {value[k], arg}));
+                }
+            }
+            for (size_t k = 0; k < F.parameters.size(); ++k)
+                if (value[k]) out.push_back(F.makeInstruction(Op::ASSIGN, line, {F.parameters[k], value[k]}));
+            out.push_back(F.makeInstruction(Op::GOTO, line, {top}));
+        }
+        ins = std::move(out);
+        return Analysis::kNone;
+    }
+};
+
+} // namespace
+
+std::unique_ptr<FunctionPass> createTailRecursionPass() { return std::make_unique<TailRecursionPass>(); }
+
+} // namespace ircpp
@@ -0,0 +1,123 @@
+// Binary IR round trip. For every IR file given, at -O0 and after the -O1
+// pipeline: the program written with IRBinaryWriter and read back prints as
+// the same IR text and selects to the same assembly in both allocation modes.
+// Then programs whose operand types were tampered with after parsing must be
+// rejected by parseIRBinary, as the text reader rejects the same IR, and so
+// must a header claiming more functions than the file has room for.
+//
+//   binary_roundtrip <file.ir>...
+
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include "instruction_selector.hpp"
+#include "ir.hpp"
+#include "pass_manager.hpp"
+
+namespace {
+
+int failures = 0;
+
+void check(bool ok, const std::string& what) {
+    if (!ok) {
+        ++failures;
+        std::cout << "FAIL " << what << std::endl;
+    }
+}
+
+std::string printed(const ircpp::IRProgram& program) {
+    std::ostringstream os;
+    ircpp::IRPrinter(os).printProgram(program);
+    return os.str();
+}
+
+std::string binary(const ircpp::IRProgram& program) {
+    std::ostringstream os;
+    ircpp::IRBinaryWriter(os).writeProgram(program);
+    return os.str();
+}
+
+std::string assembly(const ircpp::IRProgram& program, ircpp::IRToMIPSSelector::AllocMode mode) {
+    ircpp::IRToMIPSSelector selector(mode);
+    return selector.generateAssembly(selector.selectProgram(program));
+}
+
+void roundTrip(const std::string& file, int level) {
+    const std::string name = file + " -O" + std::to_string(level);
+    ircpp::IRProgram text = ircpp::IRReader().parseIRFile(file);
+    ircpp::PassManager::forLevel(level).run(text);
+    ircpp::IRProgram decoded = ircpp::IRReader().parseIRBinary(binary(text));
+    check(printed(text) == printed(decoded), name + ": --emit-ir differs after the binary round trip");
+    for (auto mode : {ircpp::IRToMIPSSelector::AllocMode::Naive, ircpp::IRToMIPSSelector::AllocMode::Greedy})
+        check(assembly(text, mode) == assembly(decoded, mode), name + ": assembly differs after the binary round trip");
+}
+
+// Parses `ir`, applies `tamper` to its first function, and expects the
+// binary encoding of the result to be rejected, like the tampered text.
+void rejectsTampered(const std::string& what, const std::string& ir, const std::string& tamperedIr,
+                     const std::function<void(ircpp::IRFunction&)>& tamper) {
+    ircpp::IRProgram program = ircpp::IRReader().parseIRString(ir);
+    tamper(*program.functions[0]);
+    bool textRejected = false, binaryRejected = false;
+    try { ircpp::IRReader().parseIRString(tamperedIr); } catch (const ircpp::IRException&) { textRejected = true; }
+    try { ircpp::IRReader().parseIRBinary(binary(program)); } catch (const ircpp::IRException&) { binaryRejected = true; }
+    check(textRejected, what + ": text reader accepts it");
+    check(binaryRejected, what + ": binary reader accepts it");
+}
+
+void tamperedTypes() {
+    const std::string header = "#start_function\nvoid main():\nint-list: y, x, A[4]\nfloat-list: f\n";
+    const std::string footer = "#end_function\n";
+    auto operandOf = [](ircpp::IRFunction& fn, size_t k) { return fn.instructions[0]->operands[k]; };
+    rejectsTampered("array_load from a scalar", header + "    array_load, y, A, x\n" + footer,
+                    header + "    array_load, y, x, x\n" + footer,
+                    [&](ircpp::IRFunction& fn) { fn.instructions[0]->operands[1] = operandOf(fn, 2); });
+    rejectsTampered("array_store of an array", header + "    array_store, y, A, x\n" + footer,
+                    header + "    array_store, A, A, x\n" + footer,
+                    [&](ircpp::IRFunction& fn) { fn.instructions[0]->operands[0] = operandOf(fn, 1); });
+    rejectsTampered("float index", header + "    array_load, y, A, x\n    assign, f, 1.5\n" + footer,
+                    header + "    array_load, y, A, f\n    assign, f, 1.5\n" + footer,
+                    [&](ircpp::IRFunction& fn) { fn.instructions[0]->operands[2] = fn.instructions[1]->operands[0]; });
+    rejectsTampered("mixed arithmetic", header + "    add, y, x, x\n    assign, f, 1.5\n" + footer,
+                    header + "    add, y, x, f\n    assign, f, 1.5\n" + footer,
+                    [&](ircpp::IRFunction& fn) { fn.instructions[0]->operands[2] = fn.instructions[1]->operands[0]; });
+    rejectsTampered("array compare", header + "    breq, L, x, y\nL:\n" + footer,
+                    header + "    breq, L, A, y\nL:\n" + footer,
+                    [&](ircpp::IRFunction& fn) {
+                        for (ircpp::IRVariableOperand* v : fn.variables)
+                            if (v->value == "A") fn.instructions[0]->operands[1] = v;
+                    });
+}
+
+void corruptHeader() {
+    const std::string data("IRCPPBIN\x02\0\0\0\xff\xff\xff\xff", 16);
+    std::string error;
+    try { ircpp::IRReader().parseIRBinary(data); } catch (const std::exception& e) { error = e.what(); }
+    check(error == "Corrupt binary IR", "function count past the end of the file: " + (error.empty() ? "accepted" : error));
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <file.ir>..." << std::endl;
+        return 1;
+    }
+    for (int i = 1; i < argc; ++i) {
+        for (int level : {0, 1}) {
+            try {
+                roundTrip(argv[i], level);
+            } catch (const std::exception& e) {
+                check(false, std::string(argv[i]) + ": " + e.what());
+            }
+        }
+    }
+    tamperedTypes();
+    corruptHeader();
+    std::cout << (failures ? "binary_roundtrip: " + std::to_string(failures) + " failures"
+                           : "binary_roundtrip: " + std::to_string(argc - 1) + " files ok")
+              << std::endl;
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,83 @@
+// Compile cache hit and miss counts. For each IR file given: a cold build
+// misses every function, a warm one hits every function, and after one entry
+// is overwritten with garbage the next build counts that function as a miss,
+// rewrites it, and still produces the same assembly.
+//
+//   cache_stats <file.ir>...
+
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <string>
+
+#include "compile_cache.hpp"
+
+namespace {
+
+int failures = 0;
+
+void check(bool ok, const std::string& what) {
+    if (!ok) {
+        ++failures;
+        std::cout << "FAIL " << what << std::endl;
+    }
+}
+
+struct Build { std::string assembly; size_t hits, misses; };
+
+Build build(const std::string& text, const std::string& dir) {
+    ircpp::IRReader reader;
+    ircpp::IRToMIPSSelector selector(ircpp::IRToMIPSSelector::AllocMode::Greedy);
+    ircpp::CompileCache cache(dir, ircpp::cacheConfigFor(selector));
+    std::string assembly = ircpp::compileWithCache(text, reader, selector, cache);
+    return {assembly, cache.hits(), cache.misses()};
+}
+
+void checkFile(const std::string& file, const std::filesystem::path& dir) {
+    std::ifstream in(file, std::ios::binary);
+    const std::string text((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    std::vector<std::string_view> blocks;
+    if (!ircpp::IRReader::splitFunctions(text, blocks)) return;
+    const size_t n = blocks.size();
+    std::filesystem::remove_all(dir);
+
+    const Build cold = build(text, dir.string());
+    check(cold.hits == 0 && cold.misses == n, file + ": cold build should miss every function");
+    const Build warm = build(text, dir.string());
+    check(warm.hits == n && warm.misses == 0, file + ": warm build should hit every function");
+    check(warm.assembly == cold.assembly, file + ": warm build differs");
+
+    std::filesystem::path entry;
+    for (const auto& e : std::filesystem::directory_iterator(dir)) entry = e.path();
+    std::ofstream(entry, std::ios::trunc) << "garbage";
+    const Build damaged = build(text, dir.string());
+    check(damaged.hits == n - 1 && damaged.misses == 1, file + ": a malformed entry should count as a miss");
+    check(damaged.assembly == cold.assembly, file + ": build over a malformed entry differs");
+    const Build repaired = build(text, dir.string());
+    check(repaired.hits == n && repaired.misses == 0, file + ": the malformed entry should have been rewritten");
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <file.ir>..." << std::endl;
+        return 1;
+    }
+    const std::filesystem::path dir =
+        std::filesystem::temp_directory_path() / ("cache_stats." + std::to_string(std::random_device{}()));
+    for (int i = 1; i < argc; ++i) {
+        try {
+            checkFile(argv[i], dir);
+        } catch (const std::exception& e) {
+            check(false, std::string(argv[i]) + ": " + e.what());
+        }
+    }
+    std::filesystem::remove_all(dir);
+    std::cout << (failures ? "cache_stats: " + std::to_string(failures) + " failures"
+                           : "cache_stats: " + std::to_string(argc - 1) + " files ok")
+              << std::endl;
+    return failures ? 1 : 0;
+}
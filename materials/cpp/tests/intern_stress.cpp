@@ -0,0 +1,103 @@
+// Concurrent type interning. Threads first race to intern the same array
+// types, which must come back as one object per type. Then they parse and
+// compile many small programs at once, each declaring array types of its own,
+// and every result must match a serial compile. `make stress-tsan` runs the
+// same under ThreadSanitizer.
+//
+//   intern_stress [threads] [programs per thread]
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "instruction_selector.hpp"
+#include "ir.hpp"
+
+namespace {
+
+constexpr int kSizes = 2000;
+
+// Every thread interns int[1..kSizes] and float[1..kSizes], starting at a
+// different offset so that first insertions happen on all threads.
+int internRace(int threads) {
+    std::vector<std::vector<const ircpp::IRArrayType*>> seen(threads);
+    std::vector<std::thread> pool;
+    for (int t = 0; t < threads; ++t)
+        pool.emplace_back([&, t] {
+            auto& mine = seen[t];
+            mine.assign(2 * kSizes, nullptr);
+            for (int k = 0; k < 2 * kSizes; ++k) {
+                const int slot = (k + t * 2 * kSizes / threads) % (2 * kSizes);
+                const int size = slot / 2 + 1;
+                std::shared_ptr<ircpp::IRType> elem;
+                if (slot % 2) elem = ircpp::IRFloatType::get();
+                else elem = ircpp::IRIntType::get();
+                mine[slot] = ircpp::IRArrayType::get(elem, 100000 + size).get();
+            }
+        });
+    for (auto& th : pool) th.join();
+
+    int bad = 0;
+    for (int slot = 0; slot < 2 * kSizes; ++slot) {
+        const ircpp::IRArrayType* type = seen[0][slot];
+        const bool wantFloat = slot % 2;
+        bool ok = type && type->size == 100000 + slot / 2 + 1 && type->elementType->isFloat() == wantFloat;
+        for (int t = 1; t < threads; ++t) ok = ok && seen[t][slot] == type;
+        bad += !ok;
+    }
+    return bad;
+}
+
+std::string program(int seed) {
+    std::ostringstream o;
+    o << "#start_function\n"
+      << "void main():\n"
+      << "int-list: i, a[" << seed % 997 + 1 << "], b[" << seed % 13 + 50 << "]\n"
+      << "float-list: f[" << seed % 31 + 1 << "], g\n"
+      << "    assign, a, 3, " << seed << "\n"
+      << "    array_load, i, a, 0\n"
+      << "    array_store, i, b, 1\n"
+      << "    array_load, g, f, 0\n"
+      << "    call, puti, i\n"
+      << "#end_function\n";
+    return o.str();
+}
+
+std::string compile(int seed) {
+    ircpp::IRReader reader;
+    reader.parseThreads = 1;
+    const ircpp::IRProgram p = reader.parseIRString(program(seed));
+    ircpp::IRToMIPSSelector selector(seed % 2 ? ircpp::IRToMIPSSelector::AllocMode::Greedy
+                                              : ircpp::IRToMIPSSelector::AllocMode::Naive);
+    return selector.generateAssembly(selector.selectProgram(p));
+}
+
+int compileRace(int threads, int perThread) {
+    std::vector<std::string> got(static_cast<size_t>(threads) * perThread);
+    std::vector<std::thread> pool;
+    for (int t = 0; t < threads; ++t)
+        pool.emplace_back([&, t] {
+            for (int k = 0; k < perThread; ++k) got[t * perThread + k] = compile(t * perThread + k);
+        });
+    for (auto& th : pool) th.join();
+    int bad = 0;
+    for (int s = 0; s < threads * perThread; ++s) bad += got[s] != compile(s);
+    return bad;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    const int threads = argc > 1 ? std::max(2, std::atoi(argv[1])) : 8;
+    const int perThread = argc > 2 ? std::max(1, std::atoi(argv[2])) : 200;
+    const int badTypes = internRace(threads);
+    const int badPrograms = compileRace(threads, perThread);
+    std::cout << "intern_stress: " << threads << " threads, " << 2 * kSizes << " types ("
+              << badTypes << " bad), " << threads * perThread << " programs (" << badPrograms << " mismatches)"
+              << std::endl;
+    return badTypes || badPrograms ? 1 : 0;
+}
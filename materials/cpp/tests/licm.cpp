@@ -0,0 +1,116 @@
+// Loop-invariant code motion. Each case is a small program with one
+// instruction of interest; after the -O1 and -O2 pipelines it must have left
+// its loop (hoisted into a preheader) or stayed inside one, as expected.
+// Instructions that can fault must stay when nothing guarantees they run,
+// including in loops that never exit.
+//
+//   licm
+
+#include <iostream>
+#include <string>
+
+#include "ir.hpp"
+#include "pass_manager.hpp"
+
+namespace {
+
+using Op = ircpp::IRInstruction::OpCode;
+
+int failures = 0;
+
+void check(bool ok, const std::string& what) {
+    if (!ok) {
+        ++failures;
+        std::cout << "FAIL " << what << std::endl;
+    }
+}
+
+struct Case {
+    const char* name;
+    const char* body; // of void main(), after the declarations
+    Op op;            // the instruction of interest, the only one of its kind
+    bool hoisted;
+};
+
+const Case kCases[] = {
+    // Reading 0 prints A forever; the divide by zero must never run.
+    {"guarded div in a loop that never exits",
+     "    callr, z, geti\n"
+     "loop:\n"
+     "    call, putc, 65\n"
+     "    breq, loop, z, 0\n"
+     "    div, q, 100, z\n"
+     "    call, puti, q\n"
+     "    goto, loop\n",
+     Op::DIV, false},
+    {"guarded array_load in a loop that never exits",
+     "    callr, z, geti\n"
+     "loop:\n"
+     "    call, putc, 65\n"
+     "    brlt, loop, z, 4\n"
+     "    array_load, q, A, z\n"
+     "    call, puti, q\n"
+     "    goto, loop\n",
+     Op::ARRAY_LOAD, false},
+    {"guarded div in a loop that may exit first",
+     "    callr, z, geti\n"
+     "    assign, i, 0\n"
+     "loop:\n"
+     "    brgeq, done, i, 10\n"
+     "    breq, skip, z, 0\n"
+     "    div, q, 100, z\n"
+     "    call, puti, q\n"
+     "skip:\n"
+     "    add, i, i, 1\n"
+     "    goto, loop\n"
+     "done:\n",
+     Op::DIV, false},
+    {"multiply in a counted loop",
+     "    callr, z, geti\n"
+     "    assign, i, 0\n"
+     "loop:\n"
+     "    brgeq, done, i, 10\n"
+     "    mult, q, z, 3\n"
+     "    call, puti, q\n"
+     "    add, i, i, 1\n"
+     "    goto, loop\n"
+     "done:\n",
+     Op::MULT, true},
+};
+
+void run(const Case& c, int level) {
+    const std::string name = std::string(c.name) + " -O" + std::to_string(level);
+    ircpp::IRProgram program = ircpp::IRReader().parseIRString(
+        std::string("#start_function\nvoid main():\nint-list: z, q, i, A[4]\nfloat-list:\n") + c.body +
+        "#end_function\n");
+    ircpp::PassManager::forLevel(level).run(program);
+    const ircpp::IRFunction& main = *program.functions[0];
+    ircpp::FunctionAnalyses analyses(main);
+    for (uint32_t i = 0; i < main.instructions.size(); ++i) {
+        if (main.instructions[i]->opCode != c.op) continue;
+        const uint32_t block = analyses.cfg().blockOf(i);
+        const bool inLoop = analyses.loops().blockLoop[block] != ircpp::LoopInfo::kNone;
+        check(inLoop != c.hoisted, name + (c.hoisted ? ": not hoisted" : ": hoisted out of its loop"));
+        return;
+    }
+    check(false, name + ": instruction removed");
+}
+
+} // namespace
+
+int main() {
+    for (const Case& c : kCases) {
+        for (int level : {1, 2}) {
+            try {
+                run(c, level);
+            } catch (const std::exception& e) {
+                check(false, std::string(c.name) + ": " + e.what());
+            }
+        }
+    }
+    const size_t cases = sizeof(kCases) / sizeof(kCases[0]);
+    std::cout << (failures ? "licm: " + std::to_string(failures) + " failures"
+                           : "licm: " + std::to_string(cases) + " cases ok")
+              << std::endl;
+    return failures ? 1 : 0;
+}